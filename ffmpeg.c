@@ -569,6 +569,8 @@ static void ffmpeg_cleanup(int ret)
     av_freep(&output_streams);
     av_freep(&output_files);
 
+    av_thread_pool_free(&thread_pool);
+
     uninit_opts();
 
     avformat_network_deinit();
@@ -2543,6 +2545,7 @@ static int init_input_stream(int ist_index, char *error, int error_len)
 
         if (!av_dict_get(ist->decoder_opts, "threads", NULL, 0))
             av_dict_set(&ist->decoder_opts, "threads", "auto", 0);
+        av_codec_set_thread_pool(ist->dec_ctx, thread_pool);
         if ((ret = avcodec_open2(ist->dec_ctx, codec, &ist->decoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 0);
@@ -2603,6 +2606,7 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             !av_dict_get(ost->encoder_opts, "ab", NULL, 0))
             av_dict_set(&ost->encoder_opts, "b", "128000", 0);
 
+        av_codec_set_thread_pool(ost->enc_ctx, thread_pool);
         if ((ret = avcodec_open2(ost->enc_ctx, codec, &ost->encoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 1);
@@ -4104,7 +4108,7 @@ static void log_callback_null(void *ptr, int level, const char *fmt, va_list vl)
 int main(int argc, char **argv)
 {
     int ret;
-    int64_t ti;
+    int64_t ti, rti;
 
     register_exit(ffmpeg_cleanup);
 
@@ -4155,11 +4159,14 @@ int main(int argc, char **argv)
 //     }
 
     current_time = ti = getutime();
+    rti = av_gettime_relative();
     if (transcode() < 0)
         exit_program(1);
-    ti = getutime() - ti;
+    ti  = getutime() - ti;
+    rti = av_gettime_relative() - rti;
     if (do_benchmark) {
-        av_log(NULL, AV_LOG_INFO, "bench: utime=%0.3fs\n", ti / 1000000.0);
+        av_log(NULL, AV_LOG_INFO, "bench: utime=%0.3fs rtime=%0.3fs\n",
+               ti / 1000000.0, rti / 1000000.0);
     }
     av_log(NULL, AV_LOG_DEBUG, "%"PRIu64" frames successfully decoded, %"PRIu64" decoding errors\n",
            decode_error_stat[0], decode_error_stat[1]);
@@ -45,6 +45,7 @@
 #include "libavutil/pixfmt.h"
 #include "libavutil/rational.h"
 #include "libavutil/threadmessage.h"
+#include "libavutil/threadpool.h"
 
 #include "libswresample/swresample.h"
 
@@ -520,6 +521,8 @@ extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
 extern float max_error_rate;
+extern int thread_pool_size;
+extern AVThreadPool *thread_pool;
 extern int vdpau_api_ver;
 extern char *videotoolbox_pixfmt;
 
@@ -961,6 +961,7 @@ int configure_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->thread_pool = thread_pool;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
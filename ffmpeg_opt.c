@@ -108,6 +108,8 @@ int qp_hist           = 0;
 int stdin_interaction = 1;
 int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
+int thread_pool_size  = 0;
+AVThreadPool *thread_pool;
 
 
 static int intra_only         = 0;
@@ -2943,6 +2945,14 @@ int ffmpeg_parse_options(int argc, char **argv)
         goto fail;
     }
 
+    if (thread_pool_size) {
+        ret = av_thread_pool_alloc(&thread_pool, thread_pool_size);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Error creating the thread pool: ");
+            goto fail;
+        }
+    }
+
     /* open input files */
     ret = open_files(&octx.groups[GROUP_INFILE], "input", open_input_file);
     if (ret < 0) {
@@ -3071,6 +3081,8 @@ const OptionDef options[] = {
         "add timings for benchmarking" },
     { "benchmark_all",  OPT_BOOL | OPT_EXPERT,                       { &do_benchmark_all },
       "add timings for each task" },
+    { "thread_pool",    OPT_INT | HAS_ARG | OPT_EXPERT,              { &thread_pool_size },
+      "run the slice threads of all codecs and filtergraphs on a shared pool of this many threads", "count" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
@@ -63,6 +63,12 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
+#if HAVE_FLOCK
+#include <sys/file.h>
+#endif
 #include <errno.h>
 #include <time.h>
 #include <sys/wait.h>
@@ -131,13 +137,21 @@ typedef struct HTTPContext {
     int fd; /* socket file descriptor */
     struct sockaddr_in from_addr; /* origin */
     struct pollfd *poll_entry; /* used when polling */
+#if HAVE_EPOLL_CREATE1
+    struct pollfd epoll_entry; /* events reported by epoll, in poll() terms */
+    int epoll_events;          /* poll() events registered with epoll */
+    int queued;                /* in run_queue or tick_queue */
+    struct HTTPContext *next_queued;
+    int timer_armed;           /* in the timeout list */
+    struct HTTPContext *timer_prev, *timer_next;
+#endif
     int64_t timeout;
     uint8_t *buffer_ptr, *buffer_end;
     int http_error;
     int post;
     int chunked_encoding;
     int chunk_size;               /* 0 if it needs to be read */
-    struct HTTPContext *next;
+    struct HTTPContext *next, *prev;
     int got_key_frame; /* stream 0 => 1, stream 1 => 2, stream 2=> 4 */
     int64_t data_count;
     /* feed input */
@@ -187,9 +201,34 @@ typedef struct HTTPContext {
 
     /* RTP/TCP specific */
     struct HTTPContext *rtsp_c;
+    int rtsp_c_used; /* set on the RTSP connection if RTP/TCP refers to it */
     uint8_t *packet_buffer, *packet_buffer_ptr, *packet_buffer_end;
+
+    /* shared packet ring of the feed */
+    int ring_attached;           /* true if packets are taken from the ring */
+    int ring_resync;             /* skip packets up to the last one sent */
+    int64_t ring_seq;            /* next packet to take from the ring */
+    int64_t ring_last_pos;       /* last packet taken from the feed */
+    int64_t ring_last_pts;
+    int64_t ring_last_dts;
+    int ring_last_index;
 } HTTPContext;
 
+#define FEED_RING_MAX_PACKETS 8192
+
+/* Most recent packets of a feed, demuxed once and shared by all the
+ * clients close to its live edge. Packets are numbered with increasing
+ * sequence numbers, [first, next) being those held in the ring. */
+typedef struct FeedPacketRing {
+    AVFormatContext *fmt_in;     /* feed reader producing the ring packets */
+    AVPacket *pkts;
+    int64_t first;
+    int64_t next;
+    int64_t mem_size;            /* size of the packet data held */
+} FeedPacketRing;
+
+#define FEED_RING_PKT(ring, seq) (&(ring)->pkts[(seq) % FEED_RING_MAX_PACKETS])
+
 typedef struct FeedData {
     long long data_count;
     float avg_frame_size;   /* frame size averaged over last frames with exponential mean */
@@ -201,11 +240,13 @@ static FFServerConfig config = {
     .nb_max_http_connections = 2000,
     .nb_max_connections = 5,
     .max_bandwidth = 1000,
+    .nb_workers = 1,
     .use_defaults = 1,
 };
 
 static void new_connection(int server_fd, int is_rtsp);
 static void close_connection(HTTPContext *c);
+static void update_connection_events(HTTPContext *c);
 
 /* HTTP handling */
 static int handle_connection(HTTPContext *c);
@@ -246,6 +287,10 @@ static const char *my_program_name;
 static int no_launch;
 static int need_to_start_children;
 
+/* worker processes, when several are used: 0 is the main process */
+static int worker_index;
+static pid_t main_pid;
+
 /* maximum number of simultaneous HTTP connections */
 static unsigned int nb_connections;
 
@@ -258,6 +303,18 @@ static AVLFG random_state;
 
 static FILE *logfile = NULL;
 
+#if HAVE_EPOLL_CREATE1
+#define EPOLL_MAX_EVENTS 256
+
+static int epoll_fd = -1;
+/* connections to handle in the current loop iteration */
+static HTTPContext *run_queue;
+/* connections doing their own timing, handled again in the next iteration */
+static HTTPContext *tick_queue;
+/* connections waiting for a request, sorted by timeout */
+static HTTPContext *first_timer_ctx, *last_timer_ctx;
+#endif
+
 static void htmlstrip(char *s) {
     while (s && *s) {
         s += strspn(s, "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ,. ");
@@ -277,6 +334,23 @@ static int64_t ffm_read_write_index(int fd)
     return AV_RB64(buf);
 }
 
+/* With several workers, the feed may be received by another process:
+ * follow its write index and size through the feed file. */
+static void update_feed_index(FFServerStream *feed)
+{
+    int64_t index;
+
+    if (config.nb_workers <= 1 || feed->feed_opened ||
+        feed->feed_index_fd < 0 || feed->feed_index_time == cur_time)
+        return;
+    feed->feed_index_time = cur_time;
+
+    index = ffm_read_write_index(feed->feed_index_fd);
+    if (index >= 0)
+        feed->feed_write_index = FFMAX(index, FFM_PACKET_SIZE);
+    feed->feed_size = lseek(feed->feed_index_fd, 0, SEEK_END);
+}
+
 static int ffm_write_write_index(int fd, int64_t pos)
 {
     uint8_t buf[8];
@@ -363,6 +437,170 @@ static void log_connection(HTTPContext *c)
              c->protocol, (c->http_error ? c->http_error : 200), c->data_count);
 }
 
+static void feed_ring_reset(FFServerStream *feed)
+{
+    FeedPacketRing *ring = feed->packet_ring;
+
+    if (!ring)
+        return;
+    while (ring->first < ring->next) {
+        av_free_packet(FEED_RING_PKT(ring, ring->first));
+        ring->first++;
+    }
+    ring->mem_size = 0;
+    avformat_close_input(&ring->fmt_in);
+}
+
+static FeedPacketRing *feed_ring_get(FFServerStream *feed)
+{
+    FeedPacketRing *ring = feed->packet_ring;
+    AVFormatContext *s = NULL;
+    int ret;
+
+    if (!feed->packet_ring_size)
+        return NULL;
+    if (!ring) {
+        ring = av_mallocz(sizeof(*ring));
+        if (!ring)
+            return NULL;
+        ring->pkts = av_mallocz_array(FEED_RING_MAX_PACKETS, sizeof(*ring->pkts));
+        if (!ring->pkts) {
+            av_free(ring);
+            return NULL;
+        }
+        feed->packet_ring = ring;
+    }
+    if (ring->fmt_in)
+        return ring;
+
+    /* the ring starts at the live edge of the feed */
+    ret = avformat_open_input(&s, feed->feed_filename,
+                              av_find_input_format("ffm"), NULL);
+    if (ret >= 0)
+        ret = ffio_set_buf_size(s->pb, FFM_PACKET_SIZE);
+    if (ret < 0) {
+        http_log("Could not open feed '%s' for its packet ring, "
+                 "disabling it: %s\n", feed->feed_filename, av_err2str(ret));
+        avformat_close_input(&s);
+        feed->packet_ring_size = 0;
+        return NULL;
+    }
+    s->flags |= AVFMT_FLAG_GENPTS;
+    av_seek_frame(s, -1, av_gettime(), 0);
+    ring->fmt_in = s;
+    return ring;
+}
+
+/* read the next packet of the feed into the ring, evicting the oldest
+ * packets to stay within the memory budget */
+static int feed_ring_fill(FFServerStream *feed, FeedPacketRing *ring)
+{
+    AVPacket pkt;
+    int ret;
+
+    ffm_set_write_index(ring->fmt_in, feed->feed_write_index, feed->feed_size);
+    if ((ret = av_read_frame(ring->fmt_in, &pkt)) < 0)
+        return ret;
+    if ((ret = av_dup_packet(&pkt)) < 0) {
+        av_free_packet(&pkt);
+        return ret;
+    }
+
+    while (ring->first < ring->next &&
+           (ring->next - ring->first >= FEED_RING_MAX_PACKETS ||
+            ring->mem_size + pkt.size > feed->packet_ring_size)) {
+        AVPacket *old = FEED_RING_PKT(ring, ring->first);
+        ring->mem_size -= old->size;
+        av_free_packet(old);
+        ring->first++;
+    }
+
+    *FEED_RING_PKT(ring, ring->next) = pkt;
+    ring->next++;
+    ring->mem_size += pkt.size;
+    return 0;
+}
+
+/* Start taking the packets of c from the ring if pkt, read from the own
+ * reader of c, is found there. Packets of an FFM feed all use the same
+ * time base, so their timestamps can be compared across streams. */
+static void feed_ring_attach(HTTPContext *c, FeedPacketRing *ring,
+                             const AVPacket *pkt)
+{
+    FFServerStream *feed = c->stream->feed;
+    int64_t seq;
+
+    /* still behind the ring */
+    if (ring->first < ring->next &&
+        FEED_RING_PKT(ring, ring->first)->dts > pkt->dts)
+        return;
+
+    while (ring->first == ring->next ||
+           FEED_RING_PKT(ring, ring->next - 1)->dts < pkt->dts)
+        if (feed_ring_fill(feed, ring) < 0)
+            return;
+
+    for (seq = ring->next - 1; seq >= ring->first; seq--) {
+        AVPacket *p = FEED_RING_PKT(ring, seq);
+        if (p->dts < pkt->dts)
+            break;
+        if (p->pos == pkt->pos && p->pts == pkt->pts &&
+            p->stream_index == pkt->stream_index) {
+            c->ring_attached = 1;
+            c->ring_seq = seq + 1;
+            return;
+        }
+    }
+}
+
+/* Read the next feed packet for c: from the ring of the feed when c is
+ * attached to it, else from the feed file. */
+static int read_feed_packet(HTTPContext *c, AVPacket *pkt)
+{
+    FFServerStream *feed = c->stream->feed;
+    FeedPacketRing *ring = feed_ring_get(feed);
+    int ret;
+
+    if (c->ring_attached && (!ring || c->ring_seq < ring->first)) {
+        /* lagging behind the ring, continue from the feed file */
+        c->ring_attached = 0;
+        c->ring_resync = 1;
+        av_seek_frame(c->fmt_in, -1, c->ring_last_dts, AVSEEK_FLAG_BACKWARD);
+    }
+
+    if (c->ring_attached) {
+        if (c->ring_seq == ring->next &&
+            (ret = feed_ring_fill(feed, ring)) < 0)
+            return ret;
+        if ((ret = av_packet_ref(pkt, FEED_RING_PKT(ring, c->ring_seq))) < 0)
+            return ret;
+        c->ring_seq++;
+    } else {
+        for (;;) {
+            if ((ret = av_read_frame(c->fmt_in, pkt)) < 0)
+                return ret;
+            if (!c->ring_resync)
+                break;
+            if (pkt->pos == c->ring_last_pos && pkt->pts == c->ring_last_pts &&
+                pkt->stream_index == c->ring_last_index) {
+                c->ring_resync = 0;
+            } else if (pkt->dts > c->ring_last_dts) {
+                c->ring_resync = 0;
+                break;
+            }
+            av_free_packet(pkt);
+        }
+        if (ring)
+            feed_ring_attach(c, ring, pkt);
+    }
+
+    c->ring_last_pos   = pkt->pos;
+    c->ring_last_pts   = pkt->pts;
+    c->ring_last_dts   = pkt->dts;
+    c->ring_last_index = pkt->stream_index;
+    return 0;
+}
+
 static void update_datarate(DataRateData *drd, int64_t count)
 {
     if (!drd->time1 && !drd->count1) {
@@ -463,6 +701,16 @@ static int socket_open_listen(struct sockaddr_in *my_addr)
     tmp = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &tmp, sizeof(tmp)))
         av_log(NULL, AV_LOG_WARNING, "setsockopt SO_REUSEADDR failed\n");
+#ifdef SO_REUSEPORT
+    /* every worker listens on its own socket, the kernel spreads
+     * the incoming connections between them */
+    if (config.nb_workers > 1 &&
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &tmp, sizeof(tmp))) {
+        perror ("setsockopt SO_REUSEPORT");
+        closesocket(server_fd);
+        return -1;
+    }
+#endif
 
     my_addr->sin_family = AF_INET;
     if (bind (server_fd, (struct sockaddr *) my_addr, sizeof (*my_addr)) < 0) {
@@ -543,37 +791,224 @@ static void start_multicast(void)
         }
 
         rtp_c->state = HTTPSTATE_SEND_DATA;
+        update_connection_events(rtp_c);
+    }
+}
+
+/* return the poll() events connection c is waiting for, 0 if none */
+static int connection_poll_events(HTTPContext *c, int *delay)
+{
+    switch(c->state) {
+    case HTTPSTATE_SEND_HEADER:
+    case RTSPSTATE_SEND_REPLY:
+    case RTSPSTATE_SEND_PACKET:
+        return POLLOUT;
+    case HTTPSTATE_SEND_DATA_HEADER:
+    case HTTPSTATE_SEND_DATA:
+    case HTTPSTATE_SEND_DATA_TRAILER:
+        if (!c->is_packetized) {
+            /* for TCP, we output as much as we can
+             * (may need to put a limit) */
+            return POLLOUT;
+        }
+        /* when ffserver is doing the timing, we work by
+         * looking at which packet needs to be sent every
+         * 10 ms (one tick wait XXX: 10 ms assumed) */
+        if (*delay > 10)
+            *delay = 10;
+        return 0;
+    case HTTPSTATE_WAIT_FEED:
+        /* the feed may be received by another worker, which cannot
+         * wake us up: check it regularly */
+        if (config.nb_workers > 1 && *delay > 10)
+            *delay = 10;
+        return POLLIN;
+    case HTTPSTATE_WAIT_REQUEST:
+    case HTTPSTATE_RECEIVE_DATA:
+    case RTSPSTATE_WAIT_REQUEST:
+        /* need to catch errors */
+        return POLLIN; /* Maybe this will work */
+    default:
+        return 0;
+    }
+}
+
+#if HAVE_EPOLL_CREATE1
+/* register the events connection c is waiting for, if they changed */
+static int epoll_update_connection(HTTPContext *c, int events)
+{
+    struct epoll_event ev = { 0 };
+    int op;
+
+    if (c->fd < 0 || events == c->epoll_events)
+        return 0;
+
+    if (!events)
+        op = EPOLL_CTL_DEL;
+    else if (!c->epoll_events)
+        op = EPOLL_CTL_ADD;
+    else
+        op = EPOLL_CTL_MOD;
+    ev.events   = (events & POLLIN  ? EPOLLIN  : 0) |
+                  (events & POLLOUT ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd, op, c->fd, &ev) < 0) {
+        http_log("epoll_ctl failed on fd %d: %s\n", c->fd, strerror(errno));
+        return AVERROR(errno);
+    }
+    c->epoll_events = events;
+    return 0;
+}
+
+static int epoll_add_server(int fd, void *opaque)
+{
+    struct epoll_event ev = { 0 };
+
+    ev.events   = EPOLLIN;
+    ev.data.ptr = opaque;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        http_log("epoll_ctl failed on server fd %d: %s\n", fd, strerror(errno));
+        return AVERROR(errno);
+    }
+    return 0;
+}
+
+static void queue_connection(HTTPContext **queue, HTTPContext *c)
+{
+    if (c->queued)
+        return;
+    c->next_queued = *queue;
+    *queue = c;
+    c->queued = 1;
+}
+
+static void unqueue_connection(HTTPContext *c)
+{
+    HTTPContext **queues[] = { &run_queue, &tick_queue }, **cp;
+    int i;
+
+    if (!c->queued)
+        return;
+    for (i = 0; i < FF_ARRAY_ELEMS(queues); i++) {
+        for (cp = queues[i]; *cp; cp = &(*cp)->next_queued) {
+            if (*cp == c) {
+                *cp = c->next_queued;
+                c->queued = 0;
+                return;
+            }
+        }
     }
 }
 
+static void timer_remove(HTTPContext *c)
+{
+    if (!c->timer_armed)
+        return;
+    if (c->timer_prev)
+        c->timer_prev->timer_next = c->timer_next;
+    else
+        first_timer_ctx = c->timer_next;
+    if (c->timer_next)
+        c->timer_next->timer_prev = c->timer_prev;
+    else
+        last_timer_ctx = c->timer_prev;
+    c->timer_prev = c->timer_next = NULL;
+    c->timer_armed = 0;
+}
+
+/* (re)insert c according to c->timeout. The timeouts are a constant
+ * offset from the current time, so this is nearly always an append. */
+static void timer_insert(HTTPContext *c)
+{
+    HTTPContext *prev = last_timer_ctx;
+
+    timer_remove(c);
+    while (prev && prev->timeout > c->timeout)
+        prev = prev->timer_prev;
+    c->timer_prev = prev;
+    c->timer_next = prev ? prev->timer_next : first_timer_ctx;
+    if (c->timer_next)
+        c->timer_next->timer_prev = c;
+    else
+        last_timer_ctx = c;
+    if (prev)
+        prev->timer_next = c;
+    else
+        first_timer_ctx = c;
+    c->timer_armed = 1;
+}
+#endif
+
+/**
+ * Bring the epoll registration, the tick queue and the timeout list in
+ * line with the current state of c. Must be called whenever the state of
+ * a connection changes outside of its own handle_connection() call.
+ */
+static void update_connection_events(HTTPContext *c)
+{
+#if HAVE_EPOLL_CREATE1
+    int delay = 1000, ev;
+
+    if (epoll_fd < 0)
+        return;
+
+    c->poll_entry = &c->epoll_entry;
+    ev = connection_poll_events(c, &delay);
+    epoll_update_connection(c, ev);
+    if (delay < 1000)
+        queue_connection(&tick_queue, c);
+    if (c->state != HTTPSTATE_WAIT_REQUEST &&
+        c->state != RTSPSTATE_WAIT_REQUEST)
+        timer_remove(c);
+#endif
+}
+
+/* fork the additional worker processes, each runs its own http_server() */
+static int start_workers(void)
+{
+    int i;
+
+    main_pid = getpid();
+    for (i = 1; i < config.nb_workers; i++) {
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            http_log("Could not fork worker %d: %s\n", i, strerror(errno));
+            return -1;
+        }
+        if (!pid) {
+            worker_index = i;
+            /* RTSP session ids must differ between workers */
+            av_lfg_init(&random_state, av_get_random_seed());
+            return 0;
+        }
+    }
+    http_log("Started %d worker processes\n", config.nb_workers);
+    return 0;
+}
+
 /* main loop of the HTTP server */
 static int http_server(void)
 {
     int server_fd = 0, rtsp_server_fd = 0;
     int ret, delay;
-    struct pollfd *poll_table, *poll_entry;
+    int new_http, new_rtsp;
+    struct pollfd *poll_table = NULL, *poll_entry;
     HTTPContext *c, *c_next;
-
-    poll_table = av_mallocz_array(config.nb_max_http_connections + 2,
-                                  sizeof(*poll_table));
-    if(!poll_table) {
-        http_log("Impossible to allocate a poll table handling %d "
-                 "connections.\n", config.nb_max_http_connections);
-        return -1;
-    }
+#if HAVE_EPOLL_CREATE1
+    struct epoll_event *events = NULL;
+    int i;
+#endif
 
     if (config.http_addr.sin_port) {
         server_fd = socket_open_listen(&config.http_addr);
-        if (server_fd < 0) {
-            av_free(poll_table);
+        if (server_fd < 0)
             return -1;
-        }
     }
 
     if (config.rtsp_addr.sin_port) {
         rtsp_server_fd = socket_open_listen(&config.rtsp_addr);
         if (rtsp_server_fd < 0) {
-            av_free(poll_table);
             closesocket(server_fd);
             return -1;
         }
@@ -581,89 +1016,144 @@ static int http_server(void)
 
     if (!rtsp_server_fd && !server_fd) {
         http_log("HTTP and RTSP disabled.\n");
-        av_free(poll_table);
         return -1;
     }
 
-    http_log("FFserver started.\n");
+#if HAVE_EPOLL_CREATE1
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    events   = av_malloc_array(EPOLL_MAX_EVENTS, sizeof(*events));
+    if (epoll_fd < 0 || !events ||
+        (server_fd      && epoll_add_server(server_fd,      &server_fd)      < 0) ||
+        (rtsp_server_fd && epoll_add_server(rtsp_server_fd, &rtsp_server_fd) < 0)) {
+        http_log("Could not set up epoll, falling back to poll\n");
+        if (epoll_fd >= 0)
+            close(epoll_fd);
+        epoll_fd = -1;
+        av_freep(&events);
+    }
+    if (epoll_fd < 0)
+#endif
+    {
+        poll_table = av_mallocz_array(config.nb_max_http_connections + 2,
+                                      sizeof(*poll_table));
+        if(!poll_table) {
+            http_log("Impossible to allocate a poll table handling %d "
+                     "connections.\n", config.nb_max_http_connections);
+            return -1;
+        }
+    }
 
-    start_children(config.first_feed);
+    if (config.nb_workers > 1) {
+        FFServerStream *feed;
+        for (feed = config.first_feed; feed; feed = feed->next_feed)
+            feed->feed_index_fd = open(feed->feed_filename, O_RDONLY);
+    }
 
-    start_multicast();
+    if (!worker_index) {
+        http_log("FFserver started.\n");
+
+        start_children(config.first_feed);
+
+        start_multicast();
+    }
 
     for(;;) {
-        poll_entry = poll_table;
-        if (server_fd) {
-            poll_entry->fd = server_fd;
-            poll_entry->events = POLLIN;
-            poll_entry++;
-        }
-        if (rtsp_server_fd) {
-            poll_entry->fd = rtsp_server_fd;
-            poll_entry->events = POLLIN;
-            poll_entry++;
-        }
-
-        /* wait for events on each HTTP handle */
-        c = first_http_ctx;
-        delay = 1000;
-        while (c) {
-            int fd;
-            fd = c->fd;
-            switch(c->state) {
-            case HTTPSTATE_SEND_HEADER:
-            case RTSPSTATE_SEND_REPLY:
-            case RTSPSTATE_SEND_PACKET:
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLOUT;
+        delay    = 1000;
+        new_http = new_rtsp = 0;
+
+        /* do not outlive the main process */
+        if (worker_index && getppid() != main_pid)
+            exit(0);
+
+#if HAVE_EPOLL_CREATE1
+        if (epoll_fd >= 0) {
+            /* connections are only looked at when epoll reports them, when
+             * they do their own timing (tick_queue) or when they time out */
+            if (tick_queue)
+                delay = 10;
+            if (first_timer_ctx) {
+                int64_t left = first_timer_ctx->timeout - av_gettime() / 1000;
+                delay = av_clip64(left + 1, 0, delay);
+            }
+
+            do {
+                ret = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, delay);
+                if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
+                    ff_neterrno() != AVERROR(EINTR)) {
+                    close(epoll_fd);
+                    epoll_fd = -1;
+                    av_free(events);
+                    return -1;
+                }
+            } while (ret < 0);
+
+            run_queue  = tick_queue;
+            tick_queue = NULL;
+            for (i = 0; i < ret; i++) {
+                uint32_t ev = events[i].events;
+                if (events[i].data.ptr == &server_fd) {
+                    new_http = 1;
+                } else if (events[i].data.ptr == &rtsp_server_fd) {
+                    new_rtsp = 1;
+                } else {
+                    c = events[i].data.ptr;
+                    c->epoll_entry.revents = (ev & EPOLLIN  ? POLLIN  : 0) |
+                                             (ev & EPOLLOUT ? POLLOUT : 0) |
+                                             (ev & EPOLLERR ? POLLERR : 0) |
+                                             (ev & EPOLLHUP ? POLLHUP : 0);
+                    queue_connection(&run_queue, c);
+                }
+            }
+        } else
+#endif
+        {
+            poll_entry = poll_table;
+            if (server_fd) {
+                poll_entry->fd = server_fd;
+                poll_entry->events = POLLIN;
                 poll_entry++;
-                break;
-            case HTTPSTATE_SEND_DATA_HEADER:
-            case HTTPSTATE_SEND_DATA:
-            case HTTPSTATE_SEND_DATA_TRAILER:
-                if (!c->is_packetized) {
-                    /* for TCP, we output as much as we can
-                     * (may need to put a limit) */
+            }
+            if (rtsp_server_fd) {
+                poll_entry->fd = rtsp_server_fd;
+                poll_entry->events = POLLIN;
+                poll_entry++;
+            }
+
+            /* wait for events on each HTTP handle */
+            for (c = first_http_ctx; c; c = c->next) {
+                int ev = connection_poll_events(c, &delay);
+                if (ev) {
                     c->poll_entry = poll_entry;
-                    poll_entry->fd = fd;
-                    poll_entry->events = POLLOUT;
+                    poll_entry->fd = c->fd;
+                    poll_entry->events = ev;
                     poll_entry++;
                 } else {
-                    /* when ffserver is doing the timing, we work by
-                     * looking at which packet needs to be sent every
-                     * 10 ms (one tick wait XXX: 10 ms assumed) */
-                    if (delay > 10)
-                        delay = 10;
+                    c->poll_entry = NULL;
                 }
-                break;
-            case HTTPSTATE_WAIT_REQUEST:
-            case HTTPSTATE_RECEIVE_DATA:
-            case HTTPSTATE_WAIT_FEED:
-            case RTSPSTATE_WAIT_REQUEST:
-                /* need to catch errors */
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLIN;/* Maybe this will work */
-                poll_entry++;
-                break;
-            default:
-                c->poll_entry = NULL;
-                break;
             }
-            c = c->next;
-        }
 
-        /* wait for an event on one connection. We poll at least every
-         * second to handle timeouts */
-        do {
-            ret = poll(poll_table, poll_entry - poll_table, delay);
-            if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
-                ff_neterrno() != AVERROR(EINTR)) {
-                av_free(poll_table);
-                return -1;
+            /* wait for an event on one connection. We poll at least every
+             * second to handle timeouts */
+            do {
+                ret = poll(poll_table, poll_entry - poll_table, delay);
+                if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
+                    ff_neterrno() != AVERROR(EINTR)) {
+                    av_free(poll_table);
+                    return -1;
+                }
+            } while (ret < 0);
+
+            poll_entry = poll_table;
+            if (server_fd) {
+                /* new HTTP connection request ? */
+                new_http = poll_entry->revents & POLLIN;
+                poll_entry++;
             }
-        } while (ret < 0);
+            if (rtsp_server_fd) {
+                /* new RTSP connection request ? */
+                new_rtsp = poll_entry->revents & POLLIN;
+            }
+        }
 
         cur_time = av_gettime() / 1000;
 
@@ -673,6 +1163,27 @@ static int http_server(void)
         }
 
         /* now handle the events */
+#if HAVE_EPOLL_CREATE1
+        if (epoll_fd >= 0) {
+            for (c = first_timer_ctx; c && c->timeout - cur_time < 0; c = c->timer_next)
+                queue_connection(&run_queue, c);
+
+            /* connections may close other ones, so always pop the head */
+            while ((c = run_queue)) {
+                run_queue = c->next_queued;
+                c->queued = 0;
+                c->poll_entry = &c->epoll_entry;
+                ret = handle_connection(c);
+                c->epoll_entry.revents = 0;
+                if (ret < 0) {
+                    log_connection(c);
+                    close_connection(c);
+                } else {
+                    update_connection_events(c);
+                }
+            }
+        } else
+#endif
         for(c = first_http_ctx; c; c = c_next) {
             c_next = c->next;
             if (handle_connection(c) < 0) {
@@ -682,18 +1193,10 @@ static int http_server(void)
             }
         }
 
-        poll_entry = poll_table;
-        if (server_fd) {
-            /* new HTTP connection request ? */
-            if (poll_entry->revents & POLLIN)
-                new_connection(server_fd, 0);
-            poll_entry++;
-        }
-        if (rtsp_server_fd) {
-            /* new RTSP connection request ? */
-            if (poll_entry->revents & POLLIN)
-                new_connection(rtsp_server_fd, 1);
-        }
+        if (new_http)
+            new_connection(server_fd, 0);
+        if (new_rtsp)
+            new_connection(rtsp_server_fd, 1);
     }
 }
 
@@ -706,6 +1209,10 @@ static void start_wait_request(HTTPContext *c, int is_rtsp)
     c->state = is_rtsp ? RTSPSTATE_WAIT_REQUEST : HTTPSTATE_WAIT_REQUEST;
     c->timeout = cur_time +
                  (is_rtsp ? RTSP_REQUEST_TIMEOUT : HTTP_REQUEST_TIMEOUT);
+#if HAVE_EPOLL_CREATE1
+    if (epoll_fd >= 0)
+        timer_insert(c);
+#endif
 }
 
 static void http_send_too_busy_reply(int fd)
@@ -763,10 +1270,13 @@ static void new_connection(int server_fd, int is_rtsp)
         goto fail;
 
     c->next = first_http_ctx;
+    if (first_http_ctx)
+        first_http_ctx->prev = c;
     first_http_ctx = c;
     nb_connections++;
 
     start_wait_request(c, is_rtsp);
+    update_connection_events(c);
 
     return;
 
@@ -780,28 +1290,35 @@ static void new_connection(int server_fd, int is_rtsp)
 
 static void close_connection(HTTPContext *c)
 {
-    HTTPContext **cp, *c1;
+    HTTPContext *c1;
     int i, nb_streams;
     AVFormatContext *ctx;
     AVStream *st;
 
     /* remove connection from list */
-    cp = &first_http_ctx;
-    while (*cp) {
-        c1 = *cp;
-        if (c1 == c)
-            *cp = c->next;
-        else
-            cp = &c1->next;
-    }
-
-    /* remove references, if any (XXX: do it faster) */
-    for(c1 = first_http_ctx; c1; c1 = c1->next) {
-        if (c1->rtsp_c == c)
-            c1->rtsp_c = NULL;
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        first_http_ctx = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+
+    /* remove references, if any */
+    if (c->rtsp_c_used) {
+        for(c1 = first_http_ctx; c1; c1 = c1->next) {
+            if (c1->rtsp_c == c)
+                c1->rtsp_c = NULL;
+        }
     }
 
     /* remove connection associated resources */
+#if HAVE_EPOLL_CREATE1
+    /* the socket may still be open in a child process, so closing it
+     * does not necessarily remove it from the epoll set */
+    epoll_update_connection(c, 0);
+    unqueue_connection(c);
+    timer_remove(c);
+#endif
     if (c->fd >= 0)
         closesocket(c->fd);
     if (c->fmt_in) {
@@ -961,9 +1478,8 @@ static int handle_connection(HTTPContext *c)
         if (c->state == HTTPSTATE_SEND_DATA_TRAILER)
             return -1;
         /* Check if it is a single jpeg frame 123 */
-        if (c->stream->single_frame && c->data_count > c->cur_frame_bytes && c->cur_frame_bytes > 0) {
-            close_connection(c);
-        }
+        if (c->stream->single_frame && c->data_count > c->cur_frame_bytes && c->cur_frame_bytes > 0)
+            return -1;
         break;
     case HTTPSTATE_RECEIVE_DATA:
         /* no need to read if no events */
@@ -979,7 +1495,10 @@ static int handle_connection(HTTPContext *c)
         if (c->poll_entry->revents & (POLLIN | POLLERR | POLLHUP))
             return -1;
 
-        /* nothing to do, we'll be waken up by incoming feed packets */
+        /* nothing to do, we'll be waken up by incoming feed packets,
+         * unless another worker receives the feed */
+        if (config.nb_workers > 1 && !c->stream->feed->feed_opened)
+            c->state = HTTPSTATE_SEND_DATA;
         break;
 
     case RTSPSTATE_SEND_REPLY:
@@ -2206,10 +2725,12 @@ static int http_prepare_data(HTTPContext *c)
     case HTTPSTATE_SEND_DATA:
         /* find a new packet */
         /* read a packet from the input stream */
-        if (c->stream->feed)
+        if (c->stream->feed) {
+            update_feed_index(c->stream->feed);
             ffm_set_write_index(c->fmt_in,
                                 c->stream->feed->feed_write_index,
                                 c->stream->feed->feed_size);
+        }
 
         if (c->stream->max_time &&
             c->stream->max_time + c->start_time - cur_time < 0)
@@ -2218,7 +2739,10 @@ static int http_prepare_data(HTTPContext *c)
         else {
             AVPacket pkt;
         redo:
-            ret = av_read_frame(c->fmt_in, &pkt);
+            if (c->stream->feed)
+                ret = read_feed_packet(c, &pkt);
+            else
+                ret = av_read_frame(c->fmt_in, &pkt);
             if (ret < 0) {
                 if (c->stream->feed) {
                     /* if coming from feed, it means we reached the end of the
@@ -2459,6 +2983,7 @@ static int http_send_data(HTTPContext *c)
                          * send it later, so a new state is needed to
                          * "lock" the RTSP TCP connection */
                         rtsp_c->state = RTSPSTATE_SEND_PACKET;
+                        update_connection_events(rtsp_c);
                         break;
                     } else
                         /* all data has been sent */
@@ -2523,9 +3048,19 @@ static int http_start_receive_data(HTTPContext *c)
                  c->stream->feed_filename, strerror(errno));
         return ret;
     }
+#if HAVE_FLOCK
+    /* feed_opened is only known to this worker */
+    if (config.nb_workers > 1 && flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        http_log("Feed '%s' is already being received by another worker\n",
+                 c->stream->feed_filename);
+        close(fd);
+        return AVERROR(EBUSY);
+    }
+#endif
     c->feed_fd = fd;
 
     if (c->stream->truncate) {
+        feed_ring_reset(c->stream);
         /* truncate feed file */
         ffm_write_write_index(c->feed_fd, FFM_PACKET_SIZE);
         http_log("Truncating feed file '%s'\n", c->stream->feed_filename);
@@ -2653,8 +3188,10 @@ static int http_receive_data(HTTPContext *c)
             /* wake up any waiting connections */
             for(c1 = first_http_ctx; c1; c1 = c1->next) {
                 if (c1->state == HTTPSTATE_WAIT_FEED &&
-                    c1->stream->feed == c->stream->feed)
+                    c1->stream->feed == c->stream->feed) {
                     c1->state = HTTPSTATE_SEND_DATA;
+                    update_connection_events(c1);
+                }
             }
         } else {
             /* We have a header in our hands that contains useful data */
@@ -2712,8 +3249,10 @@ static int http_receive_data(HTTPContext *c)
     /* wake up any waiting connections to stop waiting for feed */
     for(c1 = first_http_ctx; c1; c1 = c1->next) {
         if (c1->state == HTTPSTATE_WAIT_FEED &&
-            c1->stream->feed == c->stream->feed)
+            c1->stream->feed == c->stream->feed) {
             c1->state = HTTPSTATE_SEND_DATA_TRAILER;
+            update_connection_events(c1);
+        }
     }
     return -1;
 }
@@ -3175,6 +3714,7 @@ static void rtsp_cmd_play(HTTPContext *c, const char *url, RTSPMessageHeader *h)
     }
 
     rtp_c->state = HTTPSTATE_SEND_DATA;
+    update_connection_events(rtp_c);
 
     /* now everything is OK, so we can send the connection parameters */
     rtsp_reply_header(c, RTSP_STATUS_OK);
@@ -3202,6 +3742,7 @@ static void rtsp_cmd_interrupt(HTTPContext *c, const char *url,
         }
         rtp_c->state = HTTPSTATE_READY;
         rtp_c->first_pts = AV_NOPTS_VALUE;
+        update_connection_events(rtp_c);
     }
 
     /* now everything is OK, so we can send the connection parameters */
@@ -3270,6 +3811,8 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
     current_bandwidth += stream->bandwidth;
 
     c->next = first_http_ctx;
+    if (first_http_ctx)
+        first_http_ctx->prev = c;
     first_http_ctx = c;
     return c;
 
@@ -3351,6 +3894,7 @@ static int rtp_new_av_stream(HTTPContext *c,
     case RTSP_LOWER_TRANSPORT_TCP:
         /* RTP/TCP case */
         c->rtsp_c = rtsp_c;
+        rtsp_c->rtsp_c_used = 1;
         max_packet_size = RTSP_TCP_MAX_PACKET_SIZE;
         break;
     default:
@@ -3862,6 +4406,15 @@ int main(int argc, char **argv)
     /* signal init */
     signal(SIGPIPE, SIG_IGN);
 
+#if !defined(SO_REUSEPORT) || !HAVE_FLOCK
+    if (config.nb_workers > 1) {
+        http_log("Workers is not supported on this system, using a single process\n");
+        config.nb_workers = 1;
+    }
+#endif
+    if (config.nb_workers > 1 && start_workers() < 0)
+        exit(1);
+
     if (http_server() < 0) {
         http_log("Could not start server\n");
         exit(1);
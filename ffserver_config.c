@@ -24,6 +24,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 
 // FIXME those are internal headers, ffserver _really_ shouldn't use them
 #include "libavformat/ffm.h"
@@ -657,6 +658,11 @@ static int ffserver_parse_config_global(FFServerConfig *config, const char *cmd,
                   "MaxHTTPConnections(%d)\n", config->nb_max_connections,
                   config->nb_max_http_connections);
         }
+    } else if (!av_strcasecmp(cmd, "Workers")) {
+        ffserver_get_arg(arg, sizeof(arg), p);
+        ffserver_set_int_param(&val, arg, 0, 0, 1024, config,
+                "Invalid Workers: '%s'\n", arg);
+        config->nb_workers = val ? val : av_cpu_count();
     } else if (!av_strcasecmp(cmd, "MaxBandwidth")) {
         int64_t llval;
         char *tailp;
@@ -683,6 +689,31 @@ static int ffserver_parse_config_global(FFServerConfig *config, const char *cmd,
     return 0;
 }
 
+/* parse a size in bytes with an optional K, M or G postfix */
+static int ffserver_parse_size(const char *arg, int64_t *size)
+{
+    char *p1;
+    double fsize = strtod(arg, &p1);
+
+    switch(av_toupper(*p1)) {
+    case 'K':
+        fsize *= 1024;
+        break;
+    case 'M':
+        fsize *= 1024 * 1024;
+        break;
+    case 'G':
+        fsize *= 1024 * 1024 * 1024;
+        break;
+    case '\0':
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    *size = (int64_t)fsize;
+    return 0;
+}
+
 static int ffserver_parse_config_feed(FFServerConfig *config, const char *cmd, const char **p,
                                       FFServerStream **pfeed)
 {
@@ -758,31 +789,18 @@ static int ffserver_parse_config_feed(FFServerConfig *config, const char *cmd, c
             feed->truncate = strtod(arg, NULL);
         }
     } else if (!av_strcasecmp(cmd, "FileMaxSize")) {
-        char *p1;
-        double fsize;
-
         ffserver_get_arg(arg, sizeof(arg), p);
-        p1 = arg;
-        fsize = strtod(p1, &p1);
-        switch(av_toupper(*p1)) {
-        case 'K':
-            fsize *= 1024;
-            break;
-        case 'M':
-            fsize *= 1024 * 1024;
-            break;
-        case 'G':
-            fsize *= 1024 * 1024 * 1024;
-            break;
-        default:
+        if (ffserver_parse_size(arg, &feed->feed_max_size) < 0)
             ERROR("Invalid file size: '%s'\n", arg);
-            break;
-        }
-        feed->feed_max_size = (int64_t)fsize;
         if (feed->feed_max_size < FFM_PACKET_SIZE*4) {
             ERROR("Feed max file size is too small. Must be at least %d.\n",
                   FFM_PACKET_SIZE*4);
         }
+    } else if (!av_strcasecmp(cmd, "PacketRingSize")) {
+        ffserver_get_arg(arg, sizeof(arg), p);
+        if (ffserver_parse_size(arg, &feed->packet_ring_size) < 0 ||
+            feed->packet_ring_size < 0)
+            ERROR("Invalid packet ring size: '%s'\n", arg);
     } else if (!av_strcasecmp(cmd, "</Feed>")) {
         *pfeed = NULL;
     } else {
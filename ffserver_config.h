@@ -91,6 +91,10 @@ typedef struct FFServerStream {
     int64_t feed_max_size;        /* maximum storage size, zero means unlimited */
     int64_t feed_write_index;     /* current write position in feed (it wraps around) */
     int64_t feed_size;            /* current size of feed */
+    int feed_index_fd;            /* used to follow a feed received by another worker */
+    int64_t feed_index_time;      /* last time the write index was read from the file */
+    int64_t packet_ring_size;     /* memory budget of the shared packet ring, zero disables it */
+    struct FeedPacketRing *packet_ring;
     struct FFServerStream *next_feed;
 } FFServerStream;
 
@@ -101,6 +105,7 @@ typedef struct FFServerConfig {
     unsigned int nb_max_http_connections;
     unsigned int nb_max_connections;
     uint64_t max_bandwidth;
+    int nb_workers;
     int debug;
     char logfilename[1024];
     struct sockaddr_in http_addr;
@@ -88,7 +88,7 @@ static void encode_window_bands_info(AACEncContext *s, SingleChannelElement *sce
     float next_minrd = INFINITY;
     int next_mincb = 0;
 
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->abs_pow34(s->scoefs, sce->coeffs, 1024);
     start = win*128;
     for (cb = 0; cb < CB_TOT_ALL; cb++) {
         path[0][cb].cost     = 0.0f;
@@ -198,7 +198,7 @@ static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
     float next_minbits = INFINITY;
     int next_mincb = 0;
 
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->abs_pow34(s->scoefs, sce->coeffs, 1024);
     start = win*128;
     for (cb = 0; cb < CB_TOT_ALL; cb++) {
         path[0][cb].cost     = run_bits+4;
@@ -316,6 +316,53 @@ static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
     }
 }
 
+/**
+ * Encode band info for single window group bands using the smallest codebook
+ * able to represent each band instead of searching for the cheapest one.
+ */
+static void codebook_min_rate(AACEncContext *s, SingleChannelElement *sce,
+                              int win, int group_len, const float lambda)
+{
+    int swb, cb, start, count;
+    const int max_sfb  = sce->ics.max_sfb;
+    const int run_bits = sce->ics.num_windows == 1 ? 5 : 3;
+    const int run_esc  = (1 << run_bits) - 1;
+    int prevcb = -1, run = 0;
+
+    s->abs_pow34(s->scoefs, sce->coeffs, 1024);
+    start = win*128;
+    for (swb = 0; swb <= max_sfb; swb++) {
+        if (swb == max_sfb) {
+            cb = -1;
+        } else if (sce->zeroes[win*16 + swb]) {
+            cb = 0;
+        } else if (sce->band_type[win*16 + swb] >= RESERVED_BT) {
+            cb = sce->band_type[win*16 + swb];
+        } else {
+            float maxval = find_max_val(group_len, sce->ics.swb_sizes[swb],
+                                        &s->scoefs[start]);
+            cb = find_min_book(maxval, sce->sf_idx[win*16 + swb]);
+        }
+        if (cb != prevcb && run) {
+            put_bits(&s->pb, 4, prevcb);
+            count = run;
+            while (count >= run_esc) {
+                put_bits(&s->pb, run_bits, run_esc);
+                count -= run_esc;
+            }
+            put_bits(&s->pb, run_bits, count);
+            run = 0;
+        }
+        if (swb == max_sfb)
+            break;
+        sce->zeroes[win*16 + swb]    = !cb;
+        sce->band_type[win*16 + swb] = cb;
+        prevcb = cb;
+        run++;
+        start += sce->ics.swb_sizes[swb];
+    }
+}
+
 typedef struct TrellisPath {
     float cost;
     int prev;
@@ -422,7 +469,7 @@ static void search_for_quantizers_anmr(AVCodecContext *avctx, AACEncContext *s,
         }
     }
     idx = 1;
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->abs_pow34(s->scoefs, sce->coeffs, 1024);
     for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w]) {
         start = w*128;
         for (g = 0; g < sce->ics.num_swb; g++) {
@@ -513,11 +560,14 @@ static void search_for_quantizers_anmr(AVCodecContext *avctx, AACEncContext *s,
 
 /**
  * two-loop quantizers search taken from ISO 13818-7 Appendix C
+ *
+ * @param max_its maximum number of outer (distortion control) loop iterations
  */
-static void search_for_quantizers_twoloop(AVCodecContext *avctx,
-                                          AACEncContext *s,
-                                          SingleChannelElement *sce,
-                                          const float lambda)
+static av_always_inline void search_for_quantizers_twoloop_internal(AVCodecContext *avctx,
+                                                                    AACEncContext *s,
+                                                                    SingleChannelElement *sce,
+                                                                    const float lambda,
+                                                                    const int max_its)
 {
     int start = 0, i, w, w2, g;
     int destbits = avctx->bit_rate * 1024.0 / avctx->sample_rate / avctx->channels * (lambda / 120.f);
@@ -566,7 +616,7 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
 
     if (!allz)
         return;
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->abs_pow34(s->scoefs, sce->coeffs, 1024);
 
     for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w]) {
         start = w*128;
@@ -658,7 +708,15 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
             }
         }
         its++;
-    } while (fflag && its < 10);
+    } while (fflag && its < max_its);
+}
+
+static void search_for_quantizers_twoloop(AVCodecContext *avctx,
+                                          AACEncContext *s,
+                                          SingleChannelElement *sce,
+                                          const float lambda)
+{
+    search_for_quantizers_twoloop_internal(avctx, s, sce, lambda, 10);
 }
 
 static void search_for_quantizers_faac(AVCodecContext *avctx, AACEncContext *s,
@@ -748,7 +806,7 @@ static void search_for_quantizers_faac(AVCodecContext *avctx, AACEncContext *s,
         }
     }
     memset(sce->sf_idx, 0, sizeof(sce->sf_idx));
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->abs_pow34(s->scoefs, sce->coeffs, 1024);
     for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w]) {
         start = w*128;
         for (g = 0;  g < sce->ics.num_swb; g++) {
@@ -829,38 +887,15 @@ static void search_for_quantizers_faac(AVCodecContext *avctx, AACEncContext *s,
     }
 }
 
+/**
+ * Twoloop with a single quality refinement pass, the rate fit still keeps
+ * the frames within the bit budget.
+ */
 static void search_for_quantizers_fast(AVCodecContext *avctx, AACEncContext *s,
                                        SingleChannelElement *sce,
                                        const float lambda)
 {
-    int i, w, w2, g;
-    int minq = 255;
-
-    memset(sce->sf_idx, 0, sizeof(sce->sf_idx));
-    for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w]) {
-        for (g = 0; g < sce->ics.num_swb; g++) {
-            for (w2 = 0; w2 < sce->ics.group_len[w]; w2++) {
-                FFPsyBand *band = &s->psy.ch[s->cur_channel].psy_bands[(w+w2)*16+g];
-                if (band->energy <= band->threshold) {
-                    sce->sf_idx[(w+w2)*16+g] = 218;
-                    sce->zeroes[(w+w2)*16+g] = 1;
-                } else {
-                    sce->sf_idx[(w+w2)*16+g] = av_clip(SCALE_ONE_POS - SCALE_DIV_512 + log2f(band->threshold), 80, 218);
-                    sce->zeroes[(w+w2)*16+g] = 0;
-                }
-                minq = FFMIN(minq, sce->sf_idx[(w+w2)*16+g]);
-            }
-        }
-    }
-    for (i = 0; i < 128; i++) {
-        sce->sf_idx[i] = 140;
-        //av_clip(sce->sf_idx[i], minq, minq + SCALE_MAX_DIFF - 1);
-    }
-    //set the same quantizers inside window groups
-    for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w])
-        for (g = 0;  g < sce->ics.num_swb; g++)
-            for (w2 = 1; w2 < sce->ics.group_len[w]; w2++)
-                sce->sf_idx[(w+w2)*16+g] = sce->sf_idx[w*16+g];
+    search_for_quantizers_twoloop_internal(avctx, s, sce, lambda, 1);
 }
 
 static void search_for_pns(AACEncContext *s, AVCodecContext *avctx, SingleChannelElement *sce)
@@ -916,8 +951,8 @@ static void search_for_pns(AACEncContext *s, AVCodecContext *avctx, SingleChanne
                 scale = noise_amp/sqrtf(band_energy);
                 s->fdsp->vector_fmul_scalar(PNS, PNS, scale, sce->ics.swb_sizes[g]);
                 pns_energy += s->fdsp->scalarproduct_float(PNS, PNS, sce->ics.swb_sizes[g]);
-                abs_pow34_v(NOR34, &sce->coeffs[start_c], sce->ics.swb_sizes[g]);
-                abs_pow34_v(PNS34, PNS, sce->ics.swb_sizes[g]);
+                s->abs_pow34(NOR34, &sce->coeffs[start_c], sce->ics.swb_sizes[g]);
+                s->abs_pow34(PNS34, PNS, sce->ics.swb_sizes[g]);
                 dist1 += quantize_band_cost(s, &sce->coeffs[start_c],
                                             NOR34,
                                             sce->ics.swb_sizes[g],
@@ -972,10 +1007,10 @@ static void search_for_ms(AACEncContext *s, ChannelElement *cpe)
                         S[i] =  M[i]
                               - sce1->coeffs[start+(w+w2)*128+i];
                     }
-                    abs_pow34_v(L34, sce0->coeffs+start+(w+w2)*128, sce0->ics.swb_sizes[g]);
-                    abs_pow34_v(R34, sce1->coeffs+start+(w+w2)*128, sce0->ics.swb_sizes[g]);
-                    abs_pow34_v(M34, M,                         sce0->ics.swb_sizes[g]);
-                    abs_pow34_v(S34, S,                         sce0->ics.swb_sizes[g]);
+                    s->abs_pow34(L34, sce0->coeffs+start+(w+w2)*128, sce0->ics.swb_sizes[g]);
+                    s->abs_pow34(R34, sce1->coeffs+start+(w+w2)*128, sce0->ics.swb_sizes[g]);
+                    s->abs_pow34(M34, M,                         sce0->ics.swb_sizes[g]);
+                    s->abs_pow34(S34, S,                         sce0->ics.swb_sizes[g]);
                     dist1 += quantize_band_cost(s, &sce0->coeffs[start + (w+w2)*128],
                                                 L34,
                                                 sce0->ics.swb_sizes[g],
@@ -1059,7 +1094,7 @@ AACCoefficientsEncoder ff_aac_coders[AAC_CODER_NB] = {
     },
     [AAC_CODER_FAST] = {
         search_for_quantizers_fast,
-        encode_window_bands_info,
+        codebook_min_rate,
         quantize_and_encode_band,
         ff_aac_encode_tns_info,
         ff_aac_encode_main_pred,
@@ -39,6 +39,7 @@
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/rational.h"
+#include "libavutil/threadpool.h"
 
 #include "version.h"
 
@@ -3279,6 +3280,40 @@ typedef struct AVCodecContext {
     unsigned properties;
 #define FF_CODEC_PROPERTY_LOSSLESS        0x00000001
 #define FF_CODEC_PROPERTY_CLOSED_CAPTIONS 0x00000002
+
+    /**
+     * Thread pool on which slice threading runs its jobs, instead of threads
+     * owned by this context. thread_count still caps the number of threads
+     * working for this context at the same time. Frame threading is not
+     * affected. The pool must outlive the codec context.
+     * Code outside libavcodec should access this field using
+     * av_codec_{get,set}_thread_pool()
+     * - encoding: Set by user before avcodec_open2().
+     * - decoding: Set by user before avcodec_open2().
+     */
+    AVThreadPool *thread_pool;
+
+    /**
+     * Priority of the jobs of this context on thread_pool, the jobs of
+     * contexts with a higher priority run first.
+     * Code outside libavcodec should access this field using AVOptions
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int thread_pool_priority;
+
+    /**
+     * Maximum number of frames of delay frame threading may add, -1 for no
+     * limit. Frame threading is then limited to thread_max_delay + 1
+     * threads. If the decoder supports it, the remaining threads are used
+     * for slice threading inside each frame thread; with 0, only slice
+     * threading is used.
+     * The delay actually added is exported in delay and the number of frame
+     * threads in thread_count.
+     * - encoding: unused
+     * - decoding: Set by user before avcodec_open2().
+     */
+    int thread_max_delay;
 } AVCodecContext;
 
 AVRational av_codec_get_pkt_timebase         (const AVCodecContext *avctx);
@@ -3298,6 +3333,9 @@ void av_codec_set_seek_preroll(AVCodecContext *avctx, int val);
 uint16_t *av_codec_get_chroma_intra_matrix(const AVCodecContext *avctx);
 void av_codec_set_chroma_intra_matrix(AVCodecContext *avctx, uint16_t *val);
 
+AVThreadPool *av_codec_get_thread_pool(const AVCodecContext *avctx);
+void          av_codec_set_thread_pool(AVCodecContext *avctx, AVThreadPool *val);
+
 /**
  * AVProfile.
  */
@@ -108,6 +108,10 @@ typedef struct FFV1Context {
     int ec;
     int intra;
     int slice_damaged;
+    const uint8_t *slice_buf;            ///< slice data covered by the CRC
+    int slice_buf_size;
+    unsigned slice_crc;                  ///< CRC residue of the slice, 0 if intact
+    volatile int slice_done;             ///< set once the slice is decoded
     int key_frame_ok;
 
     int bits_per_raw_sample;
@@ -25,6 +25,7 @@
  * FF Video Codec 1 (a lossless codec) decoder
  */
 
+#include "libavutil/atomic.h"
 #include "libavutil/avassert.h"
 #include "libavutil/crc.h"
 #include "libavutil/opt.h"
@@ -198,7 +199,9 @@ static void decode_plane(FFV1Context *s, uint8_t *src,
         sample[1][-1] = sample[0][0];
         sample[0][w]  = sample[0][w - 1];
 
-// { START_TIMER
+#ifdef DECODE_LINE_STATS
+        { START_TIMER
+#endif
         if (s->avctx->bits_per_raw_sample <= 8) {
             decode_line(s, w, sample, plane_index, 8);
             for (x = 0; x < w; x++)
@@ -215,7 +218,14 @@ static void decode_plane(FFV1Context *s, uint8_t *src,
                 }
             }
         }
-// STOP_TIMER("decode-line") }
+#ifdef DECODE_LINE_STATS
+        if (s->ac) {
+            STOP_TIMER("decode-line range coder")
+        } else {
+            STOP_TIMER("decode-line golomb")
+        }
+        }
+#endif
     }
 }
 
@@ -237,6 +247,9 @@ static void decode_rgb_frame(FFV1Context *s, uint8_t *src[3], int w, int h, int
     memset(s->sample_buffer, 0, 8 * (w + 6) * sizeof(*s->sample_buffer));
 
     for (y = 0; y < h; y++) {
+#ifdef DECODE_LINE_STATS
+        { START_TIMER
+#endif
         for (p = 0; p < 3 + s->transparency; p++) {
             int16_t *temp = sample[p][0]; // FIXME: try a normal buffer
 
@@ -250,6 +263,14 @@ static void decode_rgb_frame(FFV1Context *s, uint8_t *src[3], int w, int h, int
             else
                 decode_line(s, w, sample[p], (p + 1)/2, bits + (s->slice_coding_mode != 1));
         }
+#ifdef DECODE_LINE_STATS
+        if (s->ac) {
+            STOP_TIMER("decode-line rgb range coder")
+        } else {
+            STOP_TIMER("decode-line rgb golomb")
+        }
+        }
+#endif
         for (x = 0; x < w; x++) {
             int g = sample[0][1][x];
             int b = sample[1][1][x];
@@ -366,6 +387,14 @@ static int decode_slice(AVCodecContext *c, void *arg)
     for( si=0; fs != f->slice_context[si]; si ++)
         ;
 
+    /* check the CRC here so that it runs in parallel for all slices */
+    if (f->ec) {
+        fs->slice_crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0,
+                               fs->slice_buf, fs->slice_buf_size);
+        if (fs->slice_crc)
+            fs->slice_damaged = 1;
+    }
+
     if(f->fsrc && !p->key_frame)
         ff_thread_await_progress(&f->last_picture, si, 0);
 
@@ -460,7 +489,13 @@ static int decode_slice(AVCodecContext *c, void *arg)
 
     emms_c();
 
-    ff_thread_report_progress(&f->picture, si, 0);
+    /* with slice threading, slices can finish out of order, the progress
+     * is the last slice up to which all slices are decoded */
+    avpriv_atomic_int_set(&fs->slice_done, 1);
+    for (i = 0; i < f->slice_count && avpriv_atomic_int_get(&f->slice_context[i]->slice_done); i++)
+        ;
+    if (i > si)
+        ff_thread_report_progress(&f->picture, i - 1, 0);
 
     return 0;
 }
@@ -936,24 +971,10 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame, AVPac
         }
         buf_p -= v;
 
-        if (f->ec) {
-            unsigned crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, buf_p, v);
-            if (crc) {
-                int64_t ts = avpkt->pts != AV_NOPTS_VALUE ? avpkt->pts : avpkt->dts;
-                av_log(f->avctx, AV_LOG_ERROR, "CRC mismatch %X!", crc);
-                if (ts != AV_NOPTS_VALUE && avctx->pkt_timebase.num) {
-                    av_log(f->avctx, AV_LOG_ERROR, "at %f seconds\n", ts*av_q2d(avctx->pkt_timebase));
-                } else if (ts != AV_NOPTS_VALUE) {
-                    av_log(f->avctx, AV_LOG_ERROR, "at %"PRId64"\n", ts);
-                } else {
-                    av_log(f->avctx, AV_LOG_ERROR, "\n");
-                }
-                fs->slice_damaged = 1;
-            }
-            if (avctx->debug & FF_DEBUG_PICT_INFO) {
-                av_log(avctx, AV_LOG_DEBUG, "slice %d, CRC: 0x%08X\n", i, AV_RB32(buf_p + v - 4));
-            }
-        }
+        fs->slice_buf      = buf_p;
+        fs->slice_buf_size = v;
+        if (f->ec && avctx->debug & FF_DEBUG_PICT_INFO)
+            av_log(avctx, AV_LOG_DEBUG, "slice %d, CRC: 0x%08X\n", i, AV_RB32(buf_p + v - 4));
 
         if (i) {
             ff_init_range_decoder(&fs->c, buf_p, v);
@@ -962,6 +983,7 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame, AVPac
 
         fs->avctx = avctx;
         fs->cur = p;
+        fs->slice_done = 0;
     }
 
     avctx->execute(avctx,
@@ -974,6 +996,17 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame, AVPac
     for (i = f->slice_count - 1; i >= 0; i--) {
         FFV1Context *fs = f->slice_context[i];
         int j;
+        if (f->ec && fs->slice_crc) {
+            int64_t ts = avpkt->pts != AV_NOPTS_VALUE ? avpkt->pts : avpkt->dts;
+            av_log(f->avctx, AV_LOG_ERROR, "CRC mismatch %X!", fs->slice_crc);
+            if (ts != AV_NOPTS_VALUE && avctx->pkt_timebase.num) {
+                av_log(f->avctx, AV_LOG_ERROR, "at %f seconds\n", ts*av_q2d(avctx->pkt_timebase));
+            } else if (ts != AV_NOPTS_VALUE) {
+                av_log(f->avctx, AV_LOG_ERROR, "at %"PRId64"\n", ts);
+            } else {
+                av_log(f->avctx, AV_LOG_ERROR, "\n");
+            }
+        }
         if (fs->slice_damaged && f->last_picture.f->data[0]) {
             const uint8_t *src[4];
             uint8_t *dst[4];
@@ -1118,4 +1151,5 @@ AVCodec ff_ffv1_decoder = {
     .update_thread_context = ONLY_IF_THREADS_ENABLED(update_thread_context),
     .capabilities   = AV_CODEC_CAP_DR1 /*| AV_CODEC_CAP_DRAW_HORIZ_BAND*/ |
                       AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal  = FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS,
 };
@@ -96,6 +96,12 @@ typedef struct FlacFrame {
     uint8_t crc8;
     int ch_mode;
     int verbatim_only;
+    uint32_t frame_number;
+    int max_framesize;      ///< size limit, above which verbatim mode is used
+    int size;               ///< encoded size, or a negative error code
+    int64_t pts;
+    int64_t duration;
+    LPCContext lpc_ctx;
 } FlacFrame;
 
 typedef struct FlacEncodeContext {
@@ -112,10 +118,8 @@ typedef struct FlacEncodeContext {
     uint32_t frame_count;
     uint64_t sample_count;
     uint8_t md5sum[16];
-    FlacFrame frame;
     CompressionOptions options;
     AVCodecContext *avctx;
-    LPCContext lpc_ctx;
     struct AVMD5 *md5ctx;
     uint8_t *md5_buffer;
     unsigned int md5_buffer_size;
@@ -124,6 +128,18 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /**
+     * Queue of input frames. The frames are independent once their block
+     * size is known, so a batch of them is searched in parallel. The frame
+     * numbers, MD5 and frame sizes are still handled in order.
+     */
+    FlacFrame *frames;
+    int nb_frames;          ///< size of the queue
+    int frame_index;        ///< oldest frame of the queue
+    int nb_searched;        ///< frames waiting to be written
+    int nb_queued;          ///< frames waiting to be searched
+    int last_blocksize;     ///< block size of the last queued frame
 } FlacEncodeContext;
 
 
@@ -430,8 +446,23 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
         }
     }
 
-    ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
-                      s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    /* one frame per thread is searched at once */
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
+        s->nb_frames = FFMAX(avctx->thread_count, 1);
+    else
+        s->nb_frames = 1;
+    s->frames = av_malloc_array(s->nb_frames, sizeof(*s->frames));
+    if (!s->frames)
+        return AVERROR(ENOMEM);
+    /* the sample buffers are large, only clear what close() looks at */
+    for (i = 0; i < s->nb_frames; i++)
+        memset(&s->frames[i].lpc_ctx, 0, sizeof(s->frames[i].lpc_ctx));
+    for (i = 0; i < s->nb_frames; i++) {
+        ret = ff_lpc_init(&s->frames[i].lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacdsp_init(&s->flac_dsp, avctx->sample_fmt, channels,
@@ -443,12 +474,9 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
 }
 
 
-static void init_frame(FlacEncodeContext *s, int nb_samples)
+static void init_frame(FlacEncodeContext *s, FlacFrame *frame, int nb_samples)
 {
     int i, ch;
-    FlacFrame *frame;
-
-    frame = &s->frame;
 
     for (i = 0; i < 16; i++) {
         if (nb_samples == ff_flac_blocksize_table[i]) {
@@ -488,16 +516,15 @@ static void init_frame(FlacEncodeContext *s, int nb_samples)
 /**
  * Copy channel-interleaved input samples into separate subframes.
  */
-static void copy_samples(FlacEncodeContext *s, const void *samples)
+static void copy_samples(FlacEncodeContext *s, FlacFrame *frame,
+                         const void *samples)
 {
     int i, j, ch;
-    FlacFrame *frame;
     int shift = av_get_bytes_per_sample(s->avctx->sample_fmt) * 8 -
                 s->avctx->bits_per_raw_sample;
 
 #define COPY_SAMPLES(bits) do {                                     \
     const int ## bits ## _t *samples0 = samples;                    \
-    frame = &s->frame;                                              \
     for (i = 0, j = 0; i < frame->blocksize; i++)                   \
         for (ch = 0; ch < s->channels; ch++, j++)                   \
             frame->subframes[ch].samples[i] = samples0[j] >> shift; \
@@ -524,8 +551,8 @@ static uint64_t rice_count_exact(const int32_t *res, int n, int k)
 }
 
 
-static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
-                                     int pred_order)
+static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacFrame *frame,
+                                     FlacSubframe *sub, int pred_order)
 {
     int p, porder, psize;
     int i, part_end;
@@ -541,7 +568,7 @@ static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
     if (sub->type == FLAC_SUBFRAME_CONSTANT) {
         count += sub->obits;
     } else if (sub->type == FLAC_SUBFRAME_VERBATIM) {
-        count += s->frame.blocksize * sub->obits;
+        count += frame->blocksize * sub->obits;
     } else {
         /* warm-up samples */
         count += pred_order * sub->obits;
@@ -555,7 +582,7 @@ static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
 
         /* partition order */
         porder = sub->rc.porder;
-        psize  = s->frame.blocksize >> porder;
+        psize  = frame->blocksize >> porder;
         count += 4;
 
         /* residual */
@@ -566,7 +593,7 @@ static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
             count += sub->rc.coding_mode;
             count += rice_count_exact(&sub->residual[i], part_end - i, k);
             i = part_end;
-            part_end = FFMIN(s->frame.blocksize, part_end + psize);
+            part_end = FFMIN(frame->blocksize, part_end + psize);
         }
     }
 
@@ -727,19 +754,19 @@ static int get_max_p_order(int max_porder, int n, int order)
 }
 
 
-static uint64_t find_subframe_rice_params(FlacEncodeContext *s,
+static uint64_t find_subframe_rice_params(FlacEncodeContext *s, FlacFrame *frame,
                                           FlacSubframe *sub, int pred_order)
 {
     int pmin = get_max_p_order(s->options.min_partition_order,
-                               s->frame.blocksize, pred_order);
+                               frame->blocksize, pred_order);
     int pmax = get_max_p_order(s->options.max_partition_order,
-                               s->frame.blocksize, pred_order);
+                               frame->blocksize, pred_order);
 
     uint64_t bits = 8 + pred_order * sub->obits + 2 + sub->rc.coding_mode;
     if (sub->type == FLAC_SUBFRAME_LPC)
         bits += 4 + 5 + pred_order * s->options.lpc_coeff_precision;
     bits += calc_rice_params(&sub->rc, sub->rc_udata, sub->rc_sums, pmin, pmax, sub->residual,
-                             s->frame.blocksize, pred_order, s->options.exact_rice_parameters);
+                             frame->blocksize, pred_order, s->options.exact_rice_parameters);
     return bits;
 }
 
@@ -795,17 +822,15 @@ static void encode_residual_fixed(int32_t *res, const int32_t *smp, int n,
 }
 
 
-static int encode_residual_ch(FlacEncodeContext *s, int ch)
+static int encode_residual_ch(FlacEncodeContext *s, FlacFrame *frame, int ch)
 {
     int i, n;
     int min_order, max_order, opt_order, omethod;
-    FlacFrame *frame;
     FlacSubframe *sub;
     int32_t coefs[MAX_LPC_ORDER][MAX_LPC_ORDER];
     int shift[MAX_LPC_ORDER];
     int32_t *res, *smp;
 
-    frame = &s->frame;
     sub   = &frame->subframes[ch];
     res   = sub->residual;
     smp   = sub->samples;
@@ -818,14 +843,14 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
     if (i == n) {
         sub->type = sub->type_code = FLAC_SUBFRAME_CONSTANT;
         res[0] = smp[0];
-        return subframe_count_exact(s, sub, 0);
+        return subframe_count_exact(s, frame, sub, 0);
     }
 
     /* VERBATIM */
     if (frame->verbatim_only || n < 5) {
         sub->type = sub->type_code = FLAC_SUBFRAME_VERBATIM;
         memcpy(res, smp, n * sizeof(int32_t));
-        return subframe_count_exact(s, sub, 0);
+        return subframe_count_exact(s, frame, sub, 0);
     }
 
     min_order  = s->options.min_prediction_order;
@@ -843,7 +868,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         bits[0]   = UINT32_MAX;
         for (i = min_order; i <= max_order; i++) {
             encode_residual_fixed(res, smp, n, i);
-            bits[i] = find_subframe_rice_params(s, sub, i);
+            bits[i] = find_subframe_rice_params(s, frame, sub, i);
             if (bits[i] < bits[opt_order])
                 opt_order = i;
         }
@@ -851,14 +876,14 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         sub->type_code = sub->type | sub->order;
         if (sub->order != max_order) {
             encode_residual_fixed(res, smp, n, sub->order);
-            find_subframe_rice_params(s, sub, sub->order);
+            find_subframe_rice_params(s, frame, sub, sub->order);
         }
-        return subframe_count_exact(s, sub, sub->order);
+        return subframe_count_exact(s, frame, sub, sub->order);
     }
 
     /* LPC */
     sub->type = FLAC_SUBFRAME_LPC;
-    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx, smp, n, min_order, max_order,
+    opt_order = ff_lpc_calc_coefs(&frame->lpc_ctx, smp, n, min_order, max_order,
                                   s->options.lpc_coeff_precision, coefs, shift, s->options.lpc_type,
                                   s->options.lpc_passes, omethod,
                                   MAX_LPC_SHIFT, 0);
@@ -885,7 +910,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 s->flac_dsp.lpc32_encode(res, smp, n, order+1, coefs[order],
                                          shift[order]);
             }
-            bits[i] = find_subframe_rice_params(s, sub, order+1);
+            bits[i] = find_subframe_rice_params(s, frame, sub, order+1);
             if (bits[i] < bits[opt_index]) {
                 opt_index = i;
                 opt_order = order;
@@ -903,7 +928,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
             } else {
                 s->flac_dsp.lpc32_encode(res, smp, n, i+1, coefs[i], shift[i]);
             }
-            bits[i] = find_subframe_rice_params(s, sub, i+1);
+            bits[i] = find_subframe_rice_params(s, frame, sub, i+1);
             if (bits[i] < bits[opt_order])
                 opt_order = i;
         }
@@ -925,7 +950,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 } else {
                     s->flac_dsp.lpc16_encode(res, smp, n, i+1, coefs[i], shift[i]);
                 }
-                bits[i] = find_subframe_rice_params(s, sub, i+1);
+                bits[i] = find_subframe_rice_params(s, frame, sub, i+1);
                 if (bits[i] < bits[opt_order])
                     opt_order = i;
             }
@@ -966,7 +991,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 } else {
                     s->flac_dsp.lpc32_encode(res, smp, n, opt_order, lpc_try, shift[opt_order-1]);
                 }
-                score = find_subframe_rice_params(s, sub, opt_order);
+                score = find_subframe_rice_params(s, frame, sub, opt_order);
                 if (score < best_score) {
                     best_score = score;
                     memcpy(coefs[opt_order-1], lpc_try, sizeof(*coefs));
@@ -988,13 +1013,13 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         s->flac_dsp.lpc32_encode(res, smp, n, sub->order, sub->coefs, sub->shift);
     }
 
-    find_subframe_rice_params(s, sub, sub->order);
+    find_subframe_rice_params(s, frame, sub, sub->order);
 
-    return subframe_count_exact(s, sub, sub->order);
+    return subframe_count_exact(s, frame, sub, sub->order);
 }
 
 
-static int count_frame_header(FlacEncodeContext *s)
+static int count_frame_header(FlacEncodeContext *s, FlacFrame *frame)
 {
     uint8_t av_unused tmp;
     int count;
@@ -1012,12 +1037,12 @@ static int count_frame_header(FlacEncodeContext *s)
     count = 32;
 
     /* coded frame number */
-    PUT_UTF8(s->frame_count, tmp, count += 8;)
+    PUT_UTF8(frame->frame_number, tmp, count += 8;)
 
     /* explicit block size */
-    if (s->frame.bs_code[0] == 6)
+    if (frame->bs_code[0] == 6)
         count += 8;
-    else if (s->frame.bs_code[0] == 7)
+    else if (frame->bs_code[0] == 7)
         count += 16;
 
     /* explicit sample rate */
@@ -1030,15 +1055,15 @@ static int count_frame_header(FlacEncodeContext *s)
 }
 
 
-static int encode_frame(FlacEncodeContext *s)
+static int encode_frame(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch;
     uint64_t count;
 
-    count = count_frame_header(s);
+    count = count_frame_header(s, frame);
 
     for (ch = 0; ch < s->channels; ch++)
-        count += encode_residual_ch(s, ch);
+        count += encode_residual_ch(s, frame, ch);
 
     count += (8 - (count & 7)) & 7; // byte alignment
     count += 16;                    // CRC-16
@@ -1050,15 +1075,15 @@ static int encode_frame(FlacEncodeContext *s)
 }
 
 
-static void remove_wasted_bits(FlacEncodeContext *s)
+static void remove_wasted_bits(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch, i;
 
     for (ch = 0; ch < s->channels; ch++) {
-        FlacSubframe *sub = &s->frame.subframes[ch];
+        FlacSubframe *sub = &frame->subframes[ch];
         int32_t v         = 0;
 
-        for (i = 0; i < s->frame.blocksize; i++) {
+        for (i = 0; i < frame->blocksize; i++) {
             v |= sub->samples[i];
             if (v & 1)
                 break;
@@ -1067,7 +1092,7 @@ static void remove_wasted_bits(FlacEncodeContext *s)
         if (v && !(v & 1)) {
             v = av_ctz(v);
 
-            for (i = 0; i < s->frame.blocksize; i++)
+            for (i = 0; i < frame->blocksize; i++)
                 sub->samples[i] >>= v;
 
             sub->wasted = v;
@@ -1126,13 +1151,11 @@ static int estimate_stereo_mode(const int32_t *left_ch, const int32_t *right_ch,
 /**
  * Perform stereo channel decorrelation.
  */
-static void channel_decorrelation(FlacEncodeContext *s)
+static void channel_decorrelation(FlacEncodeContext *s, FlacFrame *frame)
 {
-    FlacFrame *frame;
     int32_t *left, *right;
     int i, n;
 
-    frame = &s->frame;
     n     = frame->blocksize;
     left  = frame->subframes[0].samples;
     right = frame->subframes[1].samples;
@@ -1178,13 +1201,10 @@ static void write_utf8(PutBitContext *pb, uint32_t val)
 }
 
 
-static void write_frame_header(FlacEncodeContext *s)
+static void write_frame_header(FlacEncodeContext *s, FlacFrame *frame)
 {
-    FlacFrame *frame;
     int crc;
 
-    frame = &s->frame;
-
     put_bits(&s->pb, 16, 0xFFF8);
     put_bits(&s->pb, 4, frame->bs_code[0]);
     put_bits(&s->pb, 4, s->sr_code[0]);
@@ -1196,7 +1216,7 @@ static void write_frame_header(FlacEncodeContext *s)
 
     put_bits(&s->pb, 3, s->bps_code);
     put_bits(&s->pb, 1, 0);
-    write_utf8(&s->pb, s->frame_count);
+    write_utf8(&s->pb, frame->frame_number);
 
     if (frame->bs_code[0] == 6)
         put_bits(&s->pb, 8, frame->bs_code[1]);
@@ -1215,16 +1235,16 @@ static void write_frame_header(FlacEncodeContext *s)
 }
 
 
-static void write_subframes(FlacEncodeContext *s)
+static void write_subframes(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch;
 
     for (ch = 0; ch < s->channels; ch++) {
-        FlacSubframe *sub = &s->frame.subframes[ch];
+        FlacSubframe *sub = &frame->subframes[ch];
         int i, p, porder, psize;
         int32_t *part_end;
         int32_t *res       =  sub->residual;
-        int32_t *frame_end = &sub->residual[s->frame.blocksize];
+        int32_t *frame_end = &sub->residual[frame->blocksize];
 
         /* subframe header */
         put_bits(&s->pb, 1, 0);
@@ -1258,7 +1278,7 @@ static void write_subframes(FlacEncodeContext *s)
 
             /* partition order */
             porder  = sub->rc.porder;
-            psize   = s->frame.blocksize >> porder;
+            psize   = frame->blocksize >> porder;
             put_bits(&s->pb, 4, porder);
 
             /* residual */
@@ -1286,20 +1306,21 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, FlacFrame *frame, AVPacket *avpkt)
 {
     init_put_bits(&s->pb, avpkt->data, avpkt->size);
-    write_frame_header(s);
-    write_subframes(s);
+    write_frame_header(s, frame);
+    write_subframes(s, frame);
     write_frame_footer(s);
     return put_bits_count(&s->pb) >> 3;
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, int nb_samples,
+                          const void *samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1320,7 +1341,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1332,16 +1353,84 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+static int search_frame_thread(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacFrame *frame     = &s->frames[(s->frame_index + jobnr) % s->nb_frames];
+
+    channel_decorrelation(s, frame);
+
+    remove_wasted_bits(s, frame);
+
+    frame->size = encode_frame(s, frame);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame->size < 0 || frame->size > frame->max_framesize) {
+        frame->verbatim_only = 1;
+        frame->size = encode_frame(s, frame);
+    }
+
+    return 0;
+}
+
+
+static int queue_frame(FlacEncodeContext *s, const AVFrame *frame)
+{
+    AVCodecContext *avctx = s->avctx;
+    FlacFrame *f = &s->frames[(s->frame_index + s->nb_queued) % s->nb_frames];
+    int ret;
+
+    /* change max_framesize for small final frame */
+    if (frame->nb_samples < s->last_blocksize) {
+        s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
+                                                      s->channels,
+                                                      avctx->bits_per_raw_sample);
+    }
+    s->last_blocksize = frame->nb_samples;
+
+    init_frame(s, f, frame->nb_samples);
+
+    copy_samples(s, f, frame->data[0]);
+
+    f->frame_number  = s->frame_count++;
+    f->max_framesize = s->max_framesize;
+    f->pts           = frame->pts;
+    f->duration      = ff_samples_to_time_base(avctx, frame->nb_samples);
+
+    s->sample_count += frame->nb_samples;
+    if ((ret = update_md5_sum(s, frame->nb_samples, frame->data[0])) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+        return ret;
+    }
+
+    s->nb_queued++;
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
     FlacEncodeContext *s;
-    int frame_bytes, out_bytes, ret;
+    FlacFrame *f;
+    int out_bytes, ret;
 
     s = avctx->priv_data;
 
+    if (frame && (ret = queue_frame(s, frame)) < 0)
+        return ret;
+
+    /* search the next batch once the previous one has been written */
+    if (!s->nb_searched && (s->nb_queued == s->nb_frames || !frame && s->nb_queued)) {
+        avctx->execute2(avctx, search_frame_thread, NULL, NULL, s->nb_queued);
+        s->nb_searched = s->nb_queued;
+        s->nb_queued   = 0;
+    }
+
     /* when the last block is reached, update the header in extradata */
-    if (!frame) {
+    if (!frame && !s->nb_searched) {
         s->max_framesize = s->max_encoded_framesize;
         av_md5_final(s->md5ctx, s->md5sum);
         write_streaminfo(s, avctx->extradata);
@@ -1362,52 +1451,30 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         return 0;
     }
 
-    /* change max_framesize for small final frame */
-    if (frame->nb_samples < s->frame.blocksize) {
-        s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
-                                                      s->channels,
-                                                      avctx->bits_per_raw_sample);
-    }
-
-    init_frame(s, frame->nb_samples);
-
-    copy_samples(s, frame->data[0]);
-
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
+    if (!s->nb_searched)
+        return 0;
 
-    frame_bytes = encode_frame(s);
+    f = &s->frames[s->frame_index];
+    s->frame_index = (s->frame_index + 1) % s->nb_frames;
+    s->nb_searched--;
 
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
+    if (f->size < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
+        return f->size;
     }
 
-    if ((ret = ff_alloc_packet2(avctx, avpkt, frame_bytes, 0)) < 0)
+    if ((ret = ff_alloc_packet2(avctx, avpkt, f->size, 0)) < 0)
         return ret;
 
-    out_bytes = write_frame(s, avpkt);
+    out_bytes = write_frame(s, f, avpkt);
 
-    s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
-        return ret;
-    }
     if (out_bytes > s->max_encoded_framesize)
         s->max_encoded_framesize = out_bytes;
     if (out_bytes < s->min_framesize)
         s->min_framesize = out_bytes;
 
-    avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
+    avpkt->pts      = f->pts;
+    avpkt->duration = f->duration;
     avpkt->size     = out_bytes;
 
     s->next_pts = avpkt->pts + avpkt->duration;
@@ -1421,9 +1488,12 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
+        int i;
         av_freep(&s->md5ctx);
         av_freep(&s->md5_buffer);
-        ff_lpc_end(&s->lpc_ctx);
+        for (i = 0; s->frames && i < s->nb_frames; i++)
+            ff_lpc_end(&s->frames[i].lpc_ctx);
+        av_freep(&s->frames);
     }
     av_freep(&avctx->extradata);
     avctx->extradata_size = 0;
@@ -1475,7 +1545,8 @@ AVCodec ff_flac_encoder = {
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
     .close          = flac_encode_close,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
@@ -442,8 +442,8 @@ int ff_h264_alloc_tables(H264Context *h)
             h->mb2br_xy[mb_xy] = 8 * (FMO ? mb_xy : (mb_xy % (2 * h->mb_stride)));
         }
 
-    if (!h->dequant4_coeff[0])
-        ff_h264_init_dequant_tables(h);
+    if (!h->dequant4_coeff[0] && ff_h264_init_dequant_tables(h) < 0)
+        goto fail;
 
     return 0;
 
@@ -641,6 +641,15 @@ static int h264_init_context(AVCodecContext *avctx, H264Context *h)
     for (i = 0; i < h->nb_slice_ctx; i++)
         h->slice_ctx[i].h264 = h;
 
+#if HAVE_THREADS
+    if ((i = pthread_mutex_init(&h->deblock_mutex, NULL)))
+        return AVERROR(i);
+    if ((i = pthread_cond_init(&h->deblock_cond, NULL))) {
+        pthread_mutex_destroy(&h->deblock_mutex);
+        return AVERROR(i);
+    }
+#endif
+
     return 0;
 }
 
@@ -704,12 +713,14 @@ av_cold int ff_h264_decode_init(AVCodecContext *avctx)
 static int decode_init_thread_copy(AVCodecContext *avctx)
 {
     H264Context *h = avctx->priv_data;
+    int deferred_deblock = h->deferred_deblock;
     int ret;
 
     if (!avctx->internal->is_copy)
         return 0;
 
     memset(h, 0, sizeof(*h));
+    h->deferred_deblock = deferred_deblock;
 
     ret = h264_init_context(avctx, h);
     if (ret < 0)
@@ -1923,10 +1934,13 @@ av_cold void ff_h264_free_context(H264Context *h)
     h->nb_slice_ctx = 0;
 
     for (i = 0; i < MAX_SPS_COUNT; i++)
-        av_freep(h->sps_buffers + i);
+        av_buffer_unref(&h->sps_list[i]);
 
     for (i = 0; i < MAX_PPS_COUNT; i++)
-        av_freep(h->pps_buffers + i);
+        av_buffer_unref(&h->pps_list[i]);
+
+    av_buffer_unref(&h->sps_ref);
+    av_buffer_unref(&h->dequant_buf);
 }
 
 static av_cold int h264_decode_end(AVCodecContext *avctx)
@@ -1941,6 +1955,12 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
     ff_h264_unref_picture(h, &h->last_pic_for_ec);
     av_frame_free(&h->last_pic_for_ec.f);
 
+    av_freep(&h->deblock_row_pos);
+#if HAVE_THREADS
+    pthread_mutex_destroy(&h->deblock_mutex);
+    pthread_cond_destroy(&h->deblock_cond);
+#endif
+
     return 0;
 }
 
@@ -1950,6 +1970,7 @@ static const AVOption h264_options[] = {
     {"is_avc", "is avc", offsetof(H264Context, is_avc), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, 0},
     {"nal_length_size", "nal_length_size", offsetof(H264Context, nal_length_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 4, 0},
     { "enable_er", "Enable error resilience on damaged frames (unsafe)", OFFSET(enable_er), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 1, VD },
+    { "deferred_deblock", "Deblock single slices in a separate thread, a few MB rows behind decoding", OFFSET(deferred_deblock), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VD },
     { NULL },
 };
 
@@ -1989,6 +2010,7 @@ AVCodec ff_h264_decoder = {
     .capabilities          = /*AV_CODEC_CAP_DRAW_HORIZ_BAND |*/ AV_CODEC_CAP_DR1 |
                              AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS |
                              AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal         = FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS,
     .flush                 = flush_dpb,
     .init_thread_copy      = ONLY_IF_THREADS_ENABLED(decode_init_thread_copy),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(ff_h264_update_thread_context),
@@ -28,6 +28,7 @@
 #ifndef AVCODEC_H264_H
 #define AVCODEC_H264_H
 
+#include "libavutil/buffer.h"
 #include "libavutil/intreadwrite.h"
 #include "cabac.h"
 #include "error_resilience.h"
@@ -43,6 +44,14 @@
 #include "rectangle.h"
 #include "videodsp.h"
 
+#if HAVE_PTHREADS
+#   include <pthread.h>
+#elif HAVE_OS2THREADS
+#   include "compat/os2threads.h"
+#elif HAVE_W32THREADS
+#   include "compat/w32pthreads.h"
+#endif
+
 #define H264_MAX_PICTURE_COUNT 36
 #define H264_MAX_THREADS       32
 
@@ -231,6 +240,14 @@ typedef struct SPS {
     int new;                              ///< flag to keep track if the decoder context needs re-init due to changed SPS
 } SPS;
 
+/**
+ * Dequantization tables, derived from the current PPS.
+ */
+typedef struct H264DequantTables {
+    uint32_t dequant4_buffer[6][QP_MAX_NUM + 1][16];
+    uint32_t dequant8_buffer[6][QP_MAX_NUM + 1][64];
+} H264DequantTables;
+
 /**
  * Picture parameter set
  */
@@ -578,8 +595,7 @@ typedef struct H264Context {
 
     int au_pps_id; ///< pps_id of current access unit
 
-    uint32_t dequant4_buffer[6][QP_MAX_NUM + 1][16]; // FIXME should these be moved down?
-    uint32_t dequant8_buffer[6][QP_MAX_NUM + 1][64];
+    AVBufferRef *dequant_buf;   ///< H264DequantTables, shared between frame threads
     uint32_t(*dequant4_coeff[6])[16];
     uint32_t(*dequant8_coeff[6])[64];
 
@@ -635,8 +651,13 @@ typedef struct H264Context {
     int bit_depth_luma;         ///< luma bit depth from sps to detect changes
     int chroma_format_idc;      ///< chroma format from sps to detect changes
 
-    SPS *sps_buffers[MAX_SPS_COUNT];
-    PPS *pps_buffers[MAX_PPS_COUNT];
+    /**
+     * Parameter sets, refcounted and never modified once parsed, so that
+     * frame threads can share them instead of copying them.
+     */
+    AVBufferRef *sps_list[MAX_SPS_COUNT];
+    AVBufferRef *pps_list[MAX_PPS_COUNT];
+    AVBufferRef *sps_ref;       ///< buffer the current sps was taken from
 
     int dequant_coeff_pps;      ///< reinit tables when pps changes
 
@@ -701,6 +722,13 @@ typedef struct H264Context {
 
     int slice_context_count;
 
+    /**
+     * Several slice contexts are being decoded in parallel. Their rows
+     * complete out of order, so they are reported to frame threading once
+     * all of them are done.
+     */
+    int slices_in_parallel;
+
     /**
      *  1 if the single thread fallback warning has already been
      *  displayed, 0 otherwise.
@@ -827,6 +855,23 @@ typedef struct H264Context {
 
     int enable_er;
 
+    /**
+     * Deferred deblocking: with slice threading, single slices are
+     * loop filtered by separate jobs running a few MB rows behind decoding.
+     */
+    int deferred_deblock;
+    int deblock_deferred;           ///< the current slice is filtered by the deblocking jobs
+    int deblock_mb_pos;             ///< MBs before this one are decoded and ready to be filtered
+    int deblock_end;                ///< decoding of the slice has finished
+    int deblock_first_row;          ///< first MB row of the slice
+    int deblock_next_row;           ///< next MB row to be taken by a deblocking job
+    int *deblock_row_pos;           ///< MBs filtered in each row, mb_width + 1 once the row is finished
+    unsigned int deblock_row_pos_size;
+#if HAVE_THREADS
+    pthread_mutex_t deblock_mutex;
+    pthread_cond_t  deblock_cond;
+#endif
+
     AVBufferPool *qscale_table_pool;
     AVBufferPool *mb_type_pool;
     AVBufferPool *motion_val_pool;
@@ -943,7 +988,7 @@ int ff_h264_decode_mb_cabac(const H264Context *h, H264SliceContext *sl);
 
 void ff_h264_init_cabac_states(const H264Context *h, H264SliceContext *sl);
 
-void ff_h264_init_dequant_tables(H264Context *h);
+int ff_h264_init_dequant_tables(H264Context *h);
 
 void ff_h264_direct_dist_scale_factor(const H264Context *const h, H264SliceContext *sl);
 void ff_h264_direct_ref_list_init(const H264Context *const h, H264SliceContext *sl);
@@ -313,18 +313,18 @@ static inline int parse_nal_units(AVCodecParserContext *s,
                        "pps_id %u out of range\n", pps_id);
                 return -1;
             }
-            if (!h->pps_buffers[pps_id]) {
+            if (!h->pps_list[pps_id]) {
                 av_log(h->avctx, AV_LOG_ERROR,
                        "non-existing PPS %u referenced\n", pps_id);
                 return -1;
             }
-            h->pps = *h->pps_buffers[pps_id];
-            if (!h->sps_buffers[h->pps.sps_id]) {
+            h->pps = *(const PPS*)h->pps_list[pps_id]->data;
+            if (!h->sps_list[h->pps.sps_id]) {
                 av_log(h->avctx, AV_LOG_ERROR,
                        "non-existing SPS %u referenced\n", h->pps.sps_id);
                 return -1;
             }
-            h->sps       = *h->sps_buffers[h->pps.sps_id];
+            h->sps       = *(const SPS*)h->sps_list[h->pps.sps_id]->data;
             h->frame_num = get_bits(&sl->gb, h->sps.log2_max_frame_num);
 
             if(h->sps.ref_frame_count <= 1 && h->pps.ref_count[0] <= 1 && s->pict_type == AV_PICTURE_TYPE_I)
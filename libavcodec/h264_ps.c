@@ -267,10 +267,13 @@ static void decode_scaling_list(H264Context *h, uint8_t *factors, int size,
         }
 }
 
-static void decode_scaling_matrices(H264Context *h, SPS *sps,
-                                    PPS *pps, int is_sps,
-                                    uint8_t(*scaling_matrix4)[16],
-                                    uint8_t(*scaling_matrix8)[64])
+/**
+ * @return 1 if scaling matrices were coded, 0 otherwise
+ */
+static int decode_scaling_matrices(H264Context *h, const SPS *sps,
+                                   PPS *pps, int is_sps,
+                                   uint8_t(*scaling_matrix4)[16],
+                                   uint8_t(*scaling_matrix8)[64])
 {
     int fallback_sps = !is_sps && sps->scaling_matrix_present;
     const uint8_t *fallback[4] = {
@@ -279,25 +282,25 @@ static void decode_scaling_matrices(H264Context *h, SPS *sps,
         fallback_sps ? sps->scaling_matrix8[0] : default_scaling8[0],
         fallback_sps ? sps->scaling_matrix8[3] : default_scaling8[1]
     };
-    if (get_bits1(&h->gb)) {
-        sps->scaling_matrix_present |= is_sps;
-        decode_scaling_list(h, scaling_matrix4[0], 16, default_scaling4[0], fallback[0]);        // Intra, Y
-        decode_scaling_list(h, scaling_matrix4[1], 16, default_scaling4[0], scaling_matrix4[0]); // Intra, Cr
-        decode_scaling_list(h, scaling_matrix4[2], 16, default_scaling4[0], scaling_matrix4[1]); // Intra, Cb
-        decode_scaling_list(h, scaling_matrix4[3], 16, default_scaling4[1], fallback[1]);        // Inter, Y
-        decode_scaling_list(h, scaling_matrix4[4], 16, default_scaling4[1], scaling_matrix4[3]); // Inter, Cr
-        decode_scaling_list(h, scaling_matrix4[5], 16, default_scaling4[1], scaling_matrix4[4]); // Inter, Cb
-        if (is_sps || pps->transform_8x8_mode) {
-            decode_scaling_list(h, scaling_matrix8[0], 64, default_scaling8[0], fallback[2]); // Intra, Y
-            decode_scaling_list(h, scaling_matrix8[3], 64, default_scaling8[1], fallback[3]); // Inter, Y
-            if (sps->chroma_format_idc == 3) {
-                decode_scaling_list(h, scaling_matrix8[1], 64, default_scaling8[0], scaling_matrix8[0]); // Intra, Cr
-                decode_scaling_list(h, scaling_matrix8[4], 64, default_scaling8[1], scaling_matrix8[3]); // Inter, Cr
-                decode_scaling_list(h, scaling_matrix8[2], 64, default_scaling8[0], scaling_matrix8[1]); // Intra, Cb
-                decode_scaling_list(h, scaling_matrix8[5], 64, default_scaling8[1], scaling_matrix8[4]); // Inter, Cb
-            }
+    if (!get_bits1(&h->gb))
+        return 0;
+    decode_scaling_list(h, scaling_matrix4[0], 16, default_scaling4[0], fallback[0]);        // Intra, Y
+    decode_scaling_list(h, scaling_matrix4[1], 16, default_scaling4[0], scaling_matrix4[0]); // Intra, Cr
+    decode_scaling_list(h, scaling_matrix4[2], 16, default_scaling4[0], scaling_matrix4[1]); // Intra, Cb
+    decode_scaling_list(h, scaling_matrix4[3], 16, default_scaling4[1], fallback[1]);        // Inter, Y
+    decode_scaling_list(h, scaling_matrix4[4], 16, default_scaling4[1], scaling_matrix4[3]); // Inter, Cr
+    decode_scaling_list(h, scaling_matrix4[5], 16, default_scaling4[1], scaling_matrix4[4]); // Inter, Cb
+    if (is_sps || pps->transform_8x8_mode) {
+        decode_scaling_list(h, scaling_matrix8[0], 64, default_scaling8[0], fallback[2]); // Intra, Y
+        decode_scaling_list(h, scaling_matrix8[3], 64, default_scaling8[1], fallback[3]); // Inter, Y
+        if (sps->chroma_format_idc == 3) {
+            decode_scaling_list(h, scaling_matrix8[1], 64, default_scaling8[0], scaling_matrix8[0]); // Intra, Cr
+            decode_scaling_list(h, scaling_matrix8[4], 64, default_scaling8[1], scaling_matrix8[3]); // Inter, Cr
+            decode_scaling_list(h, scaling_matrix8[2], 64, default_scaling8[0], scaling_matrix8[1]); // Intra, Cb
+            decode_scaling_list(h, scaling_matrix8[5], 64, default_scaling8[1], scaling_matrix8[4]); // Inter, Cb
         }
     }
+    return 1;
 }
 
 int ff_h264_decode_seq_parameter_set(H264Context *h, int ignore_truncation)
@@ -305,6 +308,7 @@ int ff_h264_decode_seq_parameter_set(H264Context *h, int ignore_truncation)
     int profile_idc, level_idc, constraint_set_flags = 0;
     unsigned int sps_id;
     int i, log2_max_frame_num_minus4;
+    AVBufferRef *sps_buf;
     SPS *sps;
 
     profile_idc           = get_bits(&h->gb, 8);
@@ -322,9 +326,10 @@ int ff_h264_decode_seq_parameter_set(H264Context *h, int ignore_truncation)
         av_log(h->avctx, AV_LOG_ERROR, "sps_id %u out of range\n", sps_id);
         return AVERROR_INVALIDDATA;
     }
-    sps = av_mallocz(sizeof(SPS));
-    if (!sps)
+    sps_buf = av_buffer_allocz(sizeof(SPS));
+    if (!sps_buf)
         return AVERROR(ENOMEM);
+    sps = (SPS*)sps_buf->data;
 
     sps->sps_id               = sps_id;
     sps->time_offset_length   = 24;
@@ -375,8 +380,9 @@ int ff_h264_decode_seq_parameter_set(H264Context *h, int ignore_truncation)
             goto fail;
         }
         sps->transform_bypass = get_bits1(&h->gb);
-        decode_scaling_matrices(h, sps, NULL, 1,
-                                sps->scaling_matrix4, sps->scaling_matrix8);
+        sps->scaling_matrix_present =
+            decode_scaling_matrices(h, sps, NULL, 1,
+                                    sps->scaling_matrix4, sps->scaling_matrix8);
     } else {
         sps->chroma_format_idc = 1;
         sps->bit_depth_luma    = 8;
@@ -552,13 +558,13 @@ int ff_h264_decode_seq_parameter_set(H264Context *h, int ignore_truncation)
     }
     sps->new = 1;
 
-    av_free(h->sps_buffers[sps_id]);
-    h->sps_buffers[sps_id] = sps;
+    av_buffer_unref(&h->sps_list[sps_id]);
+    h->sps_list[sps_id] = sps_buf;
 
     return 0;
 
 fail:
-    av_free(sps);
+    av_buffer_unref(&sps_buf);
     return AVERROR_INVALIDDATA;
 }
 
@@ -573,7 +579,7 @@ static void build_qp_table(PPS *pps, int t, int index, const int depth)
 
 static int more_rbsp_data_in_pps(H264Context *h, PPS *pps)
 {
-    const SPS *sps = h->sps_buffers[pps->sps_id];
+    const SPS *sps = (const SPS*)h->sps_list[pps->sps_id]->data;
     int profile_idc = sps->profile_idc;
 
     if ((profile_idc == 66 || profile_idc == 77 ||
@@ -590,6 +596,7 @@ int ff_h264_decode_picture_parameter_set(H264Context *h, int bit_length)
 {
     const SPS *sps;
     unsigned int pps_id = get_ue_golomb(&h->gb);
+    AVBufferRef *pps_buf;
     PPS *pps;
     int qp_bd_offset;
     int bits_left;
@@ -600,17 +607,18 @@ int ff_h264_decode_picture_parameter_set(H264Context *h, int bit_length)
         return AVERROR_INVALIDDATA;
     }
 
-    pps = av_mallocz(sizeof(PPS));
-    if (!pps)
+    pps_buf = av_buffer_allocz(sizeof(PPS));
+    if (!pps_buf)
         return AVERROR(ENOMEM);
+    pps = (PPS*)pps_buf->data;
     pps->sps_id = get_ue_golomb_31(&h->gb);
     if ((unsigned)pps->sps_id >= MAX_SPS_COUNT ||
-        !h->sps_buffers[pps->sps_id]) {
+        !h->sps_list[pps->sps_id]) {
         av_log(h->avctx, AV_LOG_ERROR, "sps_id %u out of range\n", pps->sps_id);
         ret = AVERROR_INVALIDDATA;
         goto fail;
     }
-    sps = h->sps_buffers[pps->sps_id];
+    sps = (const SPS*)h->sps_list[pps->sps_id]->data;
     if (sps->bit_depth_luma > 14) {
         av_log(h->avctx, AV_LOG_ERROR,
                "Invalid luma bit depth=%d\n",
@@ -685,15 +693,15 @@ int ff_h264_decode_picture_parameter_set(H264Context *h, int bit_length)
     pps->transform_8x8_mode = 0;
     // contents of sps/pps can change even if id doesn't, so reinit
     h->dequant_coeff_pps = -1;
-    memcpy(pps->scaling_matrix4, h->sps_buffers[pps->sps_id]->scaling_matrix4,
+    memcpy(pps->scaling_matrix4, sps->scaling_matrix4,
            sizeof(pps->scaling_matrix4));
-    memcpy(pps->scaling_matrix8, h->sps_buffers[pps->sps_id]->scaling_matrix8,
+    memcpy(pps->scaling_matrix8, sps->scaling_matrix8,
            sizeof(pps->scaling_matrix8));
 
     bits_left = bit_length - get_bits_count(&h->gb);
     if (bits_left > 0 && more_rbsp_data_in_pps(h, pps)) {
         pps->transform_8x8_mode = get_bits1(&h->gb);
-        decode_scaling_matrices(h, h->sps_buffers[pps->sps_id], pps, 0,
+        decode_scaling_matrices(h, sps, pps, 0,
                                 pps->scaling_matrix4, pps->scaling_matrix8);
         // second_chroma_qp_index_offset
         pps->chroma_qp_index_offset[1] = get_se_golomb(&h->gb);
@@ -723,11 +731,11 @@ int ff_h264_decode_picture_parameter_set(H264Context *h, int bit_length)
                pps->transform_8x8_mode ? "8x8DCT" : "");
     }
 
-    av_free(h->pps_buffers[pps_id]);
-    h->pps_buffers[pps_id] = pps;
+    av_buffer_unref(&h->pps_list[pps_id]);
+    h->pps_list[pps_id] = pps_buf;
     return 0;
 
 fail:
-    av_free(pps);
+    av_buffer_unref(&pps_buf);
     return ret;
 }
@@ -802,8 +802,8 @@ int ff_h264_execute_ref_pic_marking(H264Context *h, MMCO *mmco, int mmco_count)
     print_long_term(h);
 
     pps_count = 0;
-    for (i = 0; i < FF_ARRAY_ELEMS(h->pps_buffers); i++) {
-        pps_count += !!h->pps_buffers[i];
+    for (i = 0; i < FF_ARRAY_ELEMS(h->pps_list); i++) {
+        pps_count += !!h->pps_list[i];
         pps_ref_count[0] = FFMAX(pps_ref_count[0], h->pps.ref_count[0]);
         pps_ref_count[1] = FFMAX(pps_ref_count[1], h->pps.ref_count[1]);
     }
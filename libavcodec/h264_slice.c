@@ -311,17 +311,17 @@ static int find_unused_picture(H264Context *h)
 }
 
 
-static void init_dequant8_coeff_table(H264Context *h)
+static void init_dequant8_coeff_table(H264Context *h, H264DequantTables *t)
 {
     int i, j, q, x;
     const int max_qp = 51 + 6 * (h->sps.bit_depth_luma - 8);
 
     for (i = 0; i < 6; i++) {
-        h->dequant8_coeff[i] = h->dequant8_buffer[i];
+        h->dequant8_coeff[i] = t->dequant8_buffer[i];
         for (j = 0; j < i; j++)
             if (!memcmp(h->pps.scaling_matrix8[j], h->pps.scaling_matrix8[i],
                         64 * sizeof(uint8_t))) {
-                h->dequant8_coeff[i] = h->dequant8_buffer[j];
+                h->dequant8_coeff[i] = t->dequant8_buffer[j];
                 break;
             }
         if (j < i)
@@ -338,16 +338,16 @@ static void init_dequant8_coeff_table(H264Context *h)
     }
 }
 
-static void init_dequant4_coeff_table(H264Context *h)
+static void init_dequant4_coeff_table(H264Context *h, H264DequantTables *t)
 {
     int i, j, q, x;
     const int max_qp = 51 + 6 * (h->sps.bit_depth_luma - 8);
     for (i = 0; i < 6; i++) {
-        h->dequant4_coeff[i] = h->dequant4_buffer[i];
+        h->dequant4_coeff[i] = t->dequant4_buffer[i];
         for (j = 0; j < i; j++)
             if (!memcmp(h->pps.scaling_matrix4[j], h->pps.scaling_matrix4[i],
                         16 * sizeof(uint8_t))) {
-                h->dequant4_coeff[i] = h->dequant4_buffer[j];
+                h->dequant4_coeff[i] = t->dequant4_buffer[j];
                 break;
             }
         if (j < i)
@@ -364,14 +364,29 @@ static void init_dequant4_coeff_table(H264Context *h)
     }
 }
 
-void ff_h264_init_dequant_tables(H264Context *h)
+int ff_h264_init_dequant_tables(H264Context *h)
 {
+    H264DequantTables *t;
     int i, x;
-    init_dequant4_coeff_table(h);
+
+    /* the tables may be shared with other frame threads, only write to
+     * them if nobody else is using them */
+    if (!h->dequant_buf || !av_buffer_is_writable(h->dequant_buf)) {
+        av_buffer_unref(&h->dequant_buf);
+        h->dequant_buf = av_buffer_alloc(sizeof(H264DequantTables));
+        if (!h->dequant_buf) {
+            memset(h->dequant4_coeff, 0, sizeof(h->dequant4_coeff));
+            memset(h->dequant8_coeff, 0, sizeof(h->dequant8_coeff));
+            return AVERROR(ENOMEM);
+        }
+    }
+    t = (H264DequantTables*)h->dequant_buf->data;
+
+    init_dequant4_coeff_table(h, t);
     memset(h->dequant8_coeff, 0, sizeof(h->dequant8_coeff));
 
     if (h->pps.transform_8x8_mode)
-        init_dequant8_coeff_table(h);
+        init_dequant8_coeff_table(h, t);
     if (h->sps.transform_bypass) {
         for (i = 0; i < 6; i++)
             for (x = 0; x < 16; x++)
@@ -381,6 +396,8 @@ void ff_h264_init_dequant_tables(H264Context *h)
                 for (x = 0; x < 64; x++)
                     h->dequant8_coeff[i][0][x] = 1 << 6;
     }
+
+    return 0;
 }
 
 #define IN_RANGE(a, b, size) (((void*)(a) >= (void*)(b)) && ((void*)(a) < (void*)((b) + (size))))
@@ -404,26 +421,35 @@ static void copy_picture_range(H264Picture **to, H264Picture **from, int count,
     }
 }
 
-static int copy_parameter_set(void **to, void **from, int count, int size)
+/**
+ * Make dst reference the same buffer as src, unless it already does.
+ */
+static int replace_buffer_ref(AVBufferRef **dst, AVBufferRef *src)
 {
-    int i;
-
-    for (i = 0; i < count; i++) {
-        if (to[i] && !from[i]) {
-            av_freep(&to[i]);
-        } else if (from[i] && !to[i]) {
-            to[i] = av_malloc(size);
-            if (!to[i])
-                return AVERROR(ENOMEM);
-        }
+    if (*dst && src && (*dst)->buffer == src->buffer)
+        return 0;
 
-        if (from[i])
-            memcpy(to[i], from[i], size);
+    av_buffer_unref(dst);
+    if (src) {
+        *dst = av_buffer_ref(src);
+        if (!*dst)
+            return AVERROR(ENOMEM);
     }
 
     return 0;
 }
 
+static int copy_parameter_set(AVBufferRef **to, AVBufferRef **from, int count)
+{
+    int i, ret;
+
+    for (i = 0; i < count; i++)
+        if ((ret = replace_buffer_ref(&to[i], from[i])) < 0)
+            return ret;
+
+    return 0;
+}
+
 #define copy_fields(to, from, start_field, end_field)                   \
     memcpy(&(to)->start_field, &(from)->start_field,                        \
            (char *)&(to)->end_field - (char *)&(to)->start_field)
@@ -457,15 +483,11 @@ int ff_h264_update_thread_context(AVCodecContext *dst,
     memcpy(h->block_offset, h1->block_offset, sizeof(h->block_offset));
 
     // SPS/PPS
-    if ((ret = copy_parameter_set((void **)h->sps_buffers,
-                                  (void **)h1->sps_buffers,
-                                  MAX_SPS_COUNT, sizeof(SPS))) < 0)
+    if ((ret = copy_parameter_set(h->sps_list, h1->sps_list, MAX_SPS_COUNT)) < 0 ||
+        (ret = copy_parameter_set(h->pps_list, h1->pps_list, MAX_PPS_COUNT)) < 0 ||
+        (ret = replace_buffer_ref(&h->sps_ref, h1->sps_ref)) < 0)
         return ret;
     h->sps = h1->sps;
-    if ((ret = copy_parameter_set((void **)h->pps_buffers,
-                                  (void **)h1->pps_buffers,
-                                  MAX_PPS_COUNT, sizeof(PPS))) < 0)
-        return ret;
     h->pps = h1->pps;
 
     if (need_reinit || !inited) {
@@ -526,17 +548,10 @@ int ff_h264_update_thread_context(AVCodecContext *dst,
     h->x264_build      = h1->x264_build;
 
     // Dequantization matrices
-    // FIXME these are big - can they be only copied when PPS changes?
-    copy_fields(h, h1, dequant4_buffer, dequant4_coeff);
-
-    for (i = 0; i < 6; i++)
-        h->dequant4_coeff[i] = h->dequant4_buffer[0] +
-                               (h1->dequant4_coeff[i] - h1->dequant4_buffer[0]);
-
-    for (i = 0; i < 6; i++)
-        h->dequant8_coeff[i] = h->dequant8_buffer[0] +
-                               (h1->dequant8_coeff[i] - h1->dequant8_buffer[0]);
-
+    if ((ret = replace_buffer_ref(&h->dequant_buf, h1->dequant_buf)) < 0)
+        return ret;
+    memcpy(h->dequant4_coeff, h1->dequant4_coeff, sizeof(h->dequant4_coeff));
+    memcpy(h->dequant8_coeff, h1->dequant8_coeff, sizeof(h->dequant8_coeff));
     h->dequant_coeff_pps = h1->dequant_coeff_pps;
 
     // POC timing
@@ -1161,7 +1176,7 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
     int first_slice = sl == h->slice_ctx && !h->current_slice;
     int frame_num, droppable, picture_structure;
     int mb_aff_frame, last_mb_aff_frame;
-    PPS *pps;
+    const PPS *pps;
 
     if (first_slice)
         av_assert0(!h->setup_finished);
@@ -1248,7 +1263,7 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
         av_log(h->avctx, AV_LOG_ERROR, "pps_id %u out of range\n", pps_id);
         return AVERROR_INVALIDDATA;
     }
-    if (!h->pps_buffers[pps_id]) {
+    if (!h->pps_list[pps_id]) {
         av_log(h->avctx, AV_LOG_ERROR,
                "non-existing PPS %u referenced\n",
                pps_id);
@@ -1261,9 +1276,9 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
         return AVERROR_INVALIDDATA;
     }
 
-    pps = h->pps_buffers[pps_id];
+    pps = (const PPS*)h->pps_list[pps_id]->data;
 
-    if (!h->sps_buffers[pps->sps_id]) {
+    if (!h->sps_list[pps->sps_id]) {
         av_log(h->avctx, AV_LOG_ERROR,
                "non-existing SPS %u referenced\n",
                h->pps.sps_id);
@@ -1271,7 +1286,7 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
     }
 
     if (first_slice) {
-        h->pps = *h->pps_buffers[pps_id];
+        h->pps = *pps;
     } else if (h->setup_finished && h->dequant_coeff_pps != pps_id) {
         av_log(h->avctx, AV_LOG_ERROR, "PPS changed between slices\n");
         return AVERROR_INVALIDDATA;
@@ -1279,7 +1294,7 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
 
     if (pps->sps_id != h->sps.sps_id ||
         pps->sps_id != h->current_sps_id ||
-        h->sps_buffers[pps->sps_id]->new) {
+        !h->sps_ref || h->sps_ref->buffer != h->sps_list[pps->sps_id]->buffer) {
 
         if (!first_slice) {
             av_log(h->avctx, AV_LOG_ERROR,
@@ -1287,7 +1302,7 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
             return AVERROR_INVALIDDATA;
         }
 
-        h->sps = *h->sps_buffers[h->pps.sps_id];
+        h->sps = *(const SPS*)h->sps_list[h->pps.sps_id]->data;
 
         if (h->mb_width  != h->sps.mb_width ||
             h->mb_height != h->sps.mb_height * (2 - h->sps.frame_mbs_only_flag) ||
@@ -1414,7 +1429,10 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
 
     if (first_slice && h->dequant_coeff_pps != pps_id) {
         h->dequant_coeff_pps = pps_id;
-        ff_h264_init_dequant_tables(h);
+        if ((ret = ff_h264_init_dequant_tables(h)) < 0) {
+            h->dequant_coeff_pps = -1;
+            return ret;
+        }
     }
 
     frame_num = get_bits(&sl->gb, h->sps.log2_max_frame_num);
@@ -1922,8 +1940,9 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl)
     }
 
     h->au_pps_id = pps_id;
-    h->sps.new =
-    h->sps_buffers[h->pps.sps_id]->new = 0;
+    h->sps.new = 0;
+    if ((ret = replace_buffer_ref(&h->sps_ref, h->sps_list[h->pps.sps_id])) < 0)
+        return ret;
     h->current_sps_id = h->pps.sps_id;
 
     if (h->avctx->debug & FF_DEBUG_PICT_INFO) {
@@ -1979,11 +1998,14 @@ static av_always_inline void fill_filter_caches_inter(const H264Context *h,
     int b_stride = h->b_stride;
     int16_t(*mv_dst)[2] = &sl->mv_cache[list][scan8[0]];
     int8_t *ref_cache   = &sl->ref_cache[list][scan8[0]];
+    /* the deblocking jobs use the tables of the decoding context, which is
+     * where the sequential decoder would filter the slice */
+    const H264SliceContext *ref_sl = h->deblock_deferred ? &h->slice_ctx[0] : sl;
     if (IS_INTER(mb_type) || IS_DIRECT(mb_type)) {
         if (USES_LIST(top_type, list)) {
             const int b_xy  = h->mb2b_xy[top_xy] + 3 * b_stride;
             const int b8_xy = 4 * top_xy + 2;
-            int (*ref2frm)[64] = (void*)(sl->ref2frm[h->slice_table[top_xy] & (MAX_SLICES - 1)][0] + (MB_MBAFF(sl) ? 20 : 2));
+            int (*ref2frm)[64] = (void*)(ref_sl->ref2frm[h->slice_table[top_xy] & (MAX_SLICES - 1)][0] + (MB_MBAFF(sl) ? 20 : 2));
             AV_COPY128(mv_dst - 1 * 8, h->cur_pic.motion_val[list][b_xy + 0]);
             ref_cache[0 - 1 * 8] =
             ref_cache[1 - 1 * 8] = ref2frm[list][h->cur_pic.ref_index[list][b8_xy + 0]];
@@ -1998,7 +2020,7 @@ static av_always_inline void fill_filter_caches_inter(const H264Context *h,
             if (USES_LIST(left_type[LTOP], list)) {
                 const int b_xy  = h->mb2b_xy[left_xy[LTOP]] + 3;
                 const int b8_xy = 4 * left_xy[LTOP] + 1;
-                int (*ref2frm)[64] =(void*)( sl->ref2frm[h->slice_table[left_xy[LTOP]] & (MAX_SLICES - 1)][0] + (MB_MBAFF(sl) ? 20 : 2));
+                int (*ref2frm)[64] =(void*)( ref_sl->ref2frm[h->slice_table[left_xy[LTOP]] & (MAX_SLICES - 1)][0] + (MB_MBAFF(sl) ? 20 : 2));
                 AV_COPY32(mv_dst - 1 +  0, h->cur_pic.motion_val[list][b_xy + b_stride * 0]);
                 AV_COPY32(mv_dst - 1 +  8, h->cur_pic.motion_val[list][b_xy + b_stride * 1]);
                 AV_COPY32(mv_dst - 1 + 16, h->cur_pic.motion_val[list][b_xy + b_stride * 2]);
@@ -2031,7 +2053,7 @@ static av_always_inline void fill_filter_caches_inter(const H264Context *h,
 
     {
         int8_t *ref = &h->cur_pic.ref_index[list][4 * mb_xy];
-        int (*ref2frm)[64] = (void*)(sl->ref2frm[sl->slice_num & (MAX_SLICES - 1)][0] + (MB_MBAFF(sl) ? 20 : 2));
+        int (*ref2frm)[64] = (void*)(ref_sl->ref2frm[sl->slice_num & (MAX_SLICES - 1)][0] + (MB_MBAFF(sl) ? 20 : 2));
         uint32_t ref01 = (pack16to32(ref2frm[list][ref[0]], ref2frm[list][ref[1]]) & 0x00FF00FF) * 0x0101;
         uint32_t ref23 = (pack16to32(ref2frm[list][ref[2]], ref2frm[list][ref[3]]) & 0x00FF00FF) * 0x0101;
         AV_WN32A(&ref_cache[0 * 8], ref01);
@@ -2244,8 +2266,10 @@ static void loop_filter(const H264Context *h, H264SliceContext *sl, int start_x,
                     linesize   = sl->mb_linesize   = sl->linesize;
                     uvlinesize = sl->mb_uvlinesize = sl->uvlinesize;
                 }
-                backup_mb_border(h, sl, dest_y, dest_cb, dest_cr, linesize,
-                                 uvlinesize, 0);
+                // with deferred deblocking the decoder saved the borders already
+                if (!h->deblock_deferred)
+                    backup_mb_border(h, sl, dest_y, dest_cb, dest_cr, linesize,
+                                     uvlinesize, 0);
                 if (fill_filter_caches(h, sl, mb_type))
                     continue;
                 sl->chroma_qp[0] = get_chroma_qp(h, 0, h->cur_pic.qscale_table[mb_xy]);
@@ -2304,7 +2328,8 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
 
     ff_h264_draw_horiz_band(h, sl, top, height);
 
-    if (h->droppable || sl->h264->slice_ctx[0].er.error_occurred)
+    if (h->droppable || h->slices_in_parallel ||
+        sl->h264->slice_ctx[0].er.error_occurred)
         return;
 
     ff_thread_report_progress(&h->cur_pic_ptr->tf, top + height - 1,
@@ -2325,6 +2350,48 @@ static void er_add_slice(H264SliceContext *sl,
     }
 }
 
+/**
+ * Loop filter the MBs start_x..end_x-1 of the current row. When deblocking
+ * is deferred, only save the unfiltered borders needed for intra prediction
+ * of the next row and hand the MBs over to the deblocking job.
+ */
+static void filter_mbs(AVCodecContext *avctx, H264SliceContext *sl,
+                       int start_x, int end_x)
+{
+    H264Context *h        = avctx->priv_data;
+    const int pixel_shift = h->pixel_shift;
+    const int block_h     = 16 >> h->chroma_y_shift;
+    int mb_x;
+
+    if (!h->deblock_deferred) {
+        loop_filter(h, sl, start_x, end_x);
+        return;
+    }
+
+    for (mb_x = start_x; mb_x < end_x; mb_x++) {
+        uint8_t *dest_y  = h->cur_pic.f->data[0] +
+                           ((mb_x << pixel_shift) + sl->mb_y * sl->linesize) * 16;
+        uint8_t *dest_cb = h->cur_pic.f->data[1] +
+                           (mb_x << pixel_shift) * (8 << CHROMA444(h)) +
+                           sl->mb_y * sl->uvlinesize * block_h;
+        uint8_t *dest_cr = h->cur_pic.f->data[2] +
+                           (mb_x << pixel_shift) * (8 << CHROMA444(h)) +
+                           sl->mb_y * sl->uvlinesize * block_h;
+
+        sl->mb_x = mb_x;
+        backup_mb_border(h, sl, dest_y, dest_cb, dest_cr,
+                         sl->linesize, sl->uvlinesize, 0);
+    }
+    sl->mb_x = end_x;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&h->deblock_mutex);
+    h->deblock_mb_pos = sl->mb_y * h->mb_width + end_x;
+    pthread_cond_broadcast(&h->deblock_cond);
+    pthread_mutex_unlock(&h->deblock_mutex);
+#endif
+}
+
 static int decode_slice(struct AVCodecContext *avctx, void *arg)
 {
     H264SliceContext *sl = arg;
@@ -2402,7 +2469,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x - 1,
                              sl->mb_y, ER_MB_END);
                 if (sl->mb_x >= lf_x_start)
-                    loop_filter(h, sl, lf_x_start, sl->mb_x + 1);
+                    filter_mbs(avctx, sl, lf_x_start, sl->mb_x + 1);
                 return 0;
             }
             if (sl->cabac.bytestream > sl->cabac.bytestream_end + 2 )
@@ -2418,9 +2485,10 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
             }
 
             if (++sl->mb_x >= h->mb_width) {
-                loop_filter(h, sl, lf_x_start, sl->mb_x);
+                filter_mbs(avctx, sl, lf_x_start, sl->mb_x);
                 sl->mb_x = lf_x_start = 0;
-                decode_finish_row(h, sl);
+                if (!h->deblock_deferred)
+                    decode_finish_row(h, sl);
                 ++sl->mb_y;
                 if (FIELD_OR_MBAFF_PICTURE(h)) {
                     ++sl->mb_y;
@@ -2435,7 +2503,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x - 1,
                              sl->mb_y, ER_MB_END);
                 if (sl->mb_x > lf_x_start)
-                    loop_filter(h, sl, lf_x_start, sl->mb_x);
+                    filter_mbs(avctx, sl, lf_x_start, sl->mb_x);
                 return 0;
             }
         }
@@ -2475,9 +2543,10 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
             }
 
             if (++sl->mb_x >= h->mb_width) {
-                loop_filter(h, sl, lf_x_start, sl->mb_x);
+                filter_mbs(avctx, sl, lf_x_start, sl->mb_x);
                 sl->mb_x = lf_x_start = 0;
-                decode_finish_row(h, sl);
+                if (!h->deblock_deferred)
+                    decode_finish_row(h, sl);
                 ++sl->mb_y;
                 if (FIELD_OR_MBAFF_PICTURE(h)) {
                     ++sl->mb_y;
@@ -2511,7 +2580,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                     er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y,
                                  sl->mb_x - 1, sl->mb_y, ER_MB_END);
                     if (sl->mb_x > lf_x_start)
-                        loop_filter(h, sl, lf_x_start, sl->mb_x);
+                        filter_mbs(avctx, sl, lf_x_start, sl->mb_x);
 
                     return 0;
                 } else {
@@ -2525,6 +2594,150 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
     }
 }
 
+#if HAVE_THREADS
+/**
+ * Wait until the MB row above mb_y has been filtered up to mb_pos and
+ * return its progress. Called with deblock_mutex locked.
+ */
+static int wait_row_above(H264Context *h, int mb_y, int mb_pos)
+{
+    if (mb_y <= h->deblock_first_row)
+        return h->mb_width + 1;
+    while (h->deblock_row_pos[mb_y - 1] < mb_pos)
+        pthread_cond_wait(&h->deblock_cond, &h->deblock_mutex);
+    return h->deblock_row_pos[mb_y - 1];
+}
+
+/**
+ * Loop filter rows of the slice decoded by decode_slice() running
+ * concurrently. A row is filtered once the decoder has finished the row
+ * below it, since decoding that row still reads the unfiltered pixels.
+ * The jobs take the rows in turn and follow each other as a wavefront:
+ * filtering an MB modifies its left and top neighbours, so an MB waits
+ * for the MB above and to the right to be filtered.
+ *
+ * The jobs only wait for the decoding job and for jobs that took the rows
+ * above, which are running already.
+ */
+static void deblock_slice_rows(H264Context *h, H264SliceContext *sl)
+{
+    const int mb_width = h->mb_width;
+
+    for (;;) {
+        int mb_x, mb_y, start_x, end_x, above;
+
+        pthread_mutex_lock(&h->deblock_mutex);
+        while (!h->deblock_end &&
+               h->deblock_mb_pos < (h->deblock_next_row + 2) * mb_width)
+            pthread_cond_wait(&h->deblock_cond, &h->deblock_mutex);
+        mb_y    = h->deblock_next_row;
+        start_x = mb_y == h->deblock_first_row ? h->deblock_row_pos[mb_y] : 0;
+        end_x   = FFMIN(h->deblock_mb_pos - mb_y * mb_width, mb_width);
+        if (end_x <= start_x) {
+            pthread_mutex_unlock(&h->deblock_mutex);
+            return;
+        }
+        h->deblock_next_row++;
+        h->deblock_row_pos[mb_y] = start_x;
+        above = wait_row_above(h, mb_y, FFMIN(start_x + 2, mb_width));
+        pthread_mutex_unlock(&h->deblock_mutex);
+
+        sl->mb_y = mb_y;
+        for (mb_x = start_x; mb_x < end_x; mb_x++) {
+            if (above < FFMIN(mb_x + 2, mb_width)) {
+                pthread_mutex_lock(&h->deblock_mutex);
+                above = wait_row_above(h, mb_y, FFMIN(mb_x + 2, mb_width));
+                pthread_mutex_unlock(&h->deblock_mutex);
+            }
+            loop_filter(h, sl, mb_x, mb_x + 1);
+
+            pthread_mutex_lock(&h->deblock_mutex);
+            h->deblock_row_pos[mb_y] = mb_x + 1;
+            pthread_cond_broadcast(&h->deblock_cond);
+            pthread_mutex_unlock(&h->deblock_mutex);
+        }
+
+        pthread_mutex_lock(&h->deblock_mutex);
+        // the rows are output and reported to frame threads in order
+        wait_row_above(h, mb_y, mb_width + 1);
+        pthread_mutex_unlock(&h->deblock_mutex);
+        // the last, partially decoded row of the slice is not finished
+        if (end_x == mb_width)
+            decode_finish_row(h, sl);
+
+        pthread_mutex_lock(&h->deblock_mutex);
+        h->deblock_row_pos[mb_y] = mb_width + 1;
+        pthread_cond_broadcast(&h->deblock_cond);
+        pthread_mutex_unlock(&h->deblock_mutex);
+    }
+}
+
+static int decode_slice_deferred_deblock(AVCodecContext *avctx, void *arg,
+                                         int jobnr, int threadnr)
+{
+    H264Context *h = avctx->priv_data;
+    int ret;
+
+    if (jobnr) {
+        deblock_slice_rows(h, &h->slice_ctx[jobnr]);
+        return 0;
+    }
+
+    ret = decode_slice(avctx, &h->slice_ctx[0]);
+
+    pthread_mutex_lock(&h->deblock_mutex);
+    h->deblock_end = 1;
+    pthread_cond_broadcast(&h->deblock_cond);
+    pthread_mutex_unlock(&h->deblock_mutex);
+
+    return ret;
+}
+
+/**
+ * Decode a single slice with the loop filter running in the other slice
+ * threads, pipelined behind the entropy decoding and reconstruction.
+ */
+static int decode_slice_pipelined(H264Context *h)
+{
+    AVCodecContext *const avctx = h->avctx;
+    H264SliceContext *sl = &h->slice_ctx[0];
+    int nb_jobs = FFMIN(avctx->thread_count, h->nb_slice_ctx);
+    int ret[H264_MAX_THREADS], i;
+
+    av_fast_malloc(&h->deblock_row_pos, &h->deblock_row_pos_size,
+                   h->mb_height * sizeof(*h->deblock_row_pos));
+    if (!h->deblock_row_pos)
+        return AVERROR(ENOMEM);
+
+    /* the deblocking jobs use the other slice contexts for their caches and
+     * only need the loop filter parameters of the slice */
+    for (i = 1; i < nb_jobs; i++) {
+        H264SliceContext *dsl = &h->slice_ctx[i];
+
+        dsl->deblocking_filter      = sl->deblocking_filter;
+        dsl->slice_alpha_c0_offset  = sl->slice_alpha_c0_offset;
+        dsl->slice_beta_offset      = sl->slice_beta_offset;
+        dsl->qp_thresh              = sl->qp_thresh;
+        dsl->qscale                 = sl->qscale;
+        dsl->mb_mbaff               = 0;
+        dsl->mb_field_decoding_flag = 0;
+        dsl->linesize               = h->cur_pic_ptr->f->linesize[0];
+        dsl->uvlinesize             = h->cur_pic_ptr->f->linesize[1];
+    }
+
+    h->deblock_first_row = sl->mb_y;
+    h->deblock_next_row  = sl->mb_y;
+    h->deblock_row_pos[sl->mb_y] = sl->mb_x;
+    h->deblock_mb_pos    = sl->mb_y * h->mb_width + sl->mb_x;
+    h->deblock_end       = 0;
+    h->deblock_deferred  = 1;
+    avctx->execute2(avctx, decode_slice_deferred_deblock, NULL, ret, nb_jobs);
+    h->deblock_deferred  = 0;
+
+    return ret[0];
+}
+#endif
+
 /**
  * Call decode_slice() for each context.
  *
@@ -2552,6 +2765,14 @@ int ff_h264_execute_decode_slices(H264Context *h, unsigned context_count)
 
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
 
+#if HAVE_THREADS
+        if (h->deferred_deblock && h->slice_ctx[0].deblocking_filter &&
+            (avctx->active_thread_type & FF_THREAD_SLICE) &&
+            avctx->thread_count > 1 &&
+            h->picture_structure == PICT_FRAME && !FRAME_MBAFF(h))
+            ret = decode_slice_pipelined(h);
+        else
+#endif
         ret = decode_slice(avctx, &h->slice_ctx[0]);
         h->mb_y = h->slice_ctx[0].mb_y;
         return ret;
@@ -2579,12 +2800,21 @@ int ff_h264_execute_decode_slices(H264Context *h, unsigned context_count)
             sl->next_slice_idx = next_slice_idx;
         }
 
+        h->slices_in_parallel = 1;
         avctx->execute(avctx, decode_slice, h->slice_ctx,
                        NULL, context_count, sizeof(h->slice_ctx[0]));
+        h->slices_in_parallel = 0;
 
         /* pull back stuff from slices to master context */
         sl                   = &h->slice_ctx[context_count - 1];
         h->mb_y              = sl->mb_y;
+
+        /* the rows above the end of the last slice are complete, the
+         * slices do not deblock across their edges when run in parallel */
+        if (!h->droppable && !h->slice_ctx[0].er.error_occurred)
+            ff_thread_report_progress(&h->cur_pic_ptr->tf,
+                                      16 * (sl->mb_y >> FIELD_PICTURE(h)) - 1,
+                                      h->picture_structure == PICT_BOTTOM_FIELD);
         if (CONFIG_ERROR_RESILIENCE) {
             for (i = 1; i < context_count; i++)
                 h->slice_ctx[0].er.error_count += h->slice_ctx[i].er.error_count;
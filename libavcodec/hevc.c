@@ -438,6 +438,13 @@ static int hls_slice_header(HEVCContext *s)
         return AVERROR_INVALIDDATA;
     }
     s->ps.pps = (HEVCPPS*)s->ps.pps_list[sh->pps_id]->data;
+    /* The CABAC initialization at the start of the CTB rows of a tile and
+     * the entry points are only handled for one or the other. */
+    if (s->ps.pps->entropy_coding_sync_enabled_flag &&
+        (s->ps.pps->num_tile_columns > 1 || s->ps.pps->num_tile_rows > 1)) {
+        avpriv_report_missing_feature(s->avctx, "Tiles combined with WPP");
+        return AVERROR_PATCHWELCOME;
+    }
     if (s->nal_unit_type == NAL_CRA_NUT && s->last_eos == 1)
         sh->no_output_of_prior_pics_flag = 1;
 
@@ -756,11 +763,10 @@ static int hls_slice_header(HEVCContext *s)
                 unsigned val = get_bits_long(gb, offset_len);
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
-            if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
-            } else
-                s->enable_parallel_tiles = 0;
+            /* tiles combined with WPP are rejected above */
+            s->enable_parallel_tiles = s->threads_number > 1 &&
+                                       (s->ps.pps->num_tile_rows > 1 ||
+                                        s->ps.pps->num_tile_columns > 1);
         } else
             s->enable_parallel_tiles = 0;
     }
@@ -1629,7 +1635,7 @@ static void hevc_await_progress(HEVCContext *s, HEVCFrame *ref,
 {
     int y = FFMAX(0, (mv->y >> 2) + y0 + height + 9);
 
-    if (s->threads_type == FF_THREAD_FRAME )
+    if (s->threads_type & FF_THREAD_FRAME)
         ff_thread_await_progress(&ref->tf, y, 0);
 }
 
@@ -2240,6 +2246,31 @@ static int hls_coding_quadtree(HEVCContext *s, int x0, int y0,
     return 0;
 }
 
+static int ctb_boundary_flags(HEVCContext *s, int x_ctb, int y_ctb,
+                              int ctb_addr_ts)
+{
+    int ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+    int ctb_addr_in_slice = ctb_addr_rs - s->sh.slice_addr;
+    int boundary_flags    = 0;
+
+    if (s->ps.pps->tiles_enabled_flag) {
+        if (x_ctb > 0 && s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - 1]])
+            boundary_flags |= BOUNDARY_LEFT_TILE;
+        if (x_ctb > 0 && s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - 1])
+            boundary_flags |= BOUNDARY_LEFT_SLICE;
+        if (y_ctb > 0 && s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - s->ps.sps->ctb_width]])
+            boundary_flags |= BOUNDARY_UPPER_TILE;
+        if (y_ctb > 0 && s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - s->ps.sps->ctb_width])
+            boundary_flags |= BOUNDARY_UPPER_SLICE;
+    } else {
+        if (ctb_addr_in_slice <= 0)
+            boundary_flags |= BOUNDARY_LEFT_SLICE;
+        if (ctb_addr_in_slice < s->ps.sps->ctb_width)
+            boundary_flags |= BOUNDARY_UPPER_SLICE;
+    }
+    return boundary_flags;
+}
+
 static void hls_decode_neighbour(HEVCContext *s, int x_ctb, int y_ctb,
                                  int ctb_addr_ts)
 {
@@ -2266,22 +2297,7 @@ static void hls_decode_neighbour(HEVCContext *s, int x_ctb, int y_ctb,
 
     lc->end_of_tiles_y = FFMIN(y_ctb + ctb_size, s->ps.sps->height);
 
-    lc->boundary_flags = 0;
-    if (s->ps.pps->tiles_enabled_flag) {
-        if (x_ctb > 0 && s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - 1]])
-            lc->boundary_flags |= BOUNDARY_LEFT_TILE;
-        if (x_ctb > 0 && s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - 1])
-            lc->boundary_flags |= BOUNDARY_LEFT_SLICE;
-        if (y_ctb > 0 && s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - s->ps.sps->ctb_width]])
-            lc->boundary_flags |= BOUNDARY_UPPER_TILE;
-        if (y_ctb > 0 && s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - s->ps.sps->ctb_width])
-            lc->boundary_flags |= BOUNDARY_UPPER_SLICE;
-    } else {
-        if (ctb_addr_in_slice <= 0)
-            lc->boundary_flags |= BOUNDARY_LEFT_SLICE;
-        if (ctb_addr_in_slice < s->ps.sps->ctb_width)
-            lc->boundary_flags |= BOUNDARY_UPPER_SLICE;
-    }
+    lc->boundary_flags = ctb_boundary_flags(s, x_ctb, y_ctb, ctb_addr_ts);
 
     lc->ctb_left_flag = ((x_ctb > 0) && (ctb_addr_in_slice > 0) && !(lc->boundary_flags & BOUNDARY_LEFT_TILE));
     lc->ctb_up_flag   = ((y_ctb > 0) && (ctb_addr_in_slice >= s->ps.sps->ctb_width) && !(lc->boundary_flags & BOUNDARY_UPPER_TILE));
@@ -2431,6 +2447,95 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
     return 0;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_ctb_addr_ts, int job, int self_id)
+{
+    HEVCContext *s1  = avctxt->priv_data, *s;
+    HEVCLocalContext *lc;
+    int more_data   = 1;
+    int *ctb_addr_ts_p = input_ctb_addr_ts;
+    int ctb_addr_ts = ctb_addr_ts_p[job];
+    int tile_id     = s1->ps.pps->tile_id[ctb_addr_ts];
+    int ret;
+
+    s = s1->sList[self_id];
+    lc = s->HEVClc;
+
+    if (job) {
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+        if (ret < 0)
+            return ret;
+    }
+
+    while (more_data && ctb_addr_ts < s->ps.sps->ctb_size &&
+           s->ps.pps->tile_id[ctb_addr_ts] == tile_id) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        int x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        int y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+
+        if (avpriv_atomic_int_get(&s1->wpp_err))
+            return AVERROR_INVALIDDATA;
+
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ff_hevc_cabac_init(s, ctb_addr_ts);
+
+        hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            s->tab_slice_address[ctb_addr_rs] = -1;
+            avpriv_atomic_int_set(&s1->wpp_err, 1);
+            return more_data;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    if (job == s1->sh.num_entry_point_offsets)
+        s1->last_tile_thread = self_id;
+    else if (!more_data)
+        avpriv_atomic_int_set(&s1->wpp_err, 1);
+
+    return ctb_addr_ts;
+}
+
+/**
+ * Deblock and SAO the CTBs of a slice whose tiles were decoded in parallel,
+ * in the same order as the single-threaded decoder filters them.
+ */
+static void hls_filter_slice_tiles(HEVCContext *s, int ctb_addr_ts, int ctb_addr_end)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+    int x_ctb = 0, y_ctb = 0;
+
+    if (ctb_addr_ts >= ctb_addr_end)
+        return;
+
+    for (; ctb_addr_ts < ctb_addr_end; ctb_addr_ts++) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        int boundary_flags;
+
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+
+        // the boundary strengths of tile edges were computed while the
+        // neighbouring tile was possibly still being decoded
+        boundary_flags = ctb_boundary_flags(s, x_ctb, y_ctb, ctb_addr_ts);
+        if (boundary_flags & (BOUNDARY_LEFT_TILE | BOUNDARY_UPPER_TILE))
+            ff_hevc_deblocking_boundary_strengths_tile_edges(s, x_ctb, y_ctb, boundary_flags);
+
+        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= s->ps.sps->width &&
+        y_ctb + ctb_size >= s->ps.sps->height)
+        ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const HEVCNAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2501,16 +2606,70 @@ static int hls_slice_data_wpp(HEVCContext *s, const HEVCNAL *nal)
     avpriv_atomic_int_set(&s->wpp_err, 0);
     ff_reset_entries(s->avctx);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
-        arg[i] = i;
-        ret[i] = 0;
-    }
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
+            arg[i] = i;
+            ret[i] = 0;
+        }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
         s->avctx->execute2(s->avctx, (void *) hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
-        res += ret[i];
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            res += ret[i];
+    } else if (s->enable_parallel_tiles) {
+        int ctb_addr_ts = s->ps.pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+
+        if (s->sh.dependent_slice_segment_flag &&
+            (!ctb_addr_ts ||
+             s->tab_slice_address[s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts - 1]] != s->sh.slice_addr)) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            res = AVERROR_INVALIDDATA;
+            goto end;
+        }
+
+        // each entry point starts a new tile
+        arg[0] = ctb_addr_ts;
+        for (i = 1; i <= s->sh.num_entry_point_offsets; i++) {
+            do {
+                ctb_addr_ts++;
+            } while (ctb_addr_ts < s->ps.sps->ctb_size &&
+                     s->ps.pps->tile_id[ctb_addr_ts] == s->ps.pps->tile_id[ctb_addr_ts - 1]);
+            if (ctb_addr_ts >= s->ps.sps->ctb_size) {
+                av_log(s->avctx, AV_LOG_ERROR, "Too many entry points for the tiles of the slice\n");
+                res = AVERROR_INVALIDDATA;
+                goto end;
+            }
+            arg[i] = ctb_addr_ts;
+            ret[i] = 0;
+        }
+        ret[0] = 0;
+        s->last_tile_thread = 0;
+
+        s->avctx->execute2(s->avctx, (void *) hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+
+        // filter what was decoded up to the first broken tile
+        for (i = 0; i < s->sh.num_entry_point_offsets; i++)
+            if (ret[i] != arg[i + 1])
+                break;
+        hls_filter_slice_tiles(s, arg[0], FFMAX(ret[i], arg[i]));
+
+        if (i < s->sh.num_entry_point_offsets)
+            res = ret[i] < 0 ? ret[i] : AVERROR_INVALIDDATA;
+        else
+            res = ret[i];
+
+        // dependent slice segments continue with the entropy coding state
+        // left at the end of this one
+        if (s->last_tile_thread) {
+            HEVCLocalContext *last = s->HEVClcList[s->last_tile_thread];
+            memcpy(lc->cabac_state, last->cabac_state, HEVC_CONTEXTS);
+            memcpy(lc->stat_coeff,  last->stat_coeff,  sizeof(lc->stat_coeff));
+            lc->qPy_pred = last->qPy_pred;
+            lc->qp_y     = last->qp_y;
+        }
+    }
+
+end:
     av_free(ret);
     av_free(arg);
     return res;
@@ -2799,7 +2958,7 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
     }
 
 fail:
-    if (s->ref && s->threads_type == FF_THREAD_FRAME)
+    if (s->ref && s->threads_type & FF_THREAD_FRAME)
         ff_thread_report_progress(&s->ref->tf, INT_MAX, 0);
 
     return ret;
@@ -3253,8 +3412,9 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
         }
     }
 
+    // both bits are set when slice threads run inside each frame thread
     if((avctx->active_thread_type & FF_THREAD_FRAME) && avctx->thread_count > 1)
-            s->threads_type = FF_THREAD_FRAME;
+            s->threads_type = avctx->active_thread_type;
         else
             s->threads_type = FF_THREAD_SLICE;
 
@@ -3323,5 +3483,6 @@ AVCodec ff_hevc_decoder = {
     .init_thread_copy      = hevc_init_thread_copy,
     .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                              AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal         = FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS,
     .profiles              = NULL_IF_CONFIG_SMALL(profiles),
 };
@@ -902,6 +902,7 @@ typedef struct HEVCContext {
 
     int enable_parallel_tiles;
     int wpp_err;
+    int last_tile_thread; ///< thread that decoded the last tile of the slice
 
     const uint8_t *data;
 
@@ -1052,6 +1053,9 @@ void ff_hevc_set_qPy(HEVCContext *s, int xBase, int yBase,
                      int log2_cb_size);
 void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                                            int log2_trafo_size);
+void ff_hevc_deblocking_boundary_strengths_tile_edges(HEVCContext *s,
+                                                      int x_ctb, int y_ctb,
+                                                      int boundary_flags);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCContext *s);
@@ -712,32 +712,28 @@ static int boundary_strength(HEVCContext *s, MvField *curr, MvField *neigh,
     return 1;
 }
 
-void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
-                                           int log2_trafo_size)
+static void upper_edge_boundary_strengths(HEVCContext *s, int x0, int y0,
+                                          int size, int boundary_flags)
 {
-    HEVCLocalContext *lc = s->HEVClc;
     MvField *tab_mvf     = s->ref->tab_mvf;
     int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
     int log2_min_tu_size = s->ps.sps->log2_min_tb_size;
     int min_pu_width     = s->ps.sps->min_pu_width;
     int min_tu_width     = s->ps.sps->min_tb_width;
-    int is_intra = tab_mvf[(y0 >> log2_min_pu_size) * min_pu_width +
-                           (x0 >> log2_min_pu_size)].pred_flag == PF_INTRA;
-    int boundary_upper, boundary_left;
-    int i, j, bs;
+    int boundary_upper, i, bs;
 
     boundary_upper = y0 > 0 && !(y0 & 7);
     if (boundary_upper &&
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
-          lc->boundary_flags & BOUNDARY_UPPER_SLICE &&
+          boundary_flags & BOUNDARY_UPPER_SLICE &&
           (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0) ||
          (!s->ps.pps->loop_filter_across_tiles_enabled_flag &&
-          lc->boundary_flags & BOUNDARY_UPPER_TILE &&
+          boundary_flags & BOUNDARY_UPPER_TILE &&
           (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0)))
         boundary_upper = 0;
 
     if (boundary_upper) {
-        RefPicList *rpl_top = (lc->boundary_flags & BOUNDARY_UPPER_SLICE) ?
+        RefPicList *rpl_top = (boundary_flags & BOUNDARY_UPPER_SLICE) ?
                               ff_hevc_get_ref_list(s, s->ref, x0, y0 - 1) :
                               s->ref->refPicList;
         int yp_pu = (y0 - 1) >> log2_min_pu_size;
@@ -745,7 +741,7 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
         int yp_tu = (y0 - 1) >> log2_min_tu_size;
         int yq_tu =  y0      >> log2_min_tu_size;
 
-            for (i = 0; i < (1 << log2_trafo_size); i += 4) {
+            for (i = 0; i < size; i += 4) {
                 int x_pu = (x0 + i) >> log2_min_pu_size;
                 int x_tu = (x0 + i) >> log2_min_tu_size;
                 MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
@@ -762,20 +758,30 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                 s->horizontal_bs[((x0 + i) + y0 * s->bs_width) >> 2] = bs;
             }
     }
+}
+
+static void left_edge_boundary_strengths(HEVCContext *s, int x0, int y0,
+                                         int size, int boundary_flags)
+{
+    MvField *tab_mvf     = s->ref->tab_mvf;
+    int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
+    int log2_min_tu_size = s->ps.sps->log2_min_tb_size;
+    int min_pu_width     = s->ps.sps->min_pu_width;
+    int min_tu_width     = s->ps.sps->min_tb_width;
+    int boundary_left, i, bs;
 
-    // bs for vertical TU boundaries
     boundary_left = x0 > 0 && !(x0 & 7);
     if (boundary_left &&
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
-          lc->boundary_flags & BOUNDARY_LEFT_SLICE &&
+          boundary_flags & BOUNDARY_LEFT_SLICE &&
           (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0) ||
          (!s->ps.pps->loop_filter_across_tiles_enabled_flag &&
-          lc->boundary_flags & BOUNDARY_LEFT_TILE &&
+          boundary_flags & BOUNDARY_LEFT_TILE &&
           (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0)))
         boundary_left = 0;
 
     if (boundary_left) {
-        RefPicList *rpl_left = (lc->boundary_flags & BOUNDARY_LEFT_SLICE) ?
+        RefPicList *rpl_left = (boundary_flags & BOUNDARY_LEFT_SLICE) ?
                                ff_hevc_get_ref_list(s, s->ref, x0 - 1, y0) :
                                s->ref->refPicList;
         int xp_pu = (x0 - 1) >> log2_min_pu_size;
@@ -783,7 +789,7 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
         int xp_tu = (x0 - 1) >> log2_min_tu_size;
         int xq_tu =  x0      >> log2_min_tu_size;
 
-            for (i = 0; i < (1 << log2_trafo_size); i += 4) {
+            for (i = 0; i < size; i += 4) {
                 int y_pu      = (y0 + i) >> log2_min_pu_size;
                 int y_tu      = (y0 + i) >> log2_min_tu_size;
                 MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
@@ -800,6 +806,25 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                 s->vertical_bs[(x0 + (y0 + i) * s->bs_width) >> 2] = bs;
             }
     }
+}
+
+void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
+                                           int log2_trafo_size)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    MvField *tab_mvf     = s->ref->tab_mvf;
+    int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
+    int min_pu_width     = s->ps.sps->min_pu_width;
+    int is_intra = tab_mvf[(y0 >> log2_min_pu_size) * min_pu_width +
+                           (x0 >> log2_min_pu_size)].pred_flag == PF_INTRA;
+    int i, j, bs;
+
+    upper_edge_boundary_strengths(s, x0, y0, 1 << log2_trafo_size,
+                                  lc->boundary_flags);
+
+    // bs for vertical TU boundaries
+    left_edge_boundary_strengths(s, x0, y0, 1 << log2_trafo_size,
+                                 lc->boundary_flags);
 
     if (log2_trafo_size > log2_min_pu_size && !is_intra) {
         RefPicList *rpl = s->ref->refPicList;
@@ -836,6 +861,22 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
     }
 }
 
+void ff_hevc_deblocking_boundary_strengths_tile_edges(HEVCContext *s,
+                                                      int x_ctb, int y_ctb,
+                                                      int boundary_flags)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+
+    if (boundary_flags & BOUNDARY_UPPER_TILE)
+        upper_edge_boundary_strengths(s, x_ctb, y_ctb,
+                                      FFMIN(ctb_size, s->ps.sps->width - x_ctb),
+                                      boundary_flags);
+    if (boundary_flags & BOUNDARY_LEFT_TILE)
+        left_edge_boundary_strengths(s, x_ctb, y_ctb,
+                                     FFMIN(ctb_size, s->ps.sps->height - y_ctb),
+                                     boundary_flags);
+}
+
 #undef LUMA
 #undef CB
 #undef CR
@@ -46,6 +46,13 @@
  * all.
  */
 #define FF_CODEC_CAP_INIT_CLEANUP           (1 << 1)
+/**
+ * The decoder supports frame and slice threading at the same time: slice
+ * threading may run inside each frame thread. The decoder must only test the
+ * FF_THREAD_FRAME and FF_THREAD_SLICE bits of active_thread_type separately
+ * and must cope with slices of the previous frame finishing out of order.
+ */
+#define FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS (1 << 2)
 
 
 #ifdef TRACE
@@ -124,7 +131,8 @@ typedef struct AVCodecInternal {
 
     FramePool *pool;
 
-    void *thread_ctx;
+    void *thread_ctx;       ///< frame threading context
+    void *slice_thread_ctx; ///< slice threading context
 
     /**
      * Current packet as passed into the decoder, to avoid having to pass the
@@ -62,6 +62,14 @@ typedef struct {
    Jpeg2000Component *comp;
 } Jpeg2000Tile;
 
+/* a row of code blocks of one band, the unit of parallel tier-1 coding */
+typedef struct {
+    Jpeg2000Tile *tile;
+    Jpeg2000Component *comp;
+    int reslevelno, bandno;
+    int cblky;
+} Jpeg2000CblkRow;
+
 typedef struct {
     AVClass *class;
     AVCodecContext *avctx;
@@ -87,7 +95,11 @@ typedef struct {
 
     Jpeg2000Tile *tile;
 
+    Jpeg2000CblkRow *cblk_rows;
+    int nb_cblk_rows;
+
     int format;
+    int target_size;
 } Jpeg2000EncoderContext;
 
 
@@ -360,6 +372,48 @@ static uint8_t *put_sot(Jpeg2000EncoderContext *s, int tileno)
  * allocate memory for them
  * divide the input image into tile-components
  */
+static int init_cblk_rows(Jpeg2000EncoderContext *s)
+{
+    int tileno, compno, reslevelno, bandno, cblky, pass;
+
+    // first pass counts the rows, second one fills them in
+    for (pass = 0; pass < 2; pass++) {
+        s->nb_cblk_rows = 0;
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+            Jpeg2000Tile *tile = s->tile + tileno;
+            for (compno = 0; compno < s->ncomponents; compno++) {
+                Jpeg2000Component *comp = tile->comp + compno;
+                for (reslevelno = 0; reslevelno < s->codsty.nreslevels; reslevelno++) {
+                    Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+                    for (bandno = 0; bandno < reslevel->nbands; bandno++) {
+                        Jpeg2000Band *band = reslevel->band + bandno;
+                        if (band->coord[0][0] == band->coord[0][1] ||
+                            band->coord[1][0] == band->coord[1][1])
+                            continue;
+                        for (cblky = 0; cblky < band->prec->nb_codeblocks_height; cblky++) {
+                            if (pass) {
+                                Jpeg2000CblkRow *row = s->cblk_rows + s->nb_cblk_rows;
+                                row->tile       = tile;
+                                row->comp       = comp;
+                                row->reslevelno = reslevelno;
+                                row->bandno     = bandno;
+                                row->cblky      = cblky;
+                            }
+                            s->nb_cblk_rows++;
+                        }
+                    }
+                }
+            }
+        }
+        if (!pass) {
+            s->cblk_rows = av_malloc_array(s->nb_cblk_rows, sizeof(*s->cblk_rows));
+            if (!s->cblk_rows && s->nb_cblk_rows)
+                return AVERROR(ENOMEM);
+        }
+    }
+    return 0;
+}
+
 static int init_tiles(Jpeg2000EncoderContext *s)
 {
     int tileno, tilex, tiley, compno;
@@ -403,7 +457,7 @@ static int init_tiles(Jpeg2000EncoderContext *s)
                     return ret;
             }
         }
-    return 0;
+    return init_cblk_rows(s);
 }
 
 static void copy_frame(Jpeg2000EncoderContext *s)
@@ -808,10 +862,13 @@ static int getcut(Jpeg2000Cblk *cblk, int64_t lambda, int dwt_norm)
     return res;
 }
 
-static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
+/* select the passes to include for the current lambda and return an
+ * estimate of the resulting size of the tile data in bytes */
+static int64_t truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
 {
     int precno, compno, reslevelno, bandno, cblkno, lev;
     Jpeg2000CodingStyle *codsty = &s->codsty;
+    int64_t size = 0;
 
     for (compno = 0; compno < s->ncomponents; compno++){
         Jpeg2000Component *comp = tile->comp + compno;
@@ -830,91 +887,154 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
 
                         cblk->ninclpasses = getcut(cblk, s->lambda,
                                 (int64_t)dwt_norms[codsty->transform == FF_DWT53][bandpos][lev] * (int64_t)band->i_stepsize >> 15);
+                        // a few bytes of packet header for each included code block
+                        if (cblk->ninclpasses)
+                            size += cblk->passes[cblk->ninclpasses - 1].rate + 3;
                     }
                 }
+                size++;
             }
         }
     }
+    return size;
 }
 
-static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+static int64_t frame_data_size(Jpeg2000EncoderContext *s, int64_t lambda)
 {
-    int compno, reslevelno, bandno, ret;
-    Jpeg2000T1Context t1;
-    Jpeg2000CodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        Jpeg2000Component *comp = s->tile[tileno].comp + compno;
-
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
+    int64_t size = 0;
+    int tileno;
 
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if ((ret = ff_dwt_encode(&comp->dwt, comp->i_data)) < 0)
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
-
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+    s->lambda = lambda;
+    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
+        size += truncpasses(s, s->tile + tileno);
+    return size;
+}
 
-            for (bandno = 0; bandno < reslevel->nbands ; bandno++){
-                Jpeg2000Band *band = reslevel->band + bandno;
-                Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+/* find the smallest lambda for which the frame fits into target bytes */
+static void rate_control(Jpeg2000EncoderContext *s, int64_t target)
+{
+    int64_t lo = 0, hi = LAMBDA_SCALE;
+    int i;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
+    while (frame_data_size(s, hi) > target && hi < LAMBDA_SCALE << 20) {
+        lo = hi;
+        hi *= 2;
+    }
+    for (i = 0; i < 40 && lo + 1 < hi; i++) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (frame_data_size(s, mid) > target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    frame_data_size(s, hi);
+}
 
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] << NMSEDEC_FRACBITS;
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
-                                    ptr++;
-                                }
-                            }
-                        }
-                        encode_cblk(s, &t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
-                    }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
+static void encode_cblk_row(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1,
+                            const Jpeg2000CblkRow *row)
+{
+    Jpeg2000CodingStyle *codsty = &s->codsty;
+    Jpeg2000Component *comp = row->comp;
+    int reslevelno = row->reslevelno, bandno = row->bandno;
+    Jpeg2000Band *band = comp->reslevel[reslevelno].band + bandno;
+    Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
+    int cblkx, cblkno = row->cblky * prec->nb_codeblocks_width;
+    int xx0, x0, xx1, y0, yy0, yy1, bandpos, first_row_end;
+
+    y0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
+    first_row_end = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
+                          band->coord[1][1]) - band->coord[1][0];
+    yy0 = y0 + (row->cblky ? first_row_end + ((row->cblky - 1) << band->log2_cblk_height) : 0);
+    yy1 = y0 + FFMIN(first_row_end + (row->cblky << band->log2_cblk_height),
+                     band->coord[1][1] - band->coord[1][0]);
+
+    bandpos = bandno + (reslevelno > 0);
+
+    if (reslevelno == 0 || bandno == 1)
+        xx0 = 0;
+    else
+        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
+    x0 = xx0;
+    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
+                band->coord[0][1]) - band->coord[0][0] + xx0;
+
+    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
+        int y, x;
+        if (codsty->transform == FF_DWT53){
+            for (y = yy0; y < yy1; y++){
+                int *ptr = t1->data + (y-yy0)*t1->stride;
+                for (x = xx0; x < xx1; x++){
+                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] << NMSEDEC_FRACBITS;
+                }
+            }
+        } else{
+            for (y = yy0; y < yy1; y++){
+                int *ptr = t1->data + (y-yy0)*t1->stride;
+                for (x = xx0; x < xx1; x++){
+                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
+                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
+                    ptr++;
                 }
             }
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+        encode_cblk(s, t1, prec->cblk + cblkno, row->tile, xx1 - xx0, yy1 - yy0,
+                    bandpos, codsty->nreslevels - reslevelno - 1);
+        xx0 = xx1;
+        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
     }
+}
 
-    av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
-    truncpasses(s, tile);
-    if ((ret = encode_packets(s, tile, tileno)) < 0)
+/* tier-1 coding of every nb_jobs-th row of code blocks */
+static int encode_cblk_rows(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    int nb_jobs = *(int *)arg;
+    Jpeg2000T1Context t1;
+    int i;
+
+    t1.stride = (1<<s->codsty.log2_cblk_width) + 2;
+    for (i = jobnr; i < s->nb_cblk_rows; i += nb_jobs)
+        encode_cblk_row(s, &t1, &s->cblk_rows[i]);
+
+    return 0;
+}
+
+/* forward DWT of one component of one tile */
+static int dwt_component(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000Component *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
+
+    return ff_dwt_encode(&comp->dwt, comp->i_data);
+}
+
+/* DWT and tier-1 coding of all tiles; the code blocks of each band are
+ * independent, so rows of them are coded in parallel. */
+static int encode_tiles_tier1(Jpeg2000EncoderContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int nb_comps = s->numXtiles * s->numYtiles * s->ncomponents;
+    int *rets, i, ret = 0, nb_jobs;
+
+    av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
+    rets = av_malloc_array(nb_comps, sizeof(*rets));
+    if (!rets)
+        return AVERROR(ENOMEM);
+    avctx->execute2(avctx, dwt_component, NULL, rets, nb_comps);
+    for (i = 0; i < nb_comps; i++)
+        if (rets[i] < 0)
+            ret = rets[i];
+    av_free(rets);
+    if (ret < 0)
         return ret;
-    av_log(s->avctx, AV_LOG_DEBUG, "after rate control\n");
+
+    av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
+    nb_jobs = avctx->active_thread_type & FF_THREAD_SLICE ? avctx->thread_count : 1;
+    nb_jobs = FFMIN(nb_jobs, s->nb_cblk_rows);
+    if (nb_jobs)
+        avctx->execute2(avctx, encode_cblk_rows, &nb_jobs, NULL, nb_jobs);
+    av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+
     return 0;
 }
 
@@ -931,6 +1051,7 @@ static void cleanup(Jpeg2000EncoderContext *s)
         av_freep(&s->tile[tileno].comp);
     }
     av_freep(&s->tile);
+    av_freep(&s->cblk_rows);
 }
 
 static void reinit(Jpeg2000EncoderContext *s)
@@ -948,10 +1069,29 @@ static void update_size(uint8_t *size, const uint8_t *end)
     AV_WB32(size, end-size);
 }
 
+/* write the SOT and SOD markers and the packets of every tile */
+static int encode_tiles_tier2(Jpeg2000EncoderContext *s)
+{
+    int tileno, ret;
+
+    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
+        uint8_t *psotptr;
+        if (!(psotptr = put_sot(s, tileno)))
+            return -1;
+        if (s->buf_end - s->buf < 2)
+            return -1;
+        bytestream_put_be16(&s->buf, JPEG2000_SOD);
+        if ((ret = encode_packets(s, s->tile + tileno, tileno)) < 0)
+            return ret;
+        bytestream_put_be32(&psotptr, s->buf - psotptr + 6);
+    }
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pict, int *got_packet)
 {
-    int tileno, ret;
+    int tileno, ret, i;
     Jpeg2000EncoderContext *s = avctx->priv_data;
     uint8_t *chunkstart, *jp2cstart, *jp2hstart;
 
@@ -1033,17 +1173,42 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     if ((ret = put_com(s, 0)) < 0)
         return ret;
 
-    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
-        uint8_t *psotptr;
-        if (!(psotptr = put_sot(s, tileno)))
-            return -1;
-        if (s->buf_end - s->buf < 2)
-            return -1;
-        bytestream_put_be16(&s->buf, JPEG2000_SOD);
-        if ((ret = encode_tile(s, s->tile + tileno, tileno)) < 0)
+    if ((ret = encode_tiles_tier1(s)) < 0)
+        return ret;
+
+    av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
+    if (s->target_size) {
+        uint8_t *tiles_start = s->buf;
+        // SOT and SOD of each tile and EOC
+        int64_t budget = s->target_size - (s->buf - s->buf_start) -
+                         14 * s->numXtiles * s->numYtiles - 2;
+        int64_t excess;
+
+        // the packet header sizes are only estimated by the rate control, so
+        // check the real size and retry with a smaller budget if it is over
+        for (i = 0; ; i++) {
+            rate_control(s, budget);
+            if ((ret = encode_tiles_tier2(s)) < 0)
+                return ret;
+            excess = (s->buf - s->buf_start) + 2 - s->target_size;
+            av_log(avctx, AV_LOG_DEBUG, "rate control try %d: %"PRId64" bytes off target\n",
+                   i, excess);
+            if (excess <= 0 || i == 3)
+                break;
+            budget -= excess;
+            s->buf  = tiles_start;
+            reinit(s);
+        }
+        if (excess > 0)
+            av_log(avctx, AV_LOG_VERBOSE, "frame is %"PRId64" bytes over target_size\n", excess);
+    } else {
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
+            truncpasses(s, s->tile + tileno);
+        if ((ret = encode_tiles_tier2(s)) < 0)
             return ret;
-        bytestream_put_be32(&psotptr, s->buf - psotptr + 6);
     }
+    av_log(s->avctx, AV_LOG_DEBUG, "after rate control\n");
+
     if (s->buf_end - s->buf < 2)
         return -1;
     bytestream_put_be16(&s->buf, JPEG2000_EOC);
@@ -1139,6 +1304,7 @@ static const AVOption options[] = {
     { "jp2",           NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = CODEC_JP2   }, 0,         0,           VE, "format"      },
     { "tile_width",    "Tile Width",        OFFSET(tile_width),    AV_OPT_TYPE_INT,   { .i64 = 256         }, 1,     1<<30,           VE, },
     { "tile_height",   "Tile Height",       OFFSET(tile_height),   AV_OPT_TYPE_INT,   { .i64 = 256         }, 1,     1<<30,           VE, },
+    { "target_size",   "Target size of each frame in bytes, 0 to use the frame quality", OFFSET(target_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE, },
 
     { NULL }
 };
@@ -1159,6 +1325,7 @@ AVCodec ff_jpeg2000_encoder = {
     .init           = j2kenc_init,
     .encode2        = encode_frame,
     .close          = j2kenc_destroy,
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_YUV444P, AV_PIX_FMT_GRAY8,
         AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
@@ -83,6 +83,15 @@ typedef struct Jpeg2000Tile {
     int coord[2][2];                    // border coordinates {{x0, x1}, {y0, y1}}
 } Jpeg2000Tile;
 
+/* a code block to be decoded by the tier-1 decoder */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component   *comp;
+    Jpeg2000CodingStyle *codsty;
+    Jpeg2000Band        *band;
+    Jpeg2000Cblk        *cblk;
+    int                 bandpos;
+} Jpeg2000CblkJob;
+
 typedef struct Jpeg2000DecoderContext {
     AVClass         *class;
     AVCodecContext  *avctx;
@@ -116,6 +125,10 @@ typedef struct Jpeg2000DecoderContext {
     Jpeg2000Tile    *tile;
     Jpeg2000DSPContext dsp;
 
+    Jpeg2000CblkJob *cblk_jobs;
+    unsigned int    cblk_jobs_size;
+    int             nb_cblk_jobs;
+
     /*options parameters*/
     int             reduction_factor;
 } Jpeg2000DecoderContext;
@@ -1616,83 +1629,133 @@ static inline void mct_decode(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
     s->dsp.mct_decode[tile->codsty[0].transform](src[0], src[1], src[2], csize);
 }
 
-static int jpeg2000_decode_tile(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
-                                AVFrame *picture)
+/* Gather the code blocks of all tiles, so that they can be decoded in
+ * parallel. */
+static int jpeg2000_collect_cblks(Jpeg2000DecoderContext *s)
 {
-    const AVPixFmtDescriptor *pixdesc = av_pix_fmt_desc_get(s->avctx->pix_fmt);
-    int compno, reslevelno, bandno;
-    int x, y;
-    int planar    = !!(pixdesc->flags & AV_PIX_FMT_FLAG_PLANAR);
-    int pixelsize = planar ? 1 : pixdesc->nb_components;
+    int tileno, compno, reslevelno, bandno, precno, cblkno, pass;
 
-    uint8_t *line;
+    /* count them first, then fill the list */
+    for (pass = 0; pass < 2; pass++) {
+        s->nb_cblk_jobs = 0;
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+            Jpeg2000Tile *tile = s->tile + tileno;
+
+            for (compno = 0; compno < s->ncomponents; compno++) {
+                Jpeg2000Component *comp     = tile->comp + compno;
+                Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+
+                for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
+                    Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
+                    int nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
+
+                    for (bandno = 0; bandno < rlevel->nbands; bandno++) {
+                        Jpeg2000Band *band = rlevel->band + bandno;
+
+                        if (band->coord[0][0] == band->coord[0][1] ||
+                            band->coord[1][0] == band->coord[1][1])
+                            continue;
+
+                        for (precno = 0; precno < nb_precincts; precno++) {
+                            Jpeg2000Prec *prec = band->prec + precno;
+                            int nb_cblks = prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+
+                            if (pass) {
+                                for (cblkno = 0; cblkno < nb_cblks; cblkno++) {
+                                    Jpeg2000CblkJob *job = &s->cblk_jobs[s->nb_cblk_jobs + cblkno];
+
+                                    job->comp    = comp;
+                                    job->codsty  = codsty;
+                                    job->band    = band;
+                                    job->cblk    = prec->cblk + cblkno;
+                                    job->bandpos = bandno + (reslevelno > 0);
+                                }
+                            }
+                            s->nb_cblk_jobs += nb_cblks;
+                        }
+                    }
+                }
+            }
+        }
+        if (!pass) {
+            av_fast_malloc(&s->cblk_jobs, &s->cblk_jobs_size,
+                           s->nb_cblk_jobs * sizeof(*s->cblk_jobs));
+            if (!s->cblk_jobs)
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    return 0;
+}
+
+/* Tier-1 decoding and dequantization of every nb_jobs-th code block */
+static int jpeg2000_decode_cblks(AVCodecContext *avctx, void *arg,
+                                 int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    int nb_jobs = *(int *)arg;
     Jpeg2000T1Context t1;
+    int i;
 
-    /* Loop on tile components */
-    for (compno = 0; compno < s->ncomponents; compno++) {
-        Jpeg2000Component *comp     = tile->comp + compno;
-        Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+    for (i = jobnr; i < s->nb_cblk_jobs; i += nb_jobs) {
+        Jpeg2000CblkJob *job = &s->cblk_jobs[i];
+        Jpeg2000Cblk *cblk   = job->cblk;
+        Jpeg2000Band *band   = job->band;
+        int x, y;
+
+        t1.stride = (1<<job->codsty->log2_cblk_width) + 2;
+        decode_cblk(s, job->codsty, &t1, cblk,
+                    cblk->coord[0][1] - cblk->coord[0][0],
+                    cblk->coord[1][1] - cblk->coord[1][0],
+                    job->bandpos);
+
+        x = cblk->coord[0][0] - band->coord[0][0];
+        y = cblk->coord[1][0] - band->coord[1][0];
+
+        if (job->codsty->transform == FF_DWT97)
+            dequantization_float(x, y, cblk, job->comp, &t1, band);
+        else if (job->codsty->transform == FF_DWT97_INT)
+            dequantization_int_97(x, y, cblk, job->comp, &t1, band);
+        else
+            dequantization_int(x, y, cblk, job->comp, &t1, band);
+    }
 
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
+    return 0;
+}
 
-        /* Loop on resolution levels */
-        for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
-            Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
-            /* Loop on bands */
-            for (bandno = 0; bandno < rlevel->nbands; bandno++) {
-                int nb_precincts, precno;
-                Jpeg2000Band *band = rlevel->band + bandno;
-                int cblkno = 0, bandpos;
+/* inverse DWT of one component of one tile */
+static int jpeg2000_dwt_component(AVCodecContext *avctx, void *arg,
+                                  int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000Tile *tile = s->tile + jobnr / s->ncomponents;
+    Jpeg2000Component *comp     = tile->comp   + jobnr % s->ncomponents;
+    Jpeg2000CodingStyle *codsty = tile->codsty + jobnr % s->ncomponents;
 
-                bandpos = bandno + (reslevelno > 0);
+    ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
 
-                if (band->coord[0][0] == band->coord[0][1] ||
-                    band->coord[1][0] == band->coord[1][1])
-                    continue;
+    return 0;
+}
 
-                nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
-                /* Loop on precincts */
-                for (precno = 0; precno < nb_precincts; precno++) {
-                    Jpeg2000Prec *prec = band->prec + precno;
-
-                    /* Loop on codeblocks */
-                    for (cblkno = 0; cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height; cblkno++) {
-                        int x, y;
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-                        decode_cblk(s, codsty, &t1, cblk,
-                                    cblk->coord[0][1] - cblk->coord[0][0],
-                                    cblk->coord[1][1] - cblk->coord[1][0],
-                                    bandpos);
-
-                        x = cblk->coord[0][0] - band->coord[0][0];
-                        y = cblk->coord[1][0] - band->coord[1][0];
-
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band);
-                        else if (codsty->transform == FF_DWT97_INT)
-                            dequantization_int_97(x, y, cblk, comp, &t1, band);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band);
-                   } /* end cblk */
-                } /*end prec */
-            } /* end band */
-        } /* end reslevel */
+/* inverse MCT and output of one tile */
+static int jpeg2000_write_tile(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    AVFrame *picture = arg;
+    Jpeg2000Tile *tile = s->tile + jobnr;
+    const AVPixFmtDescriptor *pixdesc = av_pix_fmt_desc_get(s->avctx->pix_fmt);
+    int compno;
+    int x, y;
+    int planar    = !!(pixdesc->flags & AV_PIX_FMT_FLAG_PLANAR);
+    int pixelsize = planar ? 1 : pixdesc->nb_components;
 
-        /* inverse DWT */
-        ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
-    } /*end comp */
+    uint8_t *line;
 
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
 
-    if (s->cdef[0] < 0) {
-        for (x = 0; x < s->ncomponents; x++)
-            s->cdef[x] = x + 1;
-        if ((s->ncomponents & 1) == 0)
-            s->cdef[s->ncomponents-1] = 0;
-    }
-
     if (s->precision <= 8) {
         for (compno = 0; compno < s->ncomponents; compno++) {
             Jpeg2000Component *comp = tile->comp + compno;
@@ -2054,13 +2117,23 @@ static av_cold int jpeg2000_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+static av_cold int jpeg2000_decode_end(AVCodecContext *avctx)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+
+    av_freep(&s->cblk_jobs);
+    s->cblk_jobs_size = 0;
+
+    return 0;
+}
+
 static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
                                  int *got_frame, AVPacket *avpkt)
 {
     Jpeg2000DecoderContext *s = avctx->priv_data;
     ThreadFrame frame = { .f = data };
     AVFrame *picture = data;
-    int tileno, ret;
+    int i, ret, nb_jobs;
 
     s->avctx     = avctx;
     bytestream2_init(&s->g, avpkt->data, avpkt->size);
@@ -2107,9 +2180,26 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     if (ret = jpeg2000_read_bitstream_packets(s))
         goto end;
 
-    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
-        if (ret = jpeg2000_decode_tile(s, s->tile + tileno, picture))
-            goto end;
+    if (ret = jpeg2000_collect_cblks(s))
+        goto end;
+
+    /* Code blocks are decoded in parallel, then each component of each tile
+     * is transformed, and finally each tile is written to the picture. */
+    nb_jobs = avctx->active_thread_type & FF_THREAD_SLICE ? avctx->thread_count : 1;
+    nb_jobs = FFMIN(nb_jobs, s->nb_cblk_jobs);
+    if (nb_jobs)
+        avctx->execute2(avctx, jpeg2000_decode_cblks, &nb_jobs, NULL, nb_jobs);
+    avctx->execute2(avctx, jpeg2000_dwt_component, NULL, NULL,
+                    s->numXtiles * s->numYtiles * s->ncomponents);
+
+    if (s->cdef[0] < 0) {
+        for (i = 0; i < s->ncomponents; i++)
+            s->cdef[i] = i + 1;
+        if ((s->ncomponents & 1) == 0)
+            s->cdef[s->ncomponents-1] = 0;
+    }
+    avctx->execute2(avctx, jpeg2000_write_tile, picture, NULL,
+                    s->numXtiles * s->numYtiles);
 
     jpeg2000_dec_cleanup(s);
 
@@ -2161,10 +2251,13 @@ AVCodec ff_jpeg2000_decoder = {
     .long_name        = NULL_IF_CONFIG_SMALL("JPEG 2000"),
     .type             = AVMEDIA_TYPE_VIDEO,
     .id               = AV_CODEC_ID_JPEG2000,
-    .capabilities     = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_DR1,
+    .capabilities     = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                        AV_CODEC_CAP_DR1,
+    .caps_internal    = FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS,
     .priv_data_size   = sizeof(Jpeg2000DecoderContext),
     .init_static_data = jpeg2000_init_static_data,
     .init             = jpeg2000_decode_init,
+    .close            = jpeg2000_decode_end,
     .decode           = jpeg2000_decode_frame,
     .priv_class       = &jpeg2000_class,
     .max_lowres       = 5,
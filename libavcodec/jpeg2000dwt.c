@@ -25,6 +25,7 @@
  * Discrete wavelet transform
  */
 
+#include "config.h"
 #include "libavutil/avassert.h"
 #include "libavutil/common.h"
 #include "libavutil/mem.h"
@@ -323,11 +324,52 @@ static void sr_1d53(int *p, int i0, int i1)
         p[2 * i + 1] += (p[2 * i] + p[2 * i + 2]) >> 1;
 }
 
+static void lift53_sub(int32_t *p, int n)
+{
+    int i, x;
+
+    for (i = 0; i < n; i++, p += 2 * FF_DWT_COLS)
+        for (x = 0; x < FF_DWT_COLS; x++)
+            p[x] -= (p[x - FF_DWT_COLS] + p[x + FF_DWT_COLS] + 2) >> 2;
+}
+
+static void lift53_add(int32_t *p, int n)
+{
+    int i, x;
+
+    for (i = 0; i < n; i++, p += 2 * FF_DWT_COLS)
+        for (x = 0; x < FF_DWT_COLS; x++)
+            p[x] += (p[x - FF_DWT_COLS] + p[x + FF_DWT_COLS]) >> 1;
+}
+
+/* sr_1d53() on FF_DWT_COLS columns, p[i * FF_DWT_COLS + x] being row i of column x */
+static void sr_cols53(DWTContext *s, int32_t *p, int i0, int i1)
+{
+    const size_t row = FF_DWT_COLS * sizeof(*p);
+    int x;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (x = 0; x < FF_DWT_COLS; x++)
+                p[FF_DWT_COLS + x] >>= 1;
+        return;
+    }
+
+    memcpy(p + (i0 - 1) * FF_DWT_COLS, p + (i0 + 1) * FF_DWT_COLS, row);
+    memcpy(p +  i1      * FF_DWT_COLS, p + (i1 - 2) * FF_DWT_COLS, row);
+    memcpy(p + (i0 - 2) * FF_DWT_COLS, p + (i0 + 2) * FF_DWT_COLS, row);
+    memcpy(p + (i1 + 1) * FF_DWT_COLS, p + (i1 - 3) * FF_DWT_COLS, row);
+
+    s->lift53_sub(p +  2 * (i0 >> 1)      * FF_DWT_COLS, (i1 >> 1) - (i0 >> 1) + 1);
+    s->lift53_add(p + (2 * (i0 >> 1) + 1) * FF_DWT_COLS, (i1 >> 1) - (i0 >> 1));
+}
+
 static void dwt_decode53(DWTContext *s, int *t)
 {
     int lev;
     int w     = s->linelen[s->ndeclevels - 1][0];
     int32_t *line = s->i_linebuf;
+    int32_t *cols = s->i_linebuf + 3 * FF_DWT_COLS;
     line += 3;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
@@ -355,8 +397,23 @@ static void dwt_decode53(DWTContext *s, int *t)
         }
 
         // VER_SD
+        l = cols + mv * FF_DWT_COLS;
+        for (lp = 0; lp + FF_DWT_COLS <= lh; lp += FF_DWT_COLS) {
+            int i, j = 0;
+            // copy with interleaving
+            for (i = mv; i < lv; i += 2, j++)
+                memcpy(l + i * FF_DWT_COLS, t + w * j + lp, FF_DWT_COLS * sizeof(*l));
+            for (i = 1 - mv; i < lv; i += 2, j++)
+                memcpy(l + i * FF_DWT_COLS, t + w * j + lp, FF_DWT_COLS * sizeof(*l));
+
+            sr_cols53(s, cols, mv, mv + lv);
+
+            for (i = 0; i < lv; i++)
+                memcpy(t + w * i + lp, l + i * FF_DWT_COLS, FF_DWT_COLS * sizeof(*l));
+        }
+
         l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        for (; lp < lh; lp++) {
             int i, j = 0;
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
@@ -399,11 +456,53 @@ static void sr_1d97_float(float *p, int i0, int i1)
         p[2 * i + 1] += F_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]);
 }
 
+static void lift_float(float *p, int n, float coef)
+{
+    int i, x;
+
+    for (i = 0; i < n; i++, p += 2 * FF_DWT_COLS)
+        for (x = 0; x < FF_DWT_COLS; x++)
+            p[x] -= coef * (p[x - FF_DWT_COLS] + p[x + FF_DWT_COLS]);
+}
+
+/* sr_1d97_float() on FF_DWT_COLS columns, p[i * FF_DWT_COLS + x] being row i
+ * of column x; the additions are done as subtractions of the negated
+ * product, which gives the same result */
+static void sr_cols97_float(DWTContext *s, float *p, int i0, int i1)
+{
+    const size_t row = FF_DWT_COLS * sizeof(*p);
+    int i, x;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (x = 0; x < FF_DWT_COLS; x++)
+                p[FF_DWT_COLS + x] *= F_LFTG_K/2;
+        else
+            for (x = 0; x < FF_DWT_COLS; x++)
+                p[x] *= F_LFTG_X;
+        return;
+    }
+
+    for (i = 1; i <= 4; i++) {
+        memcpy(p + (i0 - i)     * FF_DWT_COLS, p + (i0 + i)     * FF_DWT_COLS, row);
+        memcpy(p + (i1 + i - 1) * FF_DWT_COLS, p + (i1 - i - 1) * FF_DWT_COLS, row);
+    }
+
+    s->lift_float(p + (2 * (i0 >> 1) - 2) * FF_DWT_COLS, (i1 >> 1) - (i0 >> 1) + 3,  F_LFTG_DELTA);
+    /* step 4 */
+    s->lift_float(p + (2 * (i0 >> 1) - 1) * FF_DWT_COLS, (i1 >> 1) - (i0 >> 1) + 2,  F_LFTG_GAMMA);
+    /*step 5*/
+    s->lift_float(p +  2 * (i0 >> 1)      * FF_DWT_COLS, (i1 >> 1) - (i0 >> 1) + 1, -F_LFTG_BETA);
+    /* step 6 */
+    s->lift_float(p + (2 * (i0 >> 1) + 1) * FF_DWT_COLS, (i1 >> 1) - (i0 >> 1),     -F_LFTG_ALPHA);
+}
+
 static void dwt_decode97_float(DWTContext *s, float *t)
 {
     int lev;
     int w       = s->linelen[s->ndeclevels - 1][0];
     float *line = s->f_linebuf;
+    float *cols = s->f_linebuf + 5 * FF_DWT_COLS;
     float *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
     line += 5;
@@ -432,8 +531,23 @@ static void dwt_decode97_float(DWTContext *s, float *t)
         }
 
         // VER_SD
+        l = cols + mv * FF_DWT_COLS;
+        for (lp = 0; lp + FF_DWT_COLS <= lh; lp += FF_DWT_COLS) {
+            int i, j = 0;
+            // copy with interleaving
+            for (i = mv; i < lv; i += 2, j++)
+                memcpy(l + i * FF_DWT_COLS, data + w * j + lp, FF_DWT_COLS * sizeof(*l));
+            for (i = 1 - mv; i < lv; i += 2, j++)
+                memcpy(l + i * FF_DWT_COLS, data + w * j + lp, FF_DWT_COLS * sizeof(*l));
+
+            sr_cols97_float(s, cols, mv, mv + lv);
+
+            for (i = 0; i < lv; i++)
+                memcpy(data + w * i + lp, l + i * FF_DWT_COLS, FF_DWT_COLS * sizeof(*l));
+        }
+
         l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        for (; lp < lh; lp++) {
             int i, j = 0;
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
@@ -558,7 +672,7 @@ int ff_jpeg2000_dwt_init(DWTContext *s, uint16_t border[2][2],
         }
     switch (type) {
     case FF_DWT97:
-        s->f_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->f_linebuf));
+        s->f_linebuf = av_malloc_array((maxlen + 12) * FF_DWT_COLS, sizeof(*s->f_linebuf));
         if (!s->f_linebuf)
             return AVERROR(ENOMEM);
         break;
@@ -568,13 +682,21 @@ int ff_jpeg2000_dwt_init(DWTContext *s, uint16_t border[2][2],
             return AVERROR(ENOMEM);
         break;
     case FF_DWT53:
-        s->i_linebuf = av_malloc_array((maxlen +  6), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_malloc_array((maxlen +  6) * FF_DWT_COLS, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
     default:
         return -1;
     }
+
+    s->lift_float = lift_float;
+    s->lift53_sub = lift53_sub;
+    s->lift53_add = lift53_add;
+
+    if (ARCH_X86)
+        ff_jpeg2000dwt_init_x86(s);
+
     return 0;
 }
 
@@ -30,6 +30,7 @@
 #include <stdint.h>
 
 #define FF_DWT_MAX_DECLVLS 32 ///< max number of decomposition levels
+#define FF_DWT_COLS        16 ///< number of columns of the vertical inverse transform done at once
 #define F_LFTG_K      1.230174104914001f
 #define F_LFTG_X      0.812893066115961f
 
@@ -48,6 +49,16 @@ typedef struct DWTContext {
     uint8_t type;                        ///< 0 for 9/7; 1 for 5/3
     int32_t *i_linebuf;                  ///< int buffer used by transform
     float   *f_linebuf;                  ///< float buffer used by transform
+
+    /* lifting steps of the vertical inverse transform, on n > 0 rows of
+     * FF_DWT_COLS samples two rows apart, aligned to 16 bytes and with the
+     * neighbouring rows FF_DWT_COLS samples before and after */
+    /// p[x] -= coef * (p[x - FF_DWT_COLS] + p[x + FF_DWT_COLS]), 9/7
+    void (*lift_float)(float *p, int n, float coef);
+    /// p[x] -= (p[x - FF_DWT_COLS] + p[x + FF_DWT_COLS] + 2) >> 2, 5/3
+    void (*lift53_sub)(int32_t *p, int n);
+    /// p[x] += (p[x - FF_DWT_COLS] + p[x + FF_DWT_COLS]) >> 1, 5/3
+    void (*lift53_add)(int32_t *p, int n);
 } DWTContext;
 
 /**
@@ -65,4 +76,6 @@ int ff_dwt_decode(DWTContext *s, void *t);
 
 void ff_dwt_destroy(DWTContext *s);
 
+void ff_jpeg2000dwt_init_x86(DWTContext *s);
+
 #endif /* AVCODEC_JPEG2000DWT_H */
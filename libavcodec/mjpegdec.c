@@ -645,10 +645,11 @@ unk_pixfmt:
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -657,47 +658,48 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, int16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * quant_matrix[0] + s->last_dc[component];
+    val = val * quant_matrix[0] + last_dc[component];
     val = FFMIN(val, 32767);
-    s->last_dc[component] = val;
+    last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -707,7 +709,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[j];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -718,7 +720,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     int val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -982,7 +984,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
 
                 PREDICT(pred, topleft[i], top[i], left[i], modified_predictor);
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1083,7 +1085,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if(bits<=8){
@@ -1151,7 +1153,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if(bits<=8){
@@ -1217,6 +1219,133 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+typedef struct RestartIntervalScan {
+    int nb_components;
+    int nb_intervals;
+    int first_rst;   ///< index in rst_offsets of the first marker of the scan
+    int start, end;  ///< byte range of the scan data in the unescaped buffer
+    int end_bits;    ///< bit position in the buffer where decoding stopped
+} RestartIntervalScan;
+
+static int decode_restart_intervals(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    RestartIntervalScan *scan = arg;
+    LOCAL_ALIGNED_16(int16_t, block, [64]);
+    int last_dc[MAX_COMPONENTS];
+    int nb_jobs = FFMIN(scan->nb_intervals, avctx->thread_count);
+    int first   = scan->nb_intervals *  jobnr      / nb_jobs;
+    int last    = scan->nb_intervals * (jobnr + 1) / nb_jobs;
+    int nb_mbs  = s->mb_width * s->mb_height;
+    int bytes_per_pixel = 1 + (s->bits > 8);
+    GetBitContext gb;
+    int i, n, mb;
+
+    for (n = first; n < last; n++) {
+        int start  = n ? s->rst_offsets[scan->first_rst + n - 1] : scan->start;
+        int end    = n < scan->nb_intervals - 1 ?
+                     s->rst_offsets[scan->first_rst + n] - 2 : scan->end;
+        int mb_end = FFMIN((n + 1) * s->restart_interval, nb_mbs);
+
+        init_get_bits8(&gb, s->buffer + start, end - start);
+        for (i = 0; i < scan->nb_components; i++)
+            last_dc[i] = 4 << s->bits;
+
+        for (mb = n * s->restart_interval; mb < mb_end; mb++) {
+            int mb_x = mb % s->mb_width;
+            int mb_y = mb / s->mb_width;
+
+            if (get_bits_left(&gb) < 0)
+                return AVERROR_INVALIDDATA;
+            for (i = 0; i < scan->nb_components; i++) {
+                int c = s->comp_index[i];
+                int h = s->h_scount[i];
+                int v = s->v_scount[i];
+                int x = 0, y = 0, j;
+
+                for (j = 0; j < s->nb_blocks[i]; j++) {
+                    int block_offset = (((s->linesize[c] * (v * mb_y + y) * 8) +
+                                         (h * mb_x + x) * 8 * bytes_per_pixel) >> avctx->lowres);
+
+                    if (s->interlaced && s->bottom_field)
+                        block_offset += s->linesize[c] >> 1;
+                    s->bdsp.clear_block(block);
+                    if (decode_block(s, &gb, last_dc, block, i,
+                                     s->dc_index[i], s->ac_index[i],
+                                     s->quant_matrixes[s->quant_sindex[i]]) < 0)
+                        return AVERROR_INVALIDDATA;
+                    if (   8*(h * mb_x + x) < s->width
+                        && 8*(v * mb_y + y) < s->height) {
+                        uint8_t *ptr = s->picture_ptr->data[c] + block_offset;
+
+                        s->idsp.idct_put(ptr, s->linesize[c], block);
+                        if (s->bits & 7)
+                            shift_output(s, ptr, s->linesize[c]);
+                    }
+                    if (++x == h) {
+                        x = 0;
+                        y++;
+                    }
+                }
+            }
+        }
+
+        // every interval but the last must end right before its RSTn marker
+        if (n < scan->nb_intervals - 1 && get_bits_left(&gb) >= 8)
+            return AVERROR_INVALIDDATA;
+        if (n == scan->nb_intervals - 1)
+            scan->end_bits = start * 8 + get_bits_count(&gb);
+    }
+    return 0;
+}
+
+/**
+ * Decode a baseline scan by entropy decoding its restart intervals in
+ * parallel, using the RSTn marker positions found while unescaping it.
+ * @return 0 if the scan was decoded, a negative error code if it has to be
+ *         decoded sequentially instead
+ */
+static int mjpeg_decode_scan_sliced(MJpegDecodeContext *s, int nb_components)
+{
+    RestartIntervalScan scan = { .nb_components = nb_components };
+    int nb_mbs = s->mb_width * s->mb_height;
+    int i, ret, nb_jobs;
+    int *rets;
+
+    if (s->gb.buffer != s->buffer || get_bits_count(&s->gb) & 7)
+        return AVERROR(EINVAL);
+
+    scan.nb_intervals = (nb_mbs + s->restart_interval - 1) / s->restart_interval;
+    scan.start        = get_bits_count(&s->gb) >> 3;
+    scan.end          = s->gb.size_in_bits >> 3;
+    while (scan.first_rst < s->nb_rst_offsets &&
+           s->rst_offsets[scan.first_rst] <= scan.start)
+        scan.first_rst++;
+    if (scan.nb_intervals < 2 ||
+        s->nb_rst_offsets - scan.first_rst < scan.nb_intervals - 1)
+        return AVERROR(EINVAL);
+
+    nb_jobs = FFMIN(scan.nb_intervals, s->avctx->thread_count);
+    rets = av_malloc_array(nb_jobs, sizeof(*rets));
+    if (!rets)
+        return AVERROR(ENOMEM);
+    s->avctx->execute2(s->avctx, decode_restart_intervals, &scan, rets, nb_jobs);
+    ret = 0;
+    for (i = 0; i < nb_jobs; i++)
+        if (rets[i] < 0)
+            ret = rets[i];
+    av_free(rets);
+    if (ret < 0) {
+        av_log(s->avctx, AV_LOG_DEBUG,
+               "restart intervals do not match their markers, decoding sequentially\n");
+        return ret;
+    }
+
+    skip_bits_long(&s->gb, scan.end_bits - get_bits_count(&s->gb));
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                              int Al, const uint8_t *mb_bitmask,
                              int mb_bitmask_size,
@@ -1237,6 +1366,11 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
     }
 
+    if (!mb_bitmask && !s->progressive && s->restart_interval &&
+        (s->avctx->active_thread_type & FF_THREAD_SLICE) &&
+        mjpeg_decode_scan_sliced(s, nb_components) >= 0)
+        return 0;
+
     s->restart_count = 0;
 
     for (i = 0; i < nb_components; i++) {
@@ -1288,7 +1422,7 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
 
                         } else {
                             s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
+                            if (decode_block(s, &s->gb, s->last_dc, s->block, i,
                                              s->dc_index[i], s->ac_index[i],
                                              s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                                 av_log(s->avctx, AV_LOG_ERROR,
@@ -1889,6 +2023,7 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
         const uint8_t *src = *buf_ptr;
         uint8_t *dst = s->buffer;
 
+        s->nb_rst_offsets = 0;
         while (src < buf_end) {
             uint8_t x = *(src++);
 
@@ -1898,9 +2033,19 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                     while (src < buf_end && x == 0xff)
                         x = *(src++);
 
-                    if (x >= 0xd0 && x <= 0xd7)
+                    if (x >= 0xd0 && x <= 0xd7) {
+                        int *offsets;
+
                         *(dst++) = x;
-                    else if (x)
+                        /* remember where each restart interval starts, so
+                         * that they can be decoded in parallel */
+                        offsets = av_fast_realloc(s->rst_offsets, &s->rst_offsets_size,
+                                                  (s->nb_rst_offsets + 1) * sizeof(*offsets));
+                        if (!offsets)
+                            return AVERROR(ENOMEM);
+                        s->rst_offsets = offsets;
+                        s->rst_offsets[s->nb_rst_offsets++] = dst - s->buffer;
+                    } else if (x)
                         break;
                 }
             }
@@ -2362,6 +2507,8 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
+    av_freep(&s->rst_offsets);
+    s->rst_offsets_size = 0;
 
     for (i = 0; i < 3; i++) {
         for (j = 0; j < 4; j++)
@@ -2407,7 +2554,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
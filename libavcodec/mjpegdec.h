@@ -110,6 +110,9 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *rst_offsets;               ///< unescaped offsets following each RSTn marker of the current scan
+    unsigned int rst_offsets_size;
+    int nb_rst_offsets;
 
     int buggy_avid;
     int cs_itu601;
@@ -104,6 +104,13 @@ static inline int ff_h263_round_chroma(int x)
 
 int ff_init_me(struct MpegEncContext *s);
 
+/**
+ * Set the penalty factors of the compare functions from the current lambda.
+ * ff_estimate_b_frame_motion() weighs the MB types with the mb_cmp factor
+ * before computing it, i.e. with the one left by the previous MB.
+ */
+void ff_me_init_penalty_factors(struct MpegEncContext *s);
+
 void ff_estimate_p_frame_motion(struct MpegEncContext *s, int mb_x, int mb_y);
 void ff_estimate_b_frame_motion(struct MpegEncContext *s, int mb_x, int mb_y);
 
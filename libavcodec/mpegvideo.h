@@ -58,6 +58,14 @@
 #include "libavutil/opt.h"
 #include "libavutil/timecode.h"
 
+#if HAVE_PTHREADS
+#   include <pthread.h>
+#elif HAVE_OS2THREADS
+#   include "compat/os2threads.h"
+#elif HAVE_W32THREADS
+#   include "compat/w32pthreads.h"
+#endif
+
 #define FRAME_SKIPPED 100 ///< return value for header parsers if frame is not coded
 
 #define MAX_FCODE 7
@@ -266,6 +274,16 @@ typedef struct MpegEncContext {
     int me_method;                       ///< ME algorithm
 #endif
     int motion_est;                      ///< ME algorithm
+
+    /* wavefront motion estimation, the state lives in the main context */
+    int me_wavefront;                    ///< estimate motion as one slice, independently of the slice contexts
+    int *me_row_progress;                ///< number of MBs estimated in each row
+    int me_next_row;                     ///< next row to be handed out to a slice context
+#if HAVE_THREADS
+    pthread_mutex_t me_progress_mutex;
+    pthread_cond_t  me_progress_cond;
+#endif
+
     int mv_dir;
 #define MV_DIR_FORWARD   1
 #define MV_DIR_BACKWARD  2
@@ -606,6 +624,7 @@ typedef struct MpegEncContext {
 { "zero", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = FF_ME_ZERO }, 0, 0, FF_MPV_OPT_FLAGS, "motion_est" }, \
 { "epzs", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = FF_ME_EPZS }, 0, 0, FF_MPV_OPT_FLAGS, "motion_est" }, \
 { "xone", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = FF_ME_XONE }, 0, 0, FF_MPV_OPT_FLAGS, "motion_est" }, \
+{"me_wavefront", "estimate motion in wavefront order, making it independent of the number of slice threads", FF_MPV_OFFSET(me_wavefront), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, FF_MPV_OPT_FLAGS }, \
 
 extern const AVOption ff_mpv_generic_options[];
 
@@ -880,6 +880,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (ff_mpv_common_init(s) < 0)
         return -1;
 
+#if HAVE_THREADS
+    pthread_mutex_init(&s->me_progress_mutex, NULL);
+    pthread_cond_init(&s->me_progress_cond, NULL);
+#endif
+
     ff_fdctdsp_init(&s->fdsp, avctx);
     ff_me_cmp_init(&s->mecc, avctx);
     ff_mpegvideoencdsp_init(&s->mpvencdsp, avctx);
@@ -892,6 +897,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
                           (MAX_RUN + 1) * 2 * sizeof(int), fail);
     }
     FF_ALLOCZ_OR_GOTO(s->avctx, s->avctx->stats_out, 256, fail);
+    FF_ALLOCZ_OR_GOTO(s->avctx, s->me_row_progress,
+                      s->mb_height * sizeof(*s->me_row_progress), fail);
 
     FF_ALLOCZ_OR_GOTO(s->avctx, s->q_intra_matrix,   64 * 32 * sizeof(int), fail);
     FF_ALLOCZ_OR_GOTO(s->avctx, s->q_chroma_intra_matrix, 64 * 32 * sizeof(int), fail);
@@ -1069,6 +1076,11 @@ av_cold int ff_mpv_encode_end(AVCodecContext *avctx)
     av_freep(&s->input_picture);
     av_freep(&s->reordered_input_picture);
     av_freep(&s->dct_offset);
+    av_freep(&s->me_row_progress);
+#if HAVE_THREADS
+    pthread_mutex_destroy(&s->me_progress_mutex);
+    pthread_cond_destroy(&s->me_progress_cond);
+#endif
 
     return 0;
 }
@@ -2687,6 +2699,119 @@ static int estimate_motion_thread(AVCodecContext *c, void *arg){
     return 0;
 }
 
+/* number of MBs estimated between two progress reports of a row */
+#define ME_WAVEFRONT_STEP 8
+
+static int me_wavefront_next_row(MpegEncContext *m)
+{
+    int mb_y;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&m->me_progress_mutex);
+#endif
+    mb_y = m->me_next_row++;
+#if HAVE_THREADS
+    pthread_mutex_unlock(&m->me_progress_mutex);
+#endif
+    return mb_y;
+}
+
+/**
+ * Wait until at least mb_count MBs of row mb_y have been estimated.
+ * @return the number of MBs estimated in the row
+ */
+static int me_wavefront_wait(MpegEncContext *m, int mb_y, int mb_count)
+{
+    int progress;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&m->me_progress_mutex);
+    while (m->me_row_progress[mb_y] < mb_count)
+        pthread_cond_wait(&m->me_progress_cond, &m->me_progress_mutex);
+#endif
+    progress = m->me_row_progress[mb_y];
+#if HAVE_THREADS
+    pthread_mutex_unlock(&m->me_progress_mutex);
+#endif
+    return progress;
+}
+
+static void me_wavefront_report(MpegEncContext *m, int mb_y, int mb_count)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&m->me_progress_mutex);
+#endif
+    m->me_row_progress[mb_y] = mb_count;
+#if HAVE_THREADS
+    pthread_cond_broadcast(&m->me_progress_cond);
+    pthread_mutex_unlock(&m->me_progress_mutex);
+#endif
+}
+
+/**
+ * Motion estimation with the whole frame as a single slice: the rows are
+ * handed out in order to the slice contexts, and each MB waits for the MBs
+ * above and above-right of it, whose vectors are used as predictors.
+ * The result does not depend on the number of slice contexts.
+ * Progress is reported every ME_WAVEFRONT_STEP MBs, so a row trails the
+ * one above it by up to that many MBs.
+ */
+static int estimate_motion_wavefront_thread(AVCodecContext *c, void *arg,
+                                            int jobnr, int threadnr)
+{
+    MpegEncContext *m = arg;
+    MpegEncContext *s = m->thread_context[jobnr];
+    int start_mb_y    = s->start_mb_y;
+    int end_mb_y      = s->end_mb_y;
+
+    ff_check_alignment();
+
+    /* the penalty compensation is only applied to the main context, use it
+     * for all rows, whichever context they run on */
+    s->lambda      = m->lambda;
+    s->lambda2     = m->lambda2;
+    s->me.dia_size = s->avctx->dia_size;
+    s->start_mb_y  = 0;
+    s->end_mb_y    = s->mb_height;
+    while ((s->mb_y = me_wavefront_next_row(m)) < s->mb_height) {
+        int top_progress = s->mb_y ? 0 : s->mb_width;
+
+        /* the map of searched vectors is only invalidated by its generation
+         * counter, which wraps, and the penalty factors are carried over from
+         * the previous MB; start each row from the same state, whichever
+         * context it runs on */
+        memset(s->me.map, 0, ME_MAP_SIZE * sizeof(*s->me.map));
+        s->me.map_generation = 0;
+        ff_me_init_penalty_factors(s);
+
+        s->first_slice_line = !s->mb_y;
+        s->mb_x = 0; //for block init below
+        ff_init_block_index(s);
+        for (s->mb_x = 0; s->mb_x < s->mb_width; s->mb_x++) {
+            int needed = FFMIN(s->mb_x + 2, s->mb_width);
+
+            if (top_progress < needed)
+                top_progress = me_wavefront_wait(m, s->mb_y - 1, needed);
+
+            s->block_index[0] += 2;
+            s->block_index[1] += 2;
+            s->block_index[2] += 2;
+            s->block_index[3] += 2;
+
+            if (s->pict_type == AV_PICTURE_TYPE_B)
+                ff_estimate_b_frame_motion(s, s->mb_x, s->mb_y);
+            else
+                ff_estimate_p_frame_motion(s, s->mb_x, s->mb_y);
+
+            if (s->mb_x + 1 == s->mb_width || !((s->mb_x + 1) % ME_WAVEFRONT_STEP))
+                me_wavefront_report(m, s->mb_y, s->mb_x + 1);
+        }
+    }
+    s->start_mb_y = start_mb_y;
+    s->end_mb_y   = end_mb_y;
+    return 0;
+}
+
 static int mb_var_thread(AVCodecContext *c, void *arg){
     MpegEncContext *s= *(void**)arg;
     int mb_x, mb_y;
@@ -3603,7 +3728,13 @@ static int encode_picture(MpegEncContext *s, int picture_number)
             }
         }
 
-        s->avctx->execute(s->avctx, estimate_motion_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+        /* the last predictors of other rows are only safe to read in slice order */
+        if (s->me_wavefront && !s->avctx->last_predictor_count) {
+            s->me_next_row = 0;
+            memset(s->me_row_progress, 0, s->mb_height * sizeof(*s->me_row_progress));
+            s->avctx->execute2(s->avctx, estimate_motion_wavefront_thread, s, NULL, context_count);
+        } else
+            s->avctx->execute(s->avctx, estimate_motion_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
     }else /* if(s->pict_type == AV_PICTURE_TYPE_I) */{
         /* I-Frame */
         for(i=0; i<s->mb_stride*s->mb_height; i++)
@@ -497,6 +497,8 @@ static const AVOption avcodec_options[] = {
 {"bt", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = AV_FIELD_BT }, 0, 0, V|D|E, "field_order" },
 {"dump_separator", "set information dump field separator", OFFSET(dump_separator), AV_OPT_TYPE_STRING, {.str = NULL}, CHAR_MIN, CHAR_MAX, A|V|S|D|E},
 {"codec_whitelist", "List of decoders that are allowed to be used", OFFSET(codec_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  CHAR_MIN, CHAR_MAX, A|V|S|D },
+{"thread_max_delay", "maximum number of frames of delay added by frame threading", OFFSET(thread_max_delay), AV_OPT_TYPE_INT, {.i64 = -1 }, -1, INT_MAX, V|D},
+{"thread_pool_priority", "priority of the jobs on the shared thread pool", OFFSET(thread_pool_priority), AV_OPT_TYPE_INT, {.i64 = 0 }, INT_MIN, INT_MAX, V|A|E|D},
 {"pixel_format", "set pixel format", OFFSET(pix_fmt), AV_OPT_TYPE_PIXEL_FMT, {.i64=AV_PIX_FMT_NONE}, -1, INT_MAX, 0 },
 {"video_size", "set video size", OFFSET(width), AV_OPT_TYPE_IMAGE_SIZE, {.str=NULL}, 0, INT_MAX, 0 },
 {NULL},
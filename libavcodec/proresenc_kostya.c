@@ -184,14 +184,16 @@ typedef struct ProresThreadData {
     DECLARE_ALIGNED(16, uint16_t, emu_buf)[16 * 16];
     int16_t custom_q[64];
     struct TrellisNode *nodes;
+
+    // output of the slice encoding job with the same index
+    uint8_t *row_data;      ///< encoded slices of one row of macroblocks
+    int *row_slice_sizes;   ///< sizes of the slices in row_data
+    int row_size;           ///< size of row_data or a negative error code
 } ProresThreadData;
 
 typedef struct ProresContext {
     AVClass *class;
-    DECLARE_ALIGNED(16, int16_t, blocks)[MAX_PLANES][64 * 4 * MAX_MBS_PER_SLICE];
-    DECLARE_ALIGNED(16, uint16_t, emu_buf)[16*16];
     int16_t quants[MAX_STORED_Q][64];
-    int16_t custom_q[64];
     const uint8_t *quant_mat;
     const uint8_t *scantable;
 
@@ -224,6 +226,8 @@ typedef struct ProresContext {
     int *slice_q;
 
     ProresThreadData *tdata;
+    int row_data_size;      ///< worst case size of the slices of one row
+    int first_row;          ///< first row encoded by the current slice jobs
 } ProresContext;
 
 static void get_slice_data(ProresContext *ctx, const uint16_t *src,
@@ -505,7 +509,7 @@ static int encode_alpha_plane(ProresContext *ctx, PutBitContext *pb,
 }
 
 static int encode_slice(AVCodecContext *avctx, const AVFrame *pic,
-                        PutBitContext *pb,
+                        ProresThreadData *td, PutBitContext *pb,
                         int sizes[4], int x, int y, int quant,
                         int mbs_per_slice)
 {
@@ -528,7 +532,7 @@ static int encode_slice(AVCodecContext *avctx, const AVFrame *pic,
     } else if (quant < MAX_STORED_Q) {
         qmat = ctx->quants[quant];
     } else {
-        qmat = ctx->custom_q;
+        qmat = td->custom_q;
         for (i = 0; i < 64; i++)
             qmat[i] = ctx->quant_mat[i] * quant;
     }
@@ -557,18 +561,18 @@ static int encode_slice(AVCodecContext *avctx, const AVFrame *pic,
         if (i < 3) {
             get_slice_data(ctx, src, linesize, xp, yp,
                            pwidth, avctx->height / ctx->pictures_per_frame,
-                           ctx->blocks[0], ctx->emu_buf,
+                           td->blocks[0], td->emu_buf,
                            mbs_per_slice, num_cblocks, is_chroma);
             sizes[i] = encode_slice_plane(ctx, pb, src, linesize,
-                                          mbs_per_slice, ctx->blocks[0],
+                                          mbs_per_slice, td->blocks[0],
                                           num_cblocks, plane_factor,
                                           qmat);
         } else {
             get_alpha_data(ctx, src, linesize, xp, yp,
                            pwidth, avctx->height / ctx->pictures_per_frame,
-                           ctx->blocks[0], mbs_per_slice, ctx->alpha_bits);
+                           td->blocks[0], mbs_per_slice, ctx->alpha_bits);
             sizes[i] = encode_alpha_plane(ctx, pb, mbs_per_slice,
-                                          ctx->blocks[0], quant);
+                                          td->blocks[0], quant);
         }
         total_size += sizes[i];
         if (put_bits_left(pb) < 0) {
@@ -926,17 +930,60 @@ static int find_quant_thread(AVCodecContext *avctx, void *arg,
     return 0;
 }
 
+static int encode_slices_thread(AVCodecContext *avctx, void *arg,
+                                int jobnr, int threadnr)
+{
+    ProresContext *ctx = avctx->priv_data;
+    ProresThreadData *td  = ctx->tdata + threadnr;
+    ProresThreadData *out = ctx->tdata + jobnr;
+    const AVFrame *pic = arg;
+    int mbs_per_slice  = ctx->mbs_per_slice;
+    int slice_hdr_size = 2 + 2 * (ctx->num_planes - 1);
+    int sizes[4] = { 0 };
+    int x, y = ctx->first_row + jobnr, i, mb, q, ret, slice_size;
+    uint8_t *buf = out->row_data, *slice_hdr;
+    PutBitContext pb;
+
+    for (x = mb = 0; x < ctx->mb_width; x += mbs_per_slice, mb++) {
+        q = ctx->force_quant ? ctx->force_quant
+                             : ctx->slice_q[mb + y * ctx->slices_width];
+
+        while (ctx->mb_width - x < mbs_per_slice)
+            mbs_per_slice >>= 1;
+
+        bytestream_put_byte(&buf, slice_hdr_size << 3);
+        slice_hdr = buf;
+        buf += slice_hdr_size - 1;
+        init_put_bits(&pb, buf, ctx->row_data_size - (buf - out->row_data));
+        ret = encode_slice(avctx, pic, td, &pb, sizes, x, y, q,
+                           mbs_per_slice);
+        if (ret < 0) {
+            out->row_size = ret;
+            return ret;
+        }
+
+        bytestream_put_byte(&slice_hdr, q);
+        slice_size = slice_hdr_size + sizes[ctx->num_planes - 1];
+        for (i = 0; i < ctx->num_planes - 1; i++) {
+            bytestream_put_be16(&slice_hdr, sizes[i]);
+            slice_size += sizes[i];
+        }
+        out->row_slice_sizes[mb] = slice_size;
+        buf += slice_size - slice_hdr_size;
+    }
+    out->row_size = buf - out->row_data;
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pic, int *got_packet)
 {
     ProresContext *ctx = avctx->priv_data;
-    uint8_t *orig_buf, *buf, *slice_hdr, *slice_sizes, *tmp;
+    uint8_t *orig_buf, *buf, *slice_sizes, *tmp;
     uint8_t *picture_size_pos;
-    PutBitContext pb;
-    int x, y, i, mb, q = 0;
-    int sizes[4] = { 0 };
-    int slice_hdr_size = 2 + 2 * (ctx->num_planes - 1);
-    int frame_size, picture_size, slice_size;
+    int y, i, mb, nb_rows;
+    int frame_size, picture_size;
     int pkt_size, ret;
     int max_slice_size = (ctx->frame_size_upper_bound - 200) / (ctx->pictures_per_frame * ctx->slices_per_picture + 1);
     uint8_t frame_flags;
@@ -1008,19 +1055,20 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                 return ret;
         }
 
-        for (y = 0; y < ctx->mb_height; y++) {
-            int mbs_per_slice = ctx->mbs_per_slice;
-            for (x = mb = 0; x < ctx->mb_width; x += mbs_per_slice, mb++) {
-                q = ctx->force_quant ? ctx->force_quant
-                                     : ctx->slice_q[mb + y * ctx->slices_width];
+        /* encode the slices of up to thread_count rows in parallel,
+         * then append them to the packet in order */
+        for (y = 0; y < ctx->mb_height; y += nb_rows) {
+            nb_rows = FFMIN(avctx->thread_count, ctx->mb_height - y);
+            ctx->first_row = y;
+            avctx->execute2(avctx, encode_slices_thread, (void*)pic, NULL,
+                            nb_rows);
 
-                while (ctx->mb_width - x < mbs_per_slice)
-                    mbs_per_slice >>= 1;
+            for (i = 0; i < nb_rows; i++) {
+                ProresThreadData *row = ctx->tdata + i;
 
-                bytestream_put_byte(&buf, slice_hdr_size << 3);
-                slice_hdr = buf;
-                buf += slice_hdr_size - 1;
-                if (pkt_size <= buf - orig_buf + 2 * max_slice_size) {
+                if (row->row_size < 0)
+                    return row->row_size;
+                if (pkt_size <= buf - orig_buf + row->row_size + 2 * max_slice_size) {
                     uint8_t *start = pkt->data;
                     // Recompute new size according to max_slice_size
                     // and deduce delta
@@ -1028,7 +1076,7 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                                 ctx->slices_per_picture + 1) *
                                 max_slice_size - pkt_size;
 
-                    delta = FFMAX(delta, 2 * max_slice_size);
+                    delta = FFMAX(delta, row->row_size + 2 * max_slice_size);
                     ctx->frame_size_upper_bound += delta;
 
                     if (!ctx->warn) {
@@ -1050,25 +1098,15 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                     buf              = pkt->data + (buf              - start);
                     picture_size_pos = pkt->data + (picture_size_pos - start);
                     slice_sizes      = pkt->data + (slice_sizes      - start);
-                    slice_hdr        = pkt->data + (slice_hdr        - start);
                     tmp              = pkt->data + (tmp              - start);
                 }
-                init_put_bits(&pb, buf, (pkt_size - (buf - orig_buf)));
-                ret = encode_slice(avctx, pic, &pb, sizes, x, y, q,
-                                   mbs_per_slice);
-                if (ret < 0)
-                    return ret;
-
-                bytestream_put_byte(&slice_hdr, q);
-                slice_size = slice_hdr_size + sizes[ctx->num_planes - 1];
-                for (i = 0; i < ctx->num_planes - 1; i++) {
-                    bytestream_put_be16(&slice_hdr, sizes[i]);
-                    slice_size += sizes[i];
+                memcpy(buf, row->row_data, row->row_size);
+                buf += row->row_size;
+                for (mb = 0; mb < ctx->slices_width; mb++) {
+                    bytestream_put_be16(&slice_sizes, row->row_slice_sizes[mb]);
+                    if (max_slice_size < row->row_slice_sizes[mb])
+                        max_slice_size = row->row_slice_sizes[mb];
                 }
-                bytestream_put_be16(&slice_sizes, slice_size);
-                buf += slice_size - slice_hdr_size;
-                if (max_slice_size < slice_size)
-                    max_slice_size = slice_size;
             }
         }
 
@@ -1093,8 +1131,11 @@ static av_cold int encode_close(AVCodecContext *avctx)
     int i;
 
     if (ctx->tdata) {
-        for (i = 0; i < avctx->thread_count; i++)
+        for (i = 0; i < avctx->thread_count; i++) {
             av_freep(&ctx->tdata[i].nodes);
+            av_freep(&ctx->tdata[i].row_data);
+            av_freep(&ctx->tdata[i].row_slice_sizes);
+        }
     }
     av_freep(&ctx->tdata);
     av_freep(&ctx->slice_q);
@@ -1197,6 +1238,28 @@ FF_ENABLE_DEPRECATION_WARNINGS
         return AVERROR_INVALIDDATA;
     }
 
+    ctx->tdata = av_mallocz_array(avctx->thread_count, sizeof(*ctx->tdata));
+    if (!ctx->tdata)
+        return AVERROR(ENOMEM);
+
+    /* Each coefficient takes at most a run, a level codeword and a sign,
+     * which fits into 9 bytes; add the alpha runs, slice headers and the
+     * padding of each plane. */
+    ctx->row_data_size = ctx->mb_width * (4 + (ctx->chroma_factor == CFACTOR_Y444 ? 8 : 4)) * 64 * 9 +
+                         ctx->slices_width * (2 + 2 * ctx->num_planes + 4 * MAX_PLANES);
+    if (ctx->alpha_bits)
+        ctx->row_data_size += ctx->mb_width * 256 * (ctx->alpha_bits + 2) / 8 +
+                              ctx->slices_width * 16;
+    for (j = 0; j < avctx->thread_count; j++) {
+        ctx->tdata[j].row_data        = av_malloc(ctx->row_data_size);
+        ctx->tdata[j].row_slice_sizes = av_malloc_array(ctx->slices_width,
+                                                        sizeof(*ctx->tdata[j].row_slice_sizes));
+        if (!ctx->tdata[j].row_data || !ctx->tdata[j].row_slice_sizes) {
+            encode_close(avctx);
+            return AVERROR(ENOMEM);
+        }
+    }
+
     ctx->force_quant = avctx->global_quality / FF_QP2LAMBDA;
     if (!ctx->force_quant) {
         if (!ctx->bits_per_mb) {
@@ -1223,12 +1286,6 @@ FF_ENABLE_DEPRECATION_WARNINGS
             return AVERROR(ENOMEM);
         }
 
-        ctx->tdata = av_mallocz(avctx->thread_count * sizeof(*ctx->tdata));
-        if (!ctx->tdata) {
-            encode_close(avctx);
-            return AVERROR(ENOMEM);
-        }
-
         for (j = 0; j < avctx->thread_count; j++) {
             ctx->tdata[j].nodes = av_malloc((ctx->slices_width + 1)
                                             * TRELLIS_WIDTH
@@ -49,6 +49,7 @@
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/time.h"
 
 /**
  * Context used by codec threads and stored in their AVCodecInternal thread_ctx.
@@ -120,6 +121,13 @@ typedef struct FrameThreadContext {
                                     */
 
     int die;                       ///< Set when threads should exit.
+
+    /**
+     * Time spent copying the context of a thread to the next one, in
+     * microseconds, and number of copies. Only measured with FF_DEBUG_THREADS.
+     */
+    int64_t update_time;
+    int     nb_updates;
 } FrameThreadContext;
 
 #define THREAD_SAFE_CALLBACKS(avctx) \
@@ -236,7 +244,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     }
 
     if (for_user) {
-        dst->delay       = src->thread_count - 1;
+        dst->delay       = dst->thread_count - 1;
 #if FF_API_CODED_FRAME
 FF_DISABLE_DEPRECATION_WARNINGS
         dst->coded_frame = src->coded_frame;
@@ -336,7 +344,15 @@ static int submit_packet(PerThreadContext *p, AVPacket *avpkt)
             pthread_mutex_unlock(&prev_thread->progress_mutex);
         }
 
-        err = update_context_from_thread(p->avctx, prev_thread->avctx, 0);
+        if (p->avctx->debug & FF_DEBUG_THREADS) {
+            int64_t t = av_gettime_relative();
+            err = update_context_from_thread(p->avctx, prev_thread->avctx, 0);
+            t = av_gettime_relative() - t;
+            fctx->update_time += t;
+            fctx->nb_updates++;
+            av_log(p->avctx, AV_LOG_DEBUG, "context update took %"PRId64" us\n", t);
+        } else
+            err = update_context_from_thread(p->avctx, prev_thread->avctx, 0);
         if (err) {
             pthread_mutex_unlock(&p->mutex);
             return err;
@@ -488,7 +504,9 @@ void ff_thread_report_progress(ThreadFrame *f, int n, int field)
         av_log(f->owner, AV_LOG_DEBUG, "%p finished %d field %d\n", progress, n, field);
 
     pthread_mutex_lock(&p->progress_mutex);
-    progress[field] = n;
+    /* with slice threading, a lower value may be reported after a higher one */
+    if (progress[field] < n)
+        progress[field] = n;
     pthread_cond_broadcast(&p->progress_cond);
     pthread_mutex_unlock(&p->progress_mutex);
 }
@@ -559,6 +577,12 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
             fctx->threads->avctx->internal->is_copy = 1;
         }
 
+    if (fctx->nb_updates)
+        av_log(avctx, AV_LOG_DEBUG,
+               "%d context updates, %"PRId64" us in total, %.1f us on average\n",
+               fctx->nb_updates, fctx->update_time,
+               fctx->update_time / (double)fctx->nb_updates);
+
     fctx->die = 1;
 
     for (i = 0; i < thread_count; i++) {
@@ -575,6 +599,9 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
         if (codec->close && p->avctx)
             codec->close(p->avctx);
 
+        if (p->avctx && p->avctx->internal && p->avctx->internal->slice_thread_ctx)
+            ff_slice_thread_free(p->avctx);
+
         release_delayed_buffers(p);
         av_frame_free(&p->frame);
     }
@@ -609,12 +636,25 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
     avctx->codec = NULL;
 }
 
+/**
+ * Set up slice threading inside a frame thread.
+ */
+static int init_slice_threads(AVCodecContext *copy, int slice_threads)
+{
+    if (slice_threads <= 1)
+        return 0;
+
+    copy->thread_count = slice_threads;
+    return ff_slice_thread_init(copy) < 0 ? AVERROR(ENOMEM) : 0;
+}
+
 int ff_frame_thread_init(AVCodecContext *avctx)
 {
     int thread_count = avctx->thread_count;
     const AVCodec *codec = avctx->codec;
     AVCodecContext *src = avctx;
     FrameThreadContext *fctx;
+    int slice_threads = 1;
     int i, err = 0;
 
 #if HAVE_W32THREADS
@@ -632,11 +672,24 @@ int ff_frame_thread_init(AVCodecContext *avctx)
             thread_count = avctx->thread_count = 1;
     }
 
+    if (avctx->thread_max_delay >= 0 && thread_count > avctx->thread_max_delay + 1) {
+        int frame_threads = avctx->thread_max_delay + 1;
+
+        if (codec->caps_internal & FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS &&
+            codec->capabilities & AV_CODEC_CAP_SLICE_THREADS &&
+            avctx->thread_type & FF_THREAD_SLICE)
+            slice_threads = thread_count / frame_threads;
+        thread_count = avctx->thread_count = frame_threads;
+    }
+
     if (thread_count <= 1) {
         avctx->active_thread_type = 0;
         return 0;
     }
 
+    if (slice_threads > 1)
+        avctx->active_thread_type |= FF_THREAD_SLICE;
+
     avctx->internal->thread_ctx = fctx = av_mallocz(sizeof(FrameThreadContext));
     if (!fctx)
         return AVERROR(ENOMEM);
@@ -685,12 +738,14 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         }
         *copy->internal = *src->internal;
         copy->internal->thread_ctx = p;
+        copy->internal->slice_thread_ctx = NULL;
         copy->internal->pkt = &p->avpkt;
 
         if (!i) {
             src = copy;
 
-            if (codec->init)
+            err = init_slice_threads(copy, slice_threads);
+            if (!err && codec->init)
                 err = codec->init(copy);
 
             update_context_from_thread(avctx, copy, 1);
@@ -703,7 +758,8 @@ int ff_frame_thread_init(AVCodecContext *avctx)
             memcpy(copy->priv_data, src->priv_data, codec->priv_data_size);
             copy->internal->is_copy = 1;
 
-            if (codec->init_thread_copy)
+            err = init_slice_threads(copy, slice_threads);
+            if (!err && codec->init_thread_copy)
                 err = codec->init_thread_copy(copy);
         }
 
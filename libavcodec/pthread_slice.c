@@ -37,15 +37,30 @@
 #include "pthread_internal.h"
 #include "thread.h"
 
+#include "libavutil/atomic.h"
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
+#include "libavutil/threadpool.h"
 
 typedef int (action_func)(AVCodecContext *c, void *arg);
 typedef int (action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
 
-typedef struct SliceThreadContext {
-    pthread_t *workers;
+/* number of times an idle thread polls for work before going to sleep */
+#define SPIN_COUNT 2000
+
+typedef struct WorkerContext {
+    AVCodecContext *avctx;
+    pthread_t thread;
+    int self_id;
+} WorkerContext;
+
+/**
+ * Parameters of one execute() call. They are written by the caller and
+ * copied by the workers with the lock held, so that a worker never sees
+ * the parameters of one call together with the number of another.
+ */
+typedef struct ExecuteContext {
     action_func *func;
     action_func2 *func2;
     void *args;
@@ -53,12 +68,22 @@ typedef struct SliceThreadContext {
     int rets_count;
     int job_count;
     int job_size;
+} ExecuteContext;
 
-    pthread_cond_t last_job_cond;
-    pthread_cond_t current_job_cond;
-    pthread_mutex_t current_job_lock;
-    unsigned current_execute;
-    int current_job;
+typedef struct SliceThreadContext {
+    WorkerContext *workers;
+    int nb_workers;
+    ExecuteContext exec;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    volatile int current_execute;
+    volatile int current_job;   ///< next job to hand out after the first round
+    volatile int nb_active;     ///< workers that have not finished the current execute
+    int nb_sleeping;            ///< workers waiting on work_cond
+    int caller_sleeping;
+    int spin_count;
     int done;
 
     int *entries;
@@ -66,121 +91,205 @@ typedef struct SliceThreadContext {
     int thread_count;
     pthread_cond_t *progress_cond;
     pthread_mutex_t *progress_mutex;
+
+    AVThreadPool *pool;
 } SliceThreadContext;
 
+typedef struct PoolJobContext {
+    AVCodecContext *avctx;
+    action_func *func;
+    action_func2 *func2;
+    void *args;
+    int job_size;
+} PoolJobContext;
+
+static av_always_inline void run_job(AVCodecContext *avctx, const ExecuteContext *e,
+                                     int jobnr, int threadnr)
+{
+    e->rets[jobnr % e->rets_count] = e->func ? e->func(avctx, (char*)e->args + jobnr*e->job_size) :
+                                               e->func2(avctx, e->args, jobnr, threadnr);
+}
+
+/**
+ * Run job self_id, then take jobs from the shared counter until none is left.
+ * Job i always starts on thread i, the calling thread being thread 0.
+ */
+static void run_jobs(AVCodecContext *avctx, SliceThreadContext *c,
+                     const ExecuteContext *e, int self_id)
+{
+    int jobnr;
+
+    run_job(avctx, e, self_id, self_id);
+    while ((jobnr = avpriv_atomic_int_add_and_fetch(&c->current_job, 1) - 1) < e->job_count)
+        run_job(avctx, e, jobnr, self_id);
+}
+
 static void* attribute_align_arg worker(void *v)
 {
-    AVCodecContext *avctx = v;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
-    unsigned last_execute = 0;
-    int our_job = c->job_count;
-    int thread_count = avctx->thread_count;
-    int self_id;
+    WorkerContext *w      = v;
+    AVCodecContext *avctx = w->avctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+    ExecuteContext e;
+    int last_execute = 0;
+    int i;
 
-    pthread_mutex_lock(&c->current_job_lock);
-    self_id = c->current_job++;
-    for (;;){
-        while (our_job >= c->job_count) {
-            if (c->current_job == thread_count + c->job_count)
-                pthread_cond_signal(&c->last_job_cond);
-
-            while (last_execute == c->current_execute && !c->done)
-                pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
-            last_execute = c->current_execute;
-            our_job = self_id;
-
-            if (c->done) {
-                pthread_mutex_unlock(&c->current_job_lock);
-                return NULL;
+    for (;;) {
+        /* poll for a while so that back to back calls do not need a wakeup */
+        for (i = 0; i < c->spin_count; i++)
+            if (avpriv_atomic_int_get(&c->current_execute) != last_execute)
+                break;
+
+        /* a call this thread takes no part in is skipped, the caller
+         * does not wait for it and may start the next one meanwhile */
+        pthread_mutex_lock(&c->lock);
+        while (!c->done) {
+            if (c->current_execute != last_execute) {
+                last_execute = c->current_execute;
+                e            = c->exec;
+                if (w->self_id < e.job_count)
+                    break;
             }
+            c->nb_sleeping++;
+            pthread_cond_wait(&c->work_cond, &c->lock);
+            c->nb_sleeping--;
         }
-        pthread_mutex_unlock(&c->current_job_lock);
+        pthread_mutex_unlock(&c->lock);
+        if (c->done)
+            return NULL;
 
-        c->rets[our_job%c->rets_count] = c->func ? c->func(avctx, (char*)c->args + our_job*c->job_size):
-                                                   c->func2(avctx, c->args, our_job, self_id);
+        run_jobs(avctx, c, &e, w->self_id);
 
-        pthread_mutex_lock(&c->current_job_lock);
-        our_job = c->current_job++;
+        if (!avpriv_atomic_int_add_and_fetch(&c->nb_active, -1)) {
+            pthread_mutex_lock(&c->lock);
+            if (c->caller_sleeping)
+                pthread_cond_signal(&c->done_cond);
+            pthread_mutex_unlock(&c->lock);
+        }
     }
 }
 
-void ff_slice_thread_free(AVCodecContext *avctx)
+static void stop_workers(SliceThreadContext *c)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
     int i;
 
-    pthread_mutex_lock(&c->current_job_lock);
+    pthread_mutex_lock(&c->lock);
     c->done = 1;
-    pthread_cond_broadcast(&c->current_job_cond);
+    pthread_cond_broadcast(&c->work_cond);
     for (i = 0; i < c->thread_count; i++)
         pthread_cond_broadcast(&c->progress_cond[i]);
-    pthread_mutex_unlock(&c->current_job_lock);
+    pthread_mutex_unlock(&c->lock);
+
+    for (i = 0; i < c->nb_workers; i++)
+        pthread_join(c->workers[i].thread, NULL);
+}
+
+void ff_slice_thread_free(AVCodecContext *avctx)
+{
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+    int i;
 
-    for (i=0; i<avctx->thread_count; i++)
-         pthread_join(c->workers[i], NULL);
+    if (!c->pool)
+        stop_workers(c);
 
     for (i = 0; i < c->thread_count; i++) {
         pthread_mutex_destroy(&c->progress_mutex[i]);
         pthread_cond_destroy(&c->progress_cond[i]);
     }
 
-    pthread_mutex_destroy(&c->current_job_lock);
-    pthread_cond_destroy(&c->current_job_cond);
-    pthread_cond_destroy(&c->last_job_cond);
+    if (!c->pool) {
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->work_cond);
+        pthread_cond_destroy(&c->done_cond);
+    }
 
     av_freep(&c->entries);
     av_freep(&c->progress_mutex);
     av_freep(&c->progress_cond);
 
     av_freep(&c->workers);
-    av_freep(&avctx->internal->thread_ctx);
+    av_freep(&avctx->internal->slice_thread_ctx);
 }
 
-static av_always_inline void thread_park_workers(SliceThreadContext *c, int thread_count)
+static int pool_job(void *opaque, int jobnr, int threadnr)
 {
-    while (c->current_job != thread_count + c->job_count)
-        pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
-    pthread_mutex_unlock(&c->current_job_lock);
+    PoolJobContext *p = opaque;
+
+    return p->func ? p->func(p->avctx, (char*)p->args + jobnr*p->job_size) :
+                     p->func2(p->avctx, p->args, jobnr, threadnr);
 }
 
-static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+static int pool_execute(AVCodecContext *avctx, action_func *func, action_func2 *func2,
+                        void *arg, int *ret, int job_count, int job_size)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
-    int dummy_ret;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+    PoolJobContext p = { avctx, func, func2, arg, job_size };
 
-    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
-        return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
+    return av_thread_pool_execute(c->pool, pool_job, &p, ret, job_count,
+                                  avctx->thread_count, avctx->thread_pool_priority);
+}
+
+static int thread_execute_internal(AVCodecContext *avctx, action_func *func, action_func2 *func2,
+                                   void *arg, int *ret, int job_count, int job_size)
+{
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+    int nb_active = FFMIN(job_count, avctx->thread_count) - 1;
+    int dummy_ret, i;
 
     if (job_count <= 0)
         return 0;
 
-    pthread_mutex_lock(&c->current_job_lock);
+    if (c->pool)
+        return pool_execute(avctx, func, func2, arg, ret, job_count, job_size);
 
-    c->current_job = avctx->thread_count;
-    c->job_count = job_count;
-    c->job_size = job_size;
-    c->args = arg;
-    c->func = func;
+    pthread_mutex_lock(&c->lock);
+    c->exec.func      = func;
+    c->exec.func2     = func2;
+    c->exec.args      = arg;
+    c->exec.job_count = job_count;
+    c->exec.job_size  = job_size;
     if (ret) {
-        c->rets = ret;
-        c->rets_count = job_count;
+        c->exec.rets       = ret;
+        c->exec.rets_count = job_count;
     } else {
-        c->rets = &dummy_ret;
-        c->rets_count = 1;
+        c->exec.rets       = &dummy_ret;
+        c->exec.rets_count = 1;
+    }
+    avpriv_atomic_int_set(&c->current_job, avctx->thread_count);
+    avpriv_atomic_int_set(&c->nb_active, nb_active);
+    avpriv_atomic_int_set(&c->current_execute, c->current_execute + 1);
+    if (c->nb_sleeping)
+        pthread_cond_broadcast(&c->work_cond);
+    pthread_mutex_unlock(&c->lock);
+
+    run_jobs(avctx, c, &c->exec, 0);
+
+    for (i = 0; i < c->spin_count && avpriv_atomic_int_get(&c->nb_active); i++);
+    if (avpriv_atomic_int_get(&c->nb_active)) {
+        pthread_mutex_lock(&c->lock);
+        c->caller_sleeping = 1;
+        while (avpriv_atomic_int_get(&c->nb_active))
+            pthread_cond_wait(&c->done_cond, &c->lock);
+        c->caller_sleeping = 0;
+        pthread_mutex_unlock(&c->lock);
     }
-    c->current_execute++;
-    pthread_cond_broadcast(&c->current_job_cond);
-
-    thread_park_workers(c, avctx->thread_count);
 
     return 0;
 }
 
+static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+{
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+        return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
+
+    return thread_execute_internal(avctx, func, NULL, arg, ret, job_count, job_size);
+}
+
 static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
-    c->func2 = func2;
-    return thread_execute(avctx, NULL, arg, ret, job_count, 0);
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+        return avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+
+    return thread_execute_internal(avctx, NULL, func2, arg, ret, job_count, 0);
 }
 
 int ff_slice_thread_init(AVCodecContext *avctx)
@@ -213,32 +322,41 @@ int ff_slice_thread_init(AVCodecContext *avctx)
     if (!c)
         return -1;
 
-    c->workers = av_mallocz_array(thread_count, sizeof(pthread_t));
+    if (avctx->thread_pool) {
+        c->pool = avctx->thread_pool;
+        avctx->thread_count = FFMIN(thread_count, AV_THREAD_POOL_MAX_CONCURRENCY);
+        avctx->internal->slice_thread_ctx = c;
+        avctx->execute = thread_execute;
+        avctx->execute2 = thread_execute2;
+        return 0;
+    }
+
+    /* the calling thread runs the jobs of thread 0 */
+    c->workers = av_mallocz_array(thread_count - 1, sizeof(*c->workers));
     if (!c->workers) {
         av_free(c);
         return -1;
     }
 
-    avctx->internal->thread_ctx = c;
-    c->current_job = 0;
-    c->job_count = 0;
-    c->job_size = 0;
-    c->done = 0;
-    pthread_cond_init(&c->current_job_cond, NULL);
-    pthread_cond_init(&c->last_job_cond, NULL);
-    pthread_mutex_init(&c->current_job_lock, NULL);
-    pthread_mutex_lock(&c->current_job_lock);
-    for (i=0; i<thread_count; i++) {
-        if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
-           avctx->thread_count = i;
-           pthread_mutex_unlock(&c->current_job_lock);
-           ff_thread_free(avctx);
-           return -1;
+    /* polling only helps if another core can make progress meanwhile */
+    c->spin_count = av_cpu_count() > 1 ? SPIN_COUNT : 0;
+
+    avctx->internal->slice_thread_ctx = c;
+    pthread_cond_init(&c->work_cond, NULL);
+    pthread_cond_init(&c->done_cond, NULL);
+    pthread_mutex_init(&c->lock, NULL);
+    for (i = 0; i < thread_count - 1; i++) {
+        WorkerContext *w = &c->workers[i];
+
+        w->avctx   = avctx;
+        w->self_id = i + 1;
+        if (pthread_create(&w->thread, NULL, worker, w)) {
+            ff_slice_thread_free(avctx);
+            return -1;
         }
+        c->nb_workers = i + 1;
     }
 
-    thread_park_workers(c, thread_count);
-
     avctx->execute = thread_execute;
     avctx->execute2 = thread_execute2;
     return 0;
@@ -246,9 +364,19 @@ int ff_slice_thread_init(AVCodecContext *avctx)
 
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     int *entries = p->entries;
 
+    /* the jobs of a pool do not run on the thread matching their index,
+     * so all of them share the first mutex and condition */
+    if (p->pool) {
+        pthread_mutex_lock(&p->progress_mutex[0]);
+        entries[field] += n;
+        pthread_cond_broadcast(&p->progress_cond[0]);
+        pthread_mutex_unlock(&p->progress_mutex[0]);
+        return;
+    }
+
     pthread_mutex_lock(&p->progress_mutex[thread]);
     entries[field] +=n;
     pthread_cond_signal(&p->progress_cond[thread]);
@@ -257,12 +385,15 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
 void ff_thread_await_progress2(AVCodecContext *avctx, int field, int thread, int shift)
 {
-    SliceThreadContext *p  = avctx->internal->thread_ctx;
+    SliceThreadContext *p  = avctx->internal->slice_thread_ctx;
     int *entries      = p->entries;
 
     if (!entries || !field) return;
 
-    thread = thread ? thread - 1 : p->thread_count - 1;
+    if (p->pool)
+        thread = 0;
+    else
+        thread = thread ? thread - 1 : p->thread_count - 1;
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
     while ((entries[field - 1] - entries[field]) < shift){
@@ -276,7 +407,7 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
     int i;
 
     if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        SliceThreadContext *p = avctx->internal->thread_ctx;
+        SliceThreadContext *p = avctx->internal->slice_thread_ctx;
         p->thread_count  = avctx->thread_count;
         p->entries       = av_mallocz_array(count, sizeof(int));
 
@@ -302,6 +433,123 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 
 void ff_reset_entries(AVCodecContext *avctx)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     memset(p->entries, 0, p->entries_count * sizeof(int));
 }
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#include "libavutil/time.h"
+
+static int bench_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    int *sum = arg;
+    sum[jobnr] += jobnr;
+    return 0;
+}
+
+static int count_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    volatile int *runs = arg;
+    avpriv_atomic_int_add_and_fetch(&runs[jobnr], 1);
+    return jobnr;
+}
+
+static AVCodecContext *alloc_context(int thread_count)
+{
+    AVCodecContext *avctx = avcodec_alloc_context3(NULL);
+
+    if (!avctx || !(avctx->internal = av_mallocz(sizeof(*avctx->internal))))
+        return NULL;
+    avctx->thread_count       = thread_count;
+    avctx->active_thread_type = FF_THREAD_SLICE;
+    if (ff_slice_thread_init(avctx) < 0)
+        return NULL;
+    return avctx;
+}
+
+static void free_context(AVCodecContext *avctx)
+{
+    ff_slice_thread_free(avctx);
+    av_freep(&avctx->internal);
+    avcodec_free_context(&avctx);
+}
+
+/* alternate small and large job counts, so that the workers left out of
+ * one call run concurrently with the setup of the next one */
+static int check_job_counts(int thread_count, int iterations)
+{
+    static volatile int runs[64 * 4];
+    static int rets[64 * 4];
+    AVCodecContext *avctx = alloc_context(thread_count);
+    int i, j;
+
+    if (!avctx)
+        return 1;
+
+    for (i = 0; i < iterations; i++) {
+        int job_count = i & 1 ? thread_count * 4 : 2;
+
+        memset((int *)runs, 0, sizeof(runs));
+        memset(rets, -1, sizeof(rets));
+        avctx->execute2(avctx, count_job, (void *)runs, rets, job_count);
+        for (j = 0; j < FF_ARRAY_ELEMS(runs); j++) {
+            if (runs[j] != (j < job_count) ||
+                rets[j] != (j < job_count ? j : -1)) {
+                fprintf(stderr, "threads %d jobs %d: job %d was run %d times\n",
+                        thread_count, job_count, j, runs[j]);
+                return 1;
+            }
+        }
+    }
+
+    free_context(avctx);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int thread_counts[] = { 4, 8, 16, 32, 64 };
+    static int sum[64 * 4];
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    int i, j, k;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(thread_counts); i++)
+        if (check_job_counts(thread_counts[i], iterations / 10))
+            return 1;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(thread_counts); i++) {
+        for (j = 1; j <= 4; j *= 4) {
+            AVCodecContext *avctx = alloc_context(thread_counts[i]);
+            int job_count = thread_counts[i] * j;
+            int64_t t;
+
+            if (!avctx)
+                return 1;
+
+            memset(sum, 0, sizeof(sum));
+            t = av_gettime_relative();
+            for (k = 0; k < iterations; k++)
+                avctx->execute2(avctx, bench_job, sum, NULL, job_count);
+            t = av_gettime_relative() - t;
+
+            for (k = 0; k < job_count; k++) {
+                if (sum[k] != k * iterations) {
+                    fprintf(stderr, "job %d was not run %d times\n", k, iterations);
+                    return 1;
+                }
+            }
+
+            printf("threads %2d jobs %3d: %8.2f us/call\n",
+                   thread_counts[i], job_count, (double)t / iterations);
+
+            free_context(avctx);
+        }
+    }
+
+    return 0;
+}
+
+#endif /* TEST */
@@ -1101,6 +1101,7 @@ MAKE_ACCESSORS(AVCodecContext, codec, const AVCodecDescriptor *, codec_descripto
 MAKE_ACCESSORS(AVCodecContext, codec, int, lowres)
 MAKE_ACCESSORS(AVCodecContext, codec, int, seek_preroll)
 MAKE_ACCESSORS(AVCodecContext, codec, uint16_t*, chroma_intra_matrix)
+MAKE_ACCESSORS(AVCodecContext, codec, AVThreadPool *, thread_pool)
 
 unsigned av_codec_get_codec_properties(const AVCodecContext *codec)
 {
@@ -2505,7 +2506,7 @@ av_cold int avcodec_close(AVCodecContext *avctx)
             avctx->internal->frame_thread_encoder && avctx->thread_count > 1) {
             ff_frame_thread_encoder_free(avctx);
         }
-        if (HAVE_THREADS && avctx->internal->thread_ctx)
+        if (HAVE_THREADS && (avctx->internal->thread_ctx || avctx->internal->slice_thread_ctx))
             ff_thread_free(avctx);
         if (avctx->codec && avctx->codec->close)
             avctx->codec->close(avctx);
@@ -64,6 +64,12 @@ extern const int ff_ut_pred_order[5];
 /* Order of RGB(A) planes in Ut Video */
 extern const int ff_ut_rgb_order[4];
 
+typedef struct HuffEntry {
+    uint8_t  sym;
+    uint8_t  len;
+    uint32_t code;
+} HuffEntry;
+
 typedef struct UtvideoContext {
     AVCodecContext *avctx;
     BswapDSPContext bdsp;
@@ -79,13 +85,16 @@ typedef struct UtvideoContext {
     int      slice_stride;
     uint8_t *slice_bits, *slice_buffer[4];
     int      slice_bits_size;
-} UtvideoContext;
 
-typedef struct HuffEntry {
-    uint8_t  sym;
-    uint8_t  len;
-    uint32_t code;
-} HuffEntry;
+    /* encoder state of each plane, shared with the slice threads */
+    uint8_t *plane_src[4];
+    int      plane_stride[4];
+    int      plane_width[4], plane_height[4];
+    int      single_symbol[4];          ///< the only symbol used or -1
+    HuffEntry he[4][256];
+    uint32_t slice_size[4][256];        ///< coded size of each slice in bytes
+    uint8_t *slice_dst[4][256];         ///< position of each slice in the packet
+} UtvideoContext;
 
 /* Compare huffman tree nodes */
 int ff_ut_huff_cmp_len(const void *a, const void *b);
@@ -48,7 +48,6 @@ static av_cold int utvideo_encode_close(AVCodecContext *avctx)
     UtvideoContext *c = avctx->priv_data;
     int i;
 
-    av_freep(&c->slice_bits);
     for (i = 0; i < 4; i++)
         av_freep(&c->slice_buffer[i]);
 
@@ -379,19 +378,22 @@ static int write_huff_codes(uint8_t *src, uint8_t *dst, int dst_size,
     return count;
 }
 
-static int encode_plane(AVCodecContext *avctx, uint8_t *src,
-                        uint8_t *dst, int stride, int plane_no,
-                        int width, int height, PutByteContext *pb)
+/* Predict a plane, then build its huffman table and the size of each slice */
+static int prepare_plane(AVCodecContext *avctx, void *arg, int plane_no,
+                         int threadnr)
 {
-    UtvideoContext *c        = avctx->priv_data;
+    UtvideoContext *c    = avctx->priv_data;
+    uint8_t *src         = c->plane_src[plane_no];
+    uint8_t *dst         = c->slice_buffer[plane_no];
+    int stride           = c->plane_stride[plane_no];
+    int width            = c->plane_width[plane_no];
+    int height           = c->plane_height[plane_no];
+    HuffEntry *he        = c->he[plane_no];
     uint8_t  lengths[256];
-    uint64_t counts[256]     = { 0 };
+    uint64_t counts[256] = { 0 };
 
-    HuffEntry he[256];
-
-    uint32_t offset = 0, slice_len = 0;
-    const int cmask = ~(!plane_no && avctx->pix_fmt == AV_PIX_FMT_YUV420P);
-    int      i, sstart, send = 0;
+    const int cmask = !plane_no && avctx->pix_fmt == AV_PIX_FMT_YUV420P ? ~1 : ~0;
+    int      i, j, sstart, send = 0;
     int      symbol;
     int      ret;
 
@@ -432,27 +434,12 @@ static int encode_plane(AVCodecContext *avctx, uint8_t *src,
     count_usage(dst, width, height, counts);
 
     /* Check for a special case where only one symbol was used */
+    c->single_symbol[plane_no] = -1;
     for (symbol = 0; symbol < 256; symbol++) {
         /* If non-zero count is found, see if it matches width * height */
         if (counts[symbol]) {
-            /* Special case if only one symbol was used */
             if (counts[symbol] == width * (int64_t)height) {
-                /*
-                 * Write a zero for the single symbol
-                 * used in the plane, else 0xFF.
-                 */
-                for (i = 0; i < 256; i++) {
-                    if (i == symbol)
-                        bytestream2_put_byte(pb, 0);
-                    else
-                        bytestream2_put_byte(pb, 0xFF);
-                }
-
-                /* Write zeroes for lengths */
-                for (i = 0; i < c->slices; i++)
-                    bytestream2_put_le32(pb, 0);
-
-                /* And that's all for that plane folks */
+                c->single_symbol[plane_no] = symbol;
                 return 0;
             }
             break;
@@ -463,14 +450,7 @@ static int encode_plane(AVCodecContext *avctx, uint8_t *src,
     if ((ret = ff_huff_gen_len_table(lengths, counts, 256, 1)) < 0)
         return ret;
 
-    /*
-     * Write the plane's header into the output packet:
-     * - huffman code lengths (256 bytes)
-     * - slice end offsets (gotten from the slice lengths)
-     */
     for (i = 0; i < 256; i++) {
-        bytestream2_put_byte(pb, lengths[i]);
-
         he[i].len = lengths[i];
         he[i].sym = i;
     }
@@ -478,45 +458,98 @@ static int encode_plane(AVCodecContext *avctx, uint8_t *src,
     /* Calculate the huffman codes themselves */
     calculate_codes(he);
 
+    /* Size of each slice, padded to a 32bit boundary */
     send = 0;
     for (i = 0; i < c->slices; i++) {
-        sstart  = send;
-        send    = height * (i + 1) / c->slices & cmask;
+        uint64_t bits = 0;
 
-        /*
-         * Write the huffman codes to a buffer,
-         * get the offset in bits and convert to bytes.
-         */
-        offset += write_huff_codes(dst + sstart * width, c->slice_bits,
-                                   width * height + 4, width,
-                                   send - sstart, he) >> 3;
+        sstart = send;
+        send   = height * (i + 1) / c->slices & cmask;
+        for (j = sstart * width; j < send * width; j++)
+            bits += he[dst[j]].len;
+        c->slice_size[plane_no][i] = FFALIGN(bits, 32) >> 3;
+    }
 
-        slice_len = offset - slice_len;
+    return 0;
+}
 
-        /* Byteswap the written huffman codes */
-        c->bdsp.bswap_buf((uint32_t *) c->slice_bits,
-                          (uint32_t *) c->slice_bits,
-                          slice_len >> 2);
+/* Write the huffman codes of one slice of one plane into the packet */
+static int encode_slice(AVCodecContext *avctx, void *arg, int jobnr,
+                        int threadnr)
+{
+    UtvideoContext *c = avctx->priv_data;
+    int plane_no      = jobnr / c->slices;
+    int slice         = jobnr % c->slices;
+    int width         = c->plane_width[plane_no];
+    int height        = c->plane_height[plane_no];
+    const int cmask   = !plane_no && avctx->pix_fmt == AV_PIX_FMT_YUV420P ? ~1 : ~0;
+    int sstart        = height *  slice      / c->slices & cmask;
+    int send          = height * (slice + 1) / c->slices & cmask;
+    uint8_t *dst      = c->slice_dst[plane_no][slice];
+    uint32_t size     = c->slice_size[plane_no][slice];
 
-        /* Write the offset to the stream */
-        bytestream2_put_le32(pb, offset);
+    if (c->single_symbol[plane_no] >= 0)
+        return 0;
+
+    write_huff_codes(c->slice_buffer[plane_no] + sstart * width, dst, size,
+                     width, send - sstart, c->he[plane_no]);
+
+    /* Byteswap the written huffman codes */
+    c->bdsp.bswap_buf((uint32_t *) dst, (uint32_t *) dst, size >> 2);
+
+    return 0;
+}
 
-        /* Seek to the data part of the packet */
-        bytestream2_seek_p(pb, 4 * (c->slices - i - 1) +
-                           offset - slice_len, SEEK_CUR);
+/*
+ * Write the plane's header into the output packet:
+ * - huffman code lengths (256 bytes)
+ * - slice end offsets (gotten from the slice lengths)
+ * and reserve the space for the slices' data.
+ */
+static int write_plane_header(UtvideoContext *c, int plane_no,
+                              PutByteContext *pb)
+{
+    uint32_t offset = 0;
+    uint8_t *data;
+    int i;
 
-        /* Write the slices' data into the output packet */
-        bytestream2_put_buffer(pb, c->slice_bits, slice_len);
+    if (c->single_symbol[plane_no] >= 0) {
+        /*
+         * Write a zero for the single symbol
+         * used in the plane, else 0xFF.
+         */
+        for (i = 0; i < 256; i++) {
+            if (i == c->single_symbol[plane_no])
+                bytestream2_put_byte(pb, 0);
+            else
+                bytestream2_put_byte(pb, 0xFF);
+        }
 
-        /* Seek back to the slice offsets */
-        bytestream2_seek_p(pb, -4 * (c->slices - i - 1) - offset,
-                           SEEK_CUR);
+        /* Write zeroes for lengths */
+        for (i = 0; i < c->slices; i++)
+            bytestream2_put_le32(pb, 0);
 
-        slice_len = offset;
+        /* And that's all for that plane folks */
+        return 0;
     }
 
-    /* And at the end seek to the end of written slice(s) */
-    bytestream2_seek_p(pb, offset, SEEK_CUR);
+    for (i = 0; i < 256; i++)
+        bytestream2_put_byte(pb, c->he[plane_no][i].len);
+
+    for (i = 0; i < c->slices; i++) {
+        offset += c->slice_size[plane_no][i];
+        bytestream2_put_le32(pb, offset);
+    }
+
+    if (offset > bytestream2_get_bytes_left_p(pb))
+        return AVERROR_BUG;
+
+    data = pb->buffer;
+    for (i = 0; i < c->slices; i++) {
+        c->slice_dst[plane_no][i] = data;
+        data += c->slice_size[plane_no][i];
+    }
+    bytestream2_skip_p(pb, offset);
 
     return 0;
 }
@@ -532,7 +565,7 @@ static int utvideo_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     uint8_t *dst;
 
     int width = avctx->width, height = avctx->height;
-    int i, ret = 0;
+    int i, ret = 0, rets[4];
 
     /* Allocate a new packet if needed, and set it to the pointer dst */
     ret = ff_alloc_packet2(avctx, pkt, (256 + 4 * c->slices + width * height) *
@@ -545,61 +578,57 @@ static int utvideo_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     bytestream2_init_writer(&pb, dst, pkt->size);
 
-    av_fast_padded_malloc(&c->slice_bits, &c->slice_bits_size, width * height + 4);
-
-    if (!c->slice_bits) {
-        av_log(avctx, AV_LOG_ERROR, "Cannot allocate temporary buffer 2.\n");
-        return AVERROR(ENOMEM);
-    }
-
     /* In case of RGB, mangle the planes to Ut Video's format */
     if (avctx->pix_fmt == AV_PIX_FMT_RGBA || avctx->pix_fmt == AV_PIX_FMT_RGB24)
         mangle_rgb_planes(c->slice_buffer, c->slice_stride, pic->data[0],
                           c->planes, pic->linesize[0], width, height);
 
     /* Deal with the planes */
-    switch (avctx->pix_fmt) {
-    case AV_PIX_FMT_RGB24:
-    case AV_PIX_FMT_RGBA:
-        for (i = 0; i < c->planes; i++) {
-            ret = encode_plane(avctx, c->slice_buffer[i] + 2 * c->slice_stride,
-                               c->slice_buffer[i], c->slice_stride, i,
-                               width, height, &pb);
-
-            if (ret) {
-                av_log(avctx, AV_LOG_ERROR, "Error encoding plane %d.\n", i);
-                return ret;
-            }
+    for (i = 0; i < c->planes; i++) {
+        switch (avctx->pix_fmt) {
+        case AV_PIX_FMT_RGB24:
+        case AV_PIX_FMT_RGBA:
+            c->plane_src[i]    = c->slice_buffer[i] + 2 * c->slice_stride;
+            c->plane_stride[i] = c->slice_stride;
+            c->plane_width[i]  = width;
+            c->plane_height[i] = height;
+            break;
+        case AV_PIX_FMT_YUV422P:
+            c->plane_src[i]    = pic->data[i];
+            c->plane_stride[i] = pic->linesize[i];
+            c->plane_width[i]  = width >> !!i;
+            c->plane_height[i] = height;
+            break;
+        case AV_PIX_FMT_YUV420P:
+            c->plane_src[i]    = pic->data[i];
+            c->plane_stride[i] = pic->linesize[i];
+            c->plane_width[i]  = width  >> !!i;
+            c->plane_height[i] = height >> !!i;
+            break;
+        default:
+            av_log(avctx, AV_LOG_ERROR, "Unknown pixel format: %d\n",
+                   avctx->pix_fmt);
+            return AVERROR_INVALIDDATA;
         }
-        break;
-    case AV_PIX_FMT_YUV422P:
-        for (i = 0; i < c->planes; i++) {
-            ret = encode_plane(avctx, pic->data[i], c->slice_buffer[0],
-                               pic->linesize[i], i, width >> !!i, height, &pb);
+    }
 
-            if (ret) {
-                av_log(avctx, AV_LOG_ERROR, "Error encoding plane %d.\n", i);
-                return ret;
-            }
+    /*
+     * The planes are predicted and their huffman tables built in parallel;
+     * once the tables give the size of every slice, the slices of all
+     * planes are written directly to their place in the packet.
+     */
+    avctx->execute2(avctx, prepare_plane, NULL, rets, c->planes);
+    for (i = 0; i < c->planes; i++) {
+        if (rets[i]) {
+            av_log(avctx, AV_LOG_ERROR, "Error encoding plane %d.\n", i);
+            return rets[i];
         }
-        break;
-    case AV_PIX_FMT_YUV420P:
-        for (i = 0; i < c->planes; i++) {
-            ret = encode_plane(avctx, pic->data[i], c->slice_buffer[0],
-                               pic->linesize[i], i, width >> !!i, height >> !!i,
-                               &pb);
-
-            if (ret) {
-                av_log(avctx, AV_LOG_ERROR, "Error encoding plane %d.\n", i);
-                return ret;
-            }
+        if ((ret = write_plane_header(c, i, &pb)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Output buffer too small for plane %d.\n", i);
+            return ret;
         }
-        break;
-    default:
-        av_log(avctx, AV_LOG_ERROR, "Unknown pixel format: %d\n",
-               avctx->pix_fmt);
-        return AVERROR_INVALIDDATA;
     }
+    avctx->execute2(avctx, encode_slice, NULL, NULL, c->planes * c->slices);
 
     /*
      * Write frame information (LE 32bit unsigned)
@@ -638,7 +667,8 @@ AVCodec ff_utvideo_encoder = {
     .init           = utvideo_encode_init,
     .encode2        = utvideo_encode_frame,
     .close          = utvideo_encode_close,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
                           AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA, AV_PIX_FMT_YUV422P,
                           AV_PIX_FMT_YUV420P, AV_PIX_FMT_NONE
@@ -163,7 +163,7 @@ int update_dimensions(VP8Context *s, int width, int height, int is_vp7)
     s->mb_width  = (s->avctx->coded_width  + 15) / 16;
     s->mb_height = (s->avctx->coded_height + 15) / 16;
 
-    s->mb_layout = is_vp7 || avctx->active_thread_type == FF_THREAD_SLICE &&
+    s->mb_layout = is_vp7 || avctx->active_thread_type & FF_THREAD_SLICE &&
                    FFMIN(s->num_coeff_partitions, avctx->thread_count) > 1;
     if (!s->mb_layout) { // Frame threading and one thread
         s->macroblocks_base       = av_mallocz((s->mb_width + s->mb_height * 2 + 1) *
@@ -2254,8 +2254,8 @@ static void vp8_decode_mv_mb_modes(AVCodecContext *avctx, VP8Frame *cur_frame,
 #define update_pos(td, mb_y, mb_x)                                            \
     do {                                                                      \
         int pos              = (mb_y << 16) | (mb_x & 0xFFFF);                \
-        int sliced_threading = (avctx->active_thread_type == FF_THREAD_SLICE) && \
-                               (num_jobs > 1);                                \
+        int sliced_threading = (num_jobs > 1) &&                              \
+                               (avctx->active_thread_type & FF_THREAD_SLICE); \
         int is_null          = !next_td || !prev_td;                          \
         int pos_check        = (is_null) ? 1                                  \
                                          : (next_td != td &&                  \
@@ -2501,7 +2501,7 @@ int vp78_decode_mb_row_sliced(AVCodecContext *avctx, void *tdata, int jobnr,
         s->mv_min.y -= 64;
         s->mv_max.y -= 64;
 
-        if (avctx->active_thread_type == FF_THREAD_FRAME)
+        if (avctx->active_thread_type & FF_THREAD_FRAME)
             ff_thread_report_progress(&curframe->tf, mb_y, 0);
     }
 
@@ -2638,10 +2638,10 @@ int vp78_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
             vp8_decode_mv_mb_modes(avctx, curframe, prev_frame);
     }
 
-    if (avctx->active_thread_type == FF_THREAD_FRAME)
-        num_jobs = 1;
-    else
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
         num_jobs = FFMIN(s->num_coeff_partitions, avctx->thread_count);
+    else
+        num_jobs = 1;
     s->num_jobs   = num_jobs;
     s->curframe   = curframe;
     s->prev_frame = prev_frame;
@@ -2848,6 +2848,7 @@ AVCodec ff_vp8_decoder = {
     .decode                = ff_vp8_decode_frame,
     .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
                              AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal         = FF_CODEC_CAP_SLICE_THREADS_IN_FRAME_THREADS,
     .flush                 = vp8_decode_flush,
     .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vp8_decode_init_thread_copy),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(vp8_decode_update_thread_context),
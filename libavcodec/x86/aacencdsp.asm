@@ -0,0 +1,97 @@
+;******************************************************************************
+;* SIMD optimized AAC encoder DSP functions
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA
+
+float_abs_mask: times 4 dd 0x7fffffff
+
+SECTION .text
+
+;*******************************************************************
+;void ff_abs_pow34(float *out, const float *in, const int size);
+;*******************************************************************
+INIT_XMM sse
+cglobal abs_pow34, 3, 3, 3, out, in, size
+    mova   m2, [float_abs_mask]
+    shl    sized, 2
+    add    inq, sizeq
+    add    outq, sizeq
+    neg    sizeq
+.loop:
+    movu   m0, [inq+sizeq]
+    andps  m0, m2
+    sqrtps m1, m0
+    mulps  m0, m1
+    sqrtps m0, m0
+    movu   [outq+sizeq], m0
+    add    sizeq, mmsize
+    jl    .loop
+    RET
+
+;*******************************************************************
+;void ff_aac_quantize_bands(int *out, const float *in, const float *scaled,
+;                           int size, int is_signed, int maxval, const float Q34,
+;                           const float rounding)
+;*******************************************************************
+INIT_XMM sse2
+cglobal aac_quantize_bands, 6, 6, 8, out, in, scaled, size, is_signed, maxval, Q34, rounding
+%if UNIX64 == 0
+    movss      m0, Q34m
+    movss      m1, roundingm
+%endif
+    ; the rounding and the clipping are done in double precision like the C code
+    shufps     m0, m0, 0
+    cvtss2sd   m1, m1
+    unpcklpd   m1, m1
+    cvtsi2sd   m3, maxvald
+    unpcklpd   m3, m3
+    neg        is_signedd
+    movd       m4, is_signedd
+    pshufd     m4, m4, 0
+    xorps      m7, m7
+    shl        sized, 2
+    add        inq, sizeq
+    add        outq, sizeq
+    add        scaledq, sizeq
+    neg        sizeq
+.loop:
+    movu       m2, [scaledq+sizeq]
+    mulps      m2, m0
+    movhlps    m5, m2
+    cvtps2pd   m2, m2
+    cvtps2pd   m5, m5
+    addpd      m2, m1
+    addpd      m5, m1
+    minpd      m2, m3
+    minpd      m5, m3
+    cvttpd2dq  m2, m2
+    cvttpd2dq  m5, m5
+    punpcklqdq m2, m5
+    movu       m6, [inq+sizeq]
+    cmpltps    m6, m7
+    pand       m6, m4
+    pxor       m2, m6
+    psubd      m2, m6
+    movu       [outq+sizeq], m2
+    add        sizeq, mmsize
+    jl        .loop
+    RET
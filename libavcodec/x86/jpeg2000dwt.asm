@@ -0,0 +1,103 @@
+;******************************************************************************
+;* SIMD-optimized JPEG 2000 inverse DWT
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA
+
+pd_2: times 4 dd 2
+
+SECTION .text
+
+; a row is FF_DWT_COLS (16) samples of 4 bytes
+%define ROW 64
+
+;******************************************************************************
+; ff_dwt_lift_float_<opt>(float *p, int n, float coef)
+;******************************************************************************
+INIT_XMM sse
+%if UNIX64
+cglobal dwt_lift_float, 2, 2, 3, p, n
+%else
+cglobal dwt_lift_float, 3, 3, 3, p, n, coef
+%endif
+%if ARCH_X86_32
+    movss    m0, coefm
+%elif WIN64
+    SWAP 0, 2
+%endif
+    shufps   m0, m0, 0
+.loop:
+%assign i 0
+%rep ROW / mmsize
+    mova     m1, [pq+i-ROW]
+    addps    m1, [pq+i+ROW]
+    mulps    m1, m0
+    mova     m2, [pq+i]
+    subps    m2, m1
+    mova     [pq+i], m2
+%assign i i+mmsize
+%endrep
+    add      pq, 2*ROW
+    dec      nd
+    jg .loop
+    REP_RET
+
+;******************************************************************************
+; ff_dwt_lift53_sub_<opt>(int32_t *p, int n)
+;******************************************************************************
+INIT_XMM sse2
+cglobal dwt_lift53_sub, 2, 2, 3, p, n
+    mova     m0, [pd_2]
+.loop:
+%assign i 0
+%rep ROW / mmsize
+    mova     m1, [pq+i-ROW]
+    paddd    m1, [pq+i+ROW]
+    paddd    m1, m0
+    psrad    m1, 2
+    mova     m2, [pq+i]
+    psubd    m2, m1
+    mova     [pq+i], m2
+%assign i i+mmsize
+%endrep
+    add      pq, 2*ROW
+    dec      nd
+    jg .loop
+    REP_RET
+
+;******************************************************************************
+; ff_dwt_lift53_add_<opt>(int32_t *p, int n)
+;******************************************************************************
+cglobal dwt_lift53_add, 2, 2, 2, p, n
+.loop:
+%assign i 0
+%rep ROW / mmsize
+    mova     m1, [pq+i-ROW]
+    paddd    m1, [pq+i+ROW]
+    psrad    m1, 1
+    paddd    m1, [pq+i]
+    mova     [pq+i], m1
+%assign i i+mmsize
+%endrep
+    add      pq, 2*ROW
+    dec      nd
+    jg .loop
+    REP_RET
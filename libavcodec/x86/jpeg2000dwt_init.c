@@ -0,0 +1,42 @@
+/*
+ * SIMD optimized JPEG 2000 inverse DWT
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavcodec/jpeg2000dwt.h"
+
+void ff_dwt_lift_float_sse(float *p, int n, float coef);
+void ff_dwt_lift53_sub_sse2(int32_t *p, int n);
+void ff_dwt_lift53_add_sse2(int32_t *p, int n);
+
+av_cold void ff_jpeg2000dwt_init_x86(DWTContext *s)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE(cpu_flags)) {
+        s->lift_float = ff_dwt_lift_float_sse;
+    }
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        s->lift53_sub = ff_dwt_lift53_sub_sse2;
+        s->lift53_add = ff_dwt_lift53_add_sse2;
+    }
+}
@@ -43,6 +43,7 @@
 #include "libavutil/samplefmt.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/rational.h"
+#include "libavutil/threadpool.h"
 
 #include "libavfilter/version.h"
 
@@ -792,6 +793,21 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * Thread pool on which slice threading runs its jobs, instead of threads
+     * owned by the graph. May be set by the caller immediately after
+     * allocating the graph and before adding any filters to it. nb_threads
+     * then caps the number of threads working for this graph at the same
+     * time. The pool must outlive the graph.
+     */
+    AVThreadPool *thread_pool;
+
+    /**
+     * Priority of the jobs of this graph on thread_pool, the jobs of graphs
+     * with a higher priority run first.
+     */
+    int thread_pool_priority;
+
     /**
      * Private fields
      *
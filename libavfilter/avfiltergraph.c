@@ -49,6 +49,8 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS },
+    { "thread_pool_priority", "Priority of the jobs on the shared thread pool", OFFSET(thread_pool_priority),
+        AV_OPT_TYPE_INT,   { .i64 = 0 }, INT_MIN, INT_MAX, FLAGS },
     { NULL },
 };
 
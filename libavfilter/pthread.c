@@ -27,6 +27,7 @@
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
+#include "libavutil/threadpool.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -60,8 +61,17 @@ typedef struct ThreadContext {
     int current_job;
     unsigned int current_execute;
     int done;
+
+    AVThreadPool *pool;
 } ThreadContext;
 
+typedef struct PoolJobContext {
+    AVFilterContext *ctx;
+    avfilter_action_func *func;
+    void *arg;
+    int nb_jobs;
+} PoolJobContext;
+
 static void* attribute_align_arg worker(void *v)
 {
     ThreadContext *c = v;
@@ -153,6 +163,24 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     return 0;
 }
 
+static int pool_job(void *opaque, int jobnr, int threadnr)
+{
+    PoolJobContext *p = opaque;
+
+    return p->func(p->ctx, p->arg, jobnr, p->nb_jobs);
+}
+
+static int pool_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                        void *arg, int *ret, int nb_jobs)
+{
+    AVFilterGraph *graph = ctx->graph;
+    ThreadContext *c     = graph->internal->thread;
+    PoolJobContext p     = { ctx, func, arg, nb_jobs };
+
+    return av_thread_pool_execute(c->pool, pool_job, &p, ret, nb_jobs,
+                                  graph->nb_threads, graph->thread_pool_priority);
+}
+
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     int i, ret;
@@ -215,6 +243,18 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     if (!graph->internal->thread)
         return AVERROR(ENOMEM);
 
+    if (graph->thread_pool) {
+        ThreadContext *c = graph->internal->thread;
+        int nb_threads   = graph->nb_threads;
+
+        if (!nb_threads)
+            nb_threads = av_thread_pool_get_nb_threads(graph->thread_pool) + 1;
+        c->pool           = graph->thread_pool;
+        graph->nb_threads = FFMIN(nb_threads, AV_THREAD_POOL_MAX_CONCURRENCY);
+        graph->internal->thread_execute = pool_execute;
+        return 0;
+    }
+
     ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
     if (ret <= 1) {
         av_freep(&graph->internal->thread);
@@ -231,7 +271,9 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
-    if (graph->internal->thread)
-        slice_thread_uninit(graph->internal->thread);
+    ThreadContext *c = graph->internal->thread;
+
+    if (c && !c->pool)
+        slice_thread_uninit(c);
     av_freep(&graph->internal->thread);
 }
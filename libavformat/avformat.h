@@ -603,6 +603,13 @@ typedef struct AVOutputFormat {
      */
     int (*free_device_capabilities)(struct AVFormatContext *s, struct AVDeviceCapabilitiesQuery *caps);
     enum AVCodecID data_codec; /**< default data codec */
+    /**
+     * Deinitialize the muxer. Called from avformat_free_context() before
+     * the private data is freed, whether or not write_header() succeeded
+     * and whether or not write_trailer() was called, so it must cope with
+     * partially initialized or already released state.
+     */
+    void (*deinit)(struct AVFormatContext *);
 } AVOutputFormat;
 /**
  * @}
@@ -184,6 +184,13 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
     }
     while (size > 0) {
         int len = FFMIN(s->buf_end - s->buf_ptr, size);
+        /* Pass large writes straight through once the buffer is empty,
+         * unless the protocol needs the data in max_packet_size units. */
+        if (s->buf_ptr == s->buffer && size >= s->buffer_size &&
+            !s->max_packet_size && !s->update_checksum) {
+            writeout(s, buf, size);
+            return;
+        }
         memcpy(s->buf_ptr, buf, len);
         s->buf_ptr += len;
 
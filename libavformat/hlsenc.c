@@ -25,16 +25,22 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "libavutil/avassert.h"
+#include "libavutil/fifo.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
+#include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
 #include "avformat.h"
+#include "avio_internal.h"
 #include "internal.h"
 #include "os_support.h"
 
@@ -63,6 +69,25 @@ typedef enum HLSFlags {
     HLS_OMIT_ENDLIST = (1 << 4),
 } HLSFlags;
 
+typedef enum HLSJobType {
+    HLS_JOB_CLOSE,      ///< close a finished segment
+    HLS_JOB_WRITE,      ///< write a playlist file
+    HLS_JOB_DELETE,     ///< delete a segment that left the playlist
+} HLSJobType;
+
+/**
+ * Deferred I/O operation. Jobs are executed in submission order, either
+ * immediately or by the background writer when hls_async_queue is set.
+ */
+typedef struct HLSJob {
+    HLSJobType type;
+    AVIOContext *pb;    ///< HLS_JOB_CLOSE: context to close
+    char *filename;     ///< HLS_JOB_WRITE / HLS_JOB_DELETE: target path
+    uint8_t *buf;       ///< HLS_JOB_WRITE: playlist contents
+    int size;
+    int use_rename;     ///< HLS_JOB_WRITE: write to a .tmp file and rename it
+} HLSJob;
+
 typedef struct HLSContext {
     const AVClass *class;  // Class for private options.
     unsigned number;
@@ -113,8 +138,231 @@ typedef struct HLSContext {
     char iv_string[KEYSIZE*2 + 1];
     AVDictionary *vtt_format_options;
 
+    int async_queue_size;   // Set by a private option.
+    AVIOInterruptCB interrupt_callback;
+#if HAVE_PTHREADS
+    AVFifoBuffer *jobs;
+    pthread_t writer_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_job;
+    pthread_cond_t cond_space;
+    int writer_started;
+    int writer_exit;
+    int writer_error;
+    int max_queued;
+    int nb_blocked;
+    int64_t blocked_time;
+#endif
 } HLSContext;
 
+static void hls_free_job(HLSJob *job)
+{
+    av_freep(&job->filename);
+    av_freep(&job->buf);
+    avio_closep(&job->pb);
+}
+
+static int hls_run_job(HLSContext *hls, HLSJob *job)
+{
+    AVIOContext *out = NULL;
+    char temp_filename[1024];
+    int ret = 0;
+
+    switch (job->type) {
+    case HLS_JOB_CLOSE:
+        avio_closep(&job->pb);
+        break;
+    case HLS_JOB_WRITE:
+        snprintf(temp_filename, sizeof(temp_filename),
+                 job->use_rename ? "%s.tmp" : "%s", job->filename);
+        if ((ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE,
+                              &hls->interrupt_callback, NULL)) < 0)
+            break;
+        avio_write(out, job->buf, job->size);
+        avio_closep(&out);
+        if (job->use_rename)
+            ret = ff_rename(temp_filename, job->filename, hls);
+        break;
+    case HLS_JOB_DELETE:
+        if (unlink(job->filename) < 0)
+            av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
+                                     job->filename, strerror(errno));
+        break;
+    }
+
+    hls_free_job(job);
+    return ret;
+}
+
+#if HAVE_PTHREADS
+static void *hls_writer_task(void *arg)
+{
+    HLSContext *hls = arg;
+    HLSJob job;
+    int ret;
+
+    pthread_mutex_lock(&hls->mutex);
+    while (1) {
+        if (!av_fifo_size(hls->jobs)) {
+            if (hls->writer_exit)
+                break;
+            pthread_cond_wait(&hls->cond_job, &hls->mutex);
+            continue;
+        }
+        av_fifo_generic_read(hls->jobs, &job, sizeof(job), NULL);
+        pthread_cond_signal(&hls->cond_space);
+        pthread_mutex_unlock(&hls->mutex);
+
+        ret = hls_run_job(hls, &job);
+
+        pthread_mutex_lock(&hls->mutex);
+        if (ret < 0 && !hls->writer_error)
+            hls->writer_error = ret;
+    }
+    pthread_mutex_unlock(&hls->mutex);
+
+    return NULL;
+}
+
+static int hls_writer_start(HLSContext *hls)
+{
+    int ret;
+
+    hls->jobs = av_fifo_alloc_array(hls->async_queue_size, sizeof(HLSJob));
+    if (!hls->jobs)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&hls->mutex, NULL);
+    if (ret) {
+        av_log(hls, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", av_err2str(AVERROR(ret)));
+        goto mutex_fail;
+    }
+    ret = pthread_cond_init(&hls->cond_job, NULL);
+    if (ret) {
+        av_log(hls, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(AVERROR(ret)));
+        goto cond_job_fail;
+    }
+    ret = pthread_cond_init(&hls->cond_space, NULL);
+    if (ret) {
+        av_log(hls, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(AVERROR(ret)));
+        goto cond_space_fail;
+    }
+    ret = pthread_create(&hls->writer_thread, NULL, hls_writer_task, hls);
+    if (ret) {
+        av_log(hls, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+        goto thread_fail;
+    }
+    hls->writer_started = 1;
+
+    return 0;
+
+thread_fail:
+    pthread_cond_destroy(&hls->cond_space);
+cond_space_fail:
+    pthread_cond_destroy(&hls->cond_job);
+cond_job_fail:
+    pthread_mutex_destroy(&hls->mutex);
+mutex_fail:
+    av_fifo_freep(&hls->jobs);
+    return AVERROR(ret);
+}
+
+/* Wait for all pending jobs to complete and stop the background writer. */
+static int hls_writer_stop(HLSContext *hls)
+{
+    int ret;
+
+    if (!hls->writer_started)
+        return 0;
+
+    pthread_mutex_lock(&hls->mutex);
+    hls->writer_exit = 1;
+    pthread_cond_signal(&hls->cond_job);
+    pthread_mutex_unlock(&hls->mutex);
+
+    ret = pthread_join(hls->writer_thread, NULL);
+    if (ret)
+        av_log(hls, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(AVERROR(ret)));
+
+    pthread_cond_destroy(&hls->cond_space);
+    pthread_cond_destroy(&hls->cond_job);
+    pthread_mutex_destroy(&hls->mutex);
+    av_fifo_freep(&hls->jobs);
+    hls->writer_started = 0;
+
+    av_log(hls, hls->nb_blocked ? AV_LOG_INFO : AV_LOG_VERBOSE,
+           "background writer: queue size %d, max queued %d, "
+           "blocked %d times for %"PRId64" ms\n",
+           hls->async_queue_size, hls->max_queued,
+           hls->nb_blocked, hls->blocked_time / 1000);
+
+    return hls->writer_error;
+}
+#endif
+
+/**
+ * Execute an I/O job, or hand it to the background writer if there is one.
+ * Takes ownership of the job data in all cases.
+ */
+static int hls_submit_job(HLSContext *hls, HLSJob *job)
+{
+#if HAVE_PTHREADS
+    if (hls->writer_started) {
+        int ret;
+
+        pthread_mutex_lock(&hls->mutex);
+        if (av_fifo_space(hls->jobs) < sizeof(*job)) {
+            int64_t t0 = av_gettime_relative();
+            while (av_fifo_space(hls->jobs) < sizeof(*job))
+                pthread_cond_wait(&hls->cond_space, &hls->mutex);
+            hls->blocked_time += av_gettime_relative() - t0;
+            hls->nb_blocked++;
+        }
+        av_fifo_generic_write(hls->jobs, job, sizeof(*job), NULL);
+        hls->max_queued = FFMAX(hls->max_queued,
+                                av_fifo_size(hls->jobs) / sizeof(*job));
+        pthread_cond_signal(&hls->cond_job);
+        ret = hls->writer_error;
+        pthread_mutex_unlock(&hls->mutex);
+
+        return ret;
+    }
+#endif
+    return hls_run_job(hls, job);
+}
+
+static int hls_close_segment(HLSContext *hls, AVIOContext **pb)
+{
+    HLSJob job = { .type = HLS_JOB_CLOSE, .pb = *pb };
+
+    *pb = NULL;
+    return hls_submit_job(hls, &job);
+}
+
+static int hls_delete_file(HLSContext *hls, char *path)
+{
+    HLSJob job = { .type = HLS_JOB_DELETE, .filename = path };
+
+    return hls_submit_job(hls, &job);
+}
+
+/* Submit the playlist accumulated in the dynamic buffer *out. */
+static int hls_write_playlist(HLSContext *hls, const char *filename,
+                              AVIOContext **out, int use_rename)
+{
+    HLSJob job = { .type = HLS_JOB_WRITE, .use_rename = use_rename };
+
+    job.size = avio_close_dyn_buf(*out, &job.buf);
+    *out = NULL;
+    job.filename = av_strdup(filename);
+    if (!job.filename) {
+        hls_free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+
+    return hls_submit_job(hls, &job);
+}
+
 static int hls_delete_old_segments(HLSContext *hls) {
 
     HLSSegment *segment, *previous_segment = NULL;
@@ -172,19 +420,17 @@ static int hls_delete_old_segments(HLSContext *hls) {
 
         av_strlcpy(path, dirname, path_size);
         av_strlcat(path, segment->filename, path_size);
-        if (unlink(path) < 0) {
-            av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
-                                     path, strerror(errno));
-        }
+        ret = hls_delete_file(hls, path);
+        path = NULL;
 
         av_strlcpy(sub_path, dirname, sub_path_size);
         av_strlcat(sub_path, segment->sub_filename, sub_path_size);
-        if (unlink(sub_path) < 0) {
-            av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
-                                     sub_path, strerror(errno));
-        }
-        av_freep(&path);
-        av_free(sub_path);
+        if (ret >= 0)
+            ret = hls_delete_file(hls, sub_path);
+        else
+            av_free(sub_path);
+        if (ret < 0)
+            goto fail;
         previous_segment = segment;
         segment = previous_segment->next;
         av_free(previous_segment);
@@ -366,7 +612,6 @@ static int hls_window(AVFormatContext *s, int last)
     int ret = 0;
     AVIOContext *out = NULL;
     AVIOContext *sub_out = NULL;
-    char temp_filename[1024];
     int64_t sequence = FFMAX(hls->start_sequence, hls->sequence - hls->nb_entries);
     int version = hls->flags & HLS_SINGLE_FILE ? 4 : 3;
     const char *proto = avio_find_protocol_name(s->filename);
@@ -378,9 +623,7 @@ static int hls_window(AVFormatContext *s, int last)
     if (!use_rename && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporarly partial files\n");
 
-    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->filename);
-    if ((ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE,
-                          &s->interrupt_callback, NULL)) < 0)
+    if ((ret = avio_open_dyn_buf(&out)) < 0)
         goto fail;
 
     for (en = hls->segments; en; en = en->next) {
@@ -429,9 +672,11 @@ static int hls_window(AVFormatContext *s, int last)
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         avio_printf(out, "#EXT-X-ENDLIST\n");
 
+    if ((ret = hls_write_playlist(hls, s->filename, &out, use_rename)) < 0)
+        goto fail;
+
     if( hls->vtt_m3u8_name ) {
-        if ((ret = avio_open2(&sub_out, hls->vtt_m3u8_name, AVIO_FLAG_WRITE,
-                          &s->interrupt_callback, NULL)) < 0)
+        if ((ret = avio_open_dyn_buf(&sub_out)) < 0)
             goto fail;
         avio_printf(sub_out, "#EXTM3U\n");
         avio_printf(sub_out, "#EXT-X-VERSION:%d\n", version);
@@ -457,13 +702,12 @@ static int hls_window(AVFormatContext *s, int last)
         if (last)
             avio_printf(sub_out, "#EXT-X-ENDLIST\n");
 
+        ret = hls_write_playlist(hls, hls->vtt_m3u8_name, &sub_out, 0);
     }
 
 fail:
-    avio_closep(&out);
-    avio_closep(&sub_out);
-    if (ret >= 0 && use_rename)
-        ff_rename(temp_filename, s->filename, s);
+    ffio_free_dyn_buf(&out);
+    ffio_free_dyn_buf(&sub_out);
     return ret;
 }
 
@@ -564,6 +808,7 @@ static int hls_write_header(AVFormatContext *s)
     hls->sequence       = hls->start_sequence;
     hls->recording_time = hls->time * AV_TIME_BASE;
     hls->start_pts      = AV_NOPTS_VALUE;
+    hls->interrupt_callback = s->interrupt_callback;
 
     if (hls->format_options_str) {
         ret = av_dict_parse_string(&hls->format_options, hls->format_options_str, "=", ":", 0);
@@ -690,6 +935,15 @@ static int hls_write_header(AVFormatContext *s)
         }
         avpriv_set_pts_info(outer_st, inner_st->pts_wrap_bits, inner_st->time_base.num, inner_st->time_base.den);
     }
+
+    if (hls->async_queue_size) {
+#if HAVE_PTHREADS
+        ret = hls_writer_start(hls);
+#else
+        av_log(s, AV_LOG_WARNING, "hls_async_queue requires pthreads, "
+               "segments will be written synchronously\n");
+#endif
+    }
 fail:
 
     av_dict_free(&options);
@@ -759,11 +1013,12 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 av_opt_set(hls->avf->priv_data, "mpegts_flags", "resend_headers", 0);
             hls->number++;
         } else {
-            avio_closep(&oc->pb);
-            if (hls->vtt_avf)
-                avio_close(hls->vtt_avf->pb);
+            ret = hls_close_segment(hls, &hls->avf->pb);
+            if (hls->vtt_avf && ret >= 0)
+                ret = hls_close_segment(hls, &hls->vtt_avf->pb);
 
-            ret = hls_start(s);
+            if (ret >= 0)
+                ret = hls_start(s);
         }
 
         if (ret < 0)
@@ -788,11 +1043,12 @@ static int hls_write_trailer(struct AVFormatContext *s)
     HLSContext *hls = s->priv_data;
     AVFormatContext *oc = hls->avf;
     AVFormatContext *vtt_oc = hls->vtt_avf;
+    int ret = 0;
 
     av_write_trailer(oc);
     if (oc->pb) {
         hls->size = avio_tell(hls->avf->pb) - hls->start_pos;
-        avio_closep(&oc->pb);
+        hls_close_segment(hls, &oc->pb);
         hls_append_segment(hls, hls->duration, hls->start_pos, hls->size);
     }
 
@@ -800,7 +1056,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
         if (vtt_oc->pb)
             av_write_trailer(vtt_oc);
         hls->size = avio_tell(hls->vtt_avf->pb) - hls->start_pos;
-        avio_closep(&vtt_oc->pb);
+        hls_close_segment(hls, &vtt_oc->pb);
     }
     av_freep(&hls->basename);
     avformat_free_context(oc);
@@ -814,9 +1070,26 @@ static int hls_write_trailer(struct AVFormatContext *s)
     hls->avf = NULL;
     hls_window(s, 1);
 
+#if HAVE_PTHREADS
+    ret = hls_writer_stop(hls);
+#endif
+
     hls_free_segments(hls->segments);
     hls_free_segments(hls->old_segments);
-    return 0;
+    hls->segments     = NULL;
+    hls->old_segments = NULL;
+    return ret;
+}
+
+/* Make sure the background writer is gone even if the trailer is never
+ * written, e.g. when the caller aborts after a write error. */
+static void hls_deinit(AVFormatContext *s)
+{
+#if HAVE_PTHREADS
+    HLSContext *hls = s->priv_data;
+
+    hls_writer_stop(hls);
+#endif
 }
 
 #define OFFSET(x) offsetof(HLSContext, x)
@@ -840,6 +1113,7 @@ static const AVOption options[] = {
     {"discont_start", "start the playlist with a discontinuity tag", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_DISCONT_START }, 0, UINT_MAX,   E, "flags"},
     {"omit_endlist", "Do not append an endlist when ending stream", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_OMIT_ENDLIST }, 0, UINT_MAX,   E, "flags"},
     { "use_localtime",          "set filename expansion with strftime at segment creation", OFFSET(use_localtime), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 1, E },
+    {"hls_async_queue", "set number of segment/playlist I/O operations that can be queued to a background writer (0 = synchronous)", OFFSET(async_queue_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX / sizeof(HLSJob), E},
 
     { NULL },
 };
@@ -864,5 +1138,6 @@ AVOutputFormat ff_hls_muxer = {
     .write_header   = hls_write_header,
     .write_packet   = hls_write_packet,
     .write_trailer  = hls_write_trailer,
+    .deinit         = hls_deinit,
     .priv_class     = &hls_class,
 };
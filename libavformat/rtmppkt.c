@@ -204,25 +204,18 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
     if (hdr == RTMP_PS_ONEBYTE) {
         ts_field = prev_pkt[channel_id].ts_field;
     } else {
-        if (ffurl_read_complete(h, buf, 3) != 3)
+        /* read the whole message header at once */
+        int hdr_size = hdr == RTMP_PS_TWELVEBYTES ? 11 :
+                       hdr == RTMP_PS_EIGHTBYTES  ?  7 : 3;
+        if (ffurl_read_complete(h, buf, hdr_size) != hdr_size)
             return AVERROR(EIO);
-        written += 3;
+        written += hdr_size;
         ts_field = AV_RB24(buf);
         if (hdr != RTMP_PS_FOURBYTES) {
-            if (ffurl_read_complete(h, buf, 3) != 3)
-                return AVERROR(EIO);
-            written += 3;
-            size = AV_RB24(buf);
-            if (ffurl_read_complete(h, buf, 1) != 1)
-                return AVERROR(EIO);
-            written++;
-            type = buf[0];
-            if (hdr == RTMP_PS_TWELVEBYTES) {
-                if (ffurl_read_complete(h, buf, 4) != 4)
-                    return AVERROR(EIO);
-                written += 4;
-                extra = AV_RL32(buf);
-            }
+            size = AV_RB24(buf + 3);
+            type = buf[6];
+            if (hdr == RTMP_PS_TWELVEBYTES)
+                extra = AV_RL32(buf + 7);
         }
     }
     if (ts_field == 0xFFFFFF) {
@@ -236,11 +229,21 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
         timestamp += prev_pkt[channel_id].timestamp;
 
     if (!prev_pkt[channel_id].read) {
-        if ((ret = ff_rtmp_packet_create(p, channel_id, type, timestamp,
-                                         size)) < 0)
-            return ret;
-        p->read = written;
-        p->offset = 0;
+        /* the payload is reassembled in a buffer kept in the channel history
+         * and reused for the following messages of that channel */
+        RTMPPacket *prev = &prev_pkt[channel_id];
+        uint8_t *ptr = av_fast_realloc(prev->data, &prev->alloc_size, size);
+        if (!ptr && size)
+            return AVERROR(ENOMEM);
+        prev->data    = ptr;
+        p->data       = ptr;
+        p->size       = size;
+        p->channel_id = channel_id;
+        p->type       = type;
+        p->timestamp  = timestamp;
+        p->ts_field   = ts_field;
+        p->read       = written;
+        p->offset     = 0;
         prev_pkt[channel_id].ts_field   = ts_field;
         prev_pkt[channel_id].timestamp  = timestamp;
     } else {
@@ -255,7 +258,6 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
         p->offset        = prev->offset;
         p->read          = prev->read + written;
         p->timestamp     = prev->timestamp;
-        prev->data       = NULL;
     }
     p->extra = extra;
     // save history
@@ -267,7 +269,7 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
 
     toread = FFMIN(size, chunk_size);
     if (ffurl_read_complete(h, p->data + p->offset, toread) != toread) {
-        ff_rtmp_packet_destroy(p);
+        prev_pkt[channel_id].read = 0;
         return AVERROR(EIO);
     }
     size      -= toread;
@@ -276,10 +278,8 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
 
     if (size > 0) {
        RTMPPacket *prev = &prev_pkt[channel_id];
-       prev->data = p->data;
        prev->read = p->read;
        prev->offset = p->offset;
-       p->data      = NULL;
        return AVERROR(EAGAIN);
     }
 
@@ -307,6 +307,7 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
                          int *nb_prev_pkt)
 {
     uint8_t pkt_hdr[16], *p = pkt_hdr;
+    uint8_t cont_hdr[7], *q;
     int mode = RTMP_PS_TWELVEBYTES;
     int off = 0;
     int written = 0;
@@ -374,6 +375,21 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
     prev_pkt[pkt->channel_id].ts_field   = pkt->ts_field;
     prev_pkt[pkt->channel_id].extra      = pkt->extra;
 
+    /* continuation chunk header */
+    q = cont_hdr;
+    if (pkt->channel_id < 64) {
+        bytestream_put_byte(&q, pkt->channel_id | (RTMP_PS_ONEBYTE << 6));
+    } else if (pkt->channel_id < 64 + 256) {
+        bytestream_put_byte(&q, 0               | (RTMP_PS_ONEBYTE << 6));
+        bytestream_put_byte(&q, pkt->channel_id - 64);
+    } else {
+        bytestream_put_byte(&q, 1               | (RTMP_PS_ONEBYTE << 6));
+        bytestream_put_le16(&q, pkt->channel_id - 64);
+    }
+    if (pkt->ts_field == 0xFFFFFF)
+        bytestream_put_be32(&q, timestamp);
+
+    /* the payload is sent straight from the packet, one slice per chunk */
     if ((ret = ffurl_write(h, pkt_hdr, p - pkt_hdr)) < 0)
         return ret;
     written = p - pkt_hdr + pkt->size;
@@ -383,17 +399,9 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
             return ret;
         off += towrite;
         if (off < pkt->size) {
-            uint8_t marker = 0xC0 | pkt->channel_id;
-            if ((ret = ffurl_write(h, &marker, 1)) < 0)
+            if ((ret = ffurl_write(h, cont_hdr, q - cont_hdr)) < 0)
                 return ret;
-            written++;
-            if (pkt->ts_field == 0xFFFFFF) {
-                uint8_t ts_header[4];
-                AV_WB32(ts_header, timestamp);
-                if ((ret = ffurl_write(h, ts_header, 4)) < 0)
-                    return ret;
-                written += 4;
-            }
+            written += q - cont_hdr;
         }
     }
     return written;
@@ -422,7 +430,8 @@ void ff_rtmp_packet_destroy(RTMPPacket *pkt)
     if (!pkt)
         return;
     av_freep(&pkt->data);
-    pkt->size = 0;
+    pkt->size       = 0;
+    pkt->alloc_size = 0;
 }
 
 int ff_amf_tag_size(const uint8_t *data, const uint8_t *data_end)
@@ -84,6 +84,7 @@ typedef struct RTMPPacket {
     int            size;       ///< packet payload size
     int            offset;     ///< amount of data read so far
     int            read;       ///< amount read, including headers
+    unsigned int   alloc_size; ///< allocated size of data, only used by the channel receive buffers in the read history
 } RTMPPacket;
 
 /**
@@ -115,6 +116,10 @@ void ff_rtmp_packet_destroy(RTMPPacket *pkt);
  * @param prev_pkt   previously read packet headers for all channels
  *                   (may be needed for restoring incomplete packet header)
  * @param nb_prev_pkt number of allocated elements in prev_pkt
+ *
+ * The payload of the returned packet is kept in prev_pkt and reused for the
+ * next message received on the same channel. It must not be freed and is
+ * only valid until the next read.
  * @return number of bytes read on success, negative value otherwise
  */
 int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
@@ -130,6 +135,10 @@ int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
  *                   (may be needed for restoring incomplete packet header)
  * @param nb_prev_pkt number of allocated elements in prev_pkt
  * @param c          the first byte already read
+ *
+ * The payload of the returned packet is kept in prev_pkt and reused for the
+ * next message received on the same channel. It must not be freed and is
+ * only valid until the next read.
  * @return number of bytes read on success, negative value otherwise
  */
 int ff_rtmp_packet_read_internal(URLContext *h, RTMPPacket *p, int chunk_size,
@@ -419,7 +419,6 @@ static int read_connect(URLContext *s, RTMPContext *rt)
         if ((ret = handle_chunk_size(s, &pkt)) < 0)
             return ret;
 
-        ff_rtmp_packet_destroy(&pkt);
         if ((ret = ff_rtmp_packet_read(rt->stream, &pkt, rt->in_chunk_size,
                                        &rt->prev_pkt[0], &rt->nb_prev_pkt[0])) < 0)
             return ret;
@@ -429,12 +428,10 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     bytestream2_init(&gbc, cp, pkt.size);
     if (ff_amf_read_string(&gbc, command, sizeof(command), &stringlen)) {
         av_log(s, AV_LOG_ERROR, "Unable to read command string\n");
-        ff_rtmp_packet_destroy(&pkt);
         return AVERROR_INVALIDDATA;
     }
     if (strcmp(command, "connect")) {
         av_log(s, AV_LOG_ERROR, "Expecting connect, got %s\n", command);
-        ff_rtmp_packet_destroy(&pkt);
         return AVERROR_INVALIDDATA;
     }
     ret = ff_amf_read_number(&gbc, &seqnum);
@@ -449,7 +446,6 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     if (!ret && strcmp(tmpstr, rt->app))
         av_log(s, AV_LOG_WARNING, "App field don't match up: %s <-> %s\n",
                tmpstr, rt->app);
-    ff_rtmp_packet_destroy(&pkt);
 
     // Send Window Acknowledgement Size (as defined in speficication)
     if ((ret = ff_rtmp_packet_create(&pkt, RTMP_NETWORK_CHANNEL,
@@ -2428,49 +2424,32 @@ static int get_packet(URLContext *s, int for_header)
         // with the next packet. handle_invoke will get us out of this state
         // when the right message is encountered
         if (rt->state == STATE_SEEKING) {
-            ff_rtmp_packet_destroy(&rpkt);
             // We continue, let the natural flow of things happen:
             // AVERROR(EAGAIN) or handle_invoke gets us out of here
             continue;
         }
 
-        if (ret < 0) {//serious error in current packet
-            ff_rtmp_packet_destroy(&rpkt);
+        if (ret < 0) //serious error in current packet
             return ret;
-        }
-        if (rt->do_reconnect && for_header) {
-            ff_rtmp_packet_destroy(&rpkt);
+        if (rt->do_reconnect && for_header)
             return 0;
-        }
-        if (rt->state == STATE_STOPPED) {
-            ff_rtmp_packet_destroy(&rpkt);
+        if (rt->state == STATE_STOPPED)
             return AVERROR_EOF;
-        }
         if (for_header && (rt->state == STATE_PLAYING    ||
                            rt->state == STATE_PUBLISHING ||
                            rt->state == STATE_SENDING    ||
-                           rt->state == STATE_RECEIVING)) {
-            ff_rtmp_packet_destroy(&rpkt);
+                           rt->state == STATE_RECEIVING))
             return 0;
-        }
-        if (!rpkt.size || !rt->is_input) {
-            ff_rtmp_packet_destroy(&rpkt);
+        if (!rpkt.size || !rt->is_input)
             continue;
-        }
         if (rpkt.type == RTMP_PT_VIDEO || rpkt.type == RTMP_PT_AUDIO) {
-            ret = append_flv_data(rt, &rpkt, 0);
-            ff_rtmp_packet_destroy(&rpkt);
-            return ret;
+            return append_flv_data(rt, &rpkt, 0);
         } else if (rpkt.type == RTMP_PT_NOTIFY) {
-            ret = handle_notify(s, &rpkt);
-            ff_rtmp_packet_destroy(&rpkt);
-            return ret;
+            return handle_notify(s, &rpkt);
         } else if (rpkt.type == RTMP_PT_METADATA) {
-            ret = handle_metadata(rt, &rpkt);
-            ff_rtmp_packet_destroy(&rpkt);
+            handle_metadata(rt, &rpkt);
             return 0;
         }
-        ff_rtmp_packet_destroy(&rpkt);
     }
 }
 
@@ -2805,14 +2784,17 @@ reconnect:
         goto fail;
 
     if (rt->do_reconnect) {
-        int i;
+        int i, j;
         ffurl_close(rt->stream);
         rt->stream       = NULL;
         rt->do_reconnect = 0;
         rt->nb_invokes   = 0;
-        for (i = 0; i < 2; i++)
+        for (i = 0; i < 2; i++) {
+            for (j = 0; j < rt->nb_prev_pkt[i]; j++)
+                ff_rtmp_packet_destroy(&rt->prev_pkt[i][j]);
             memset(rt->prev_pkt[i], 0,
                    sizeof(**rt->prev_pkt) * rt->nb_prev_pkt[i]);
+        }
         free_tracked_methods(rt);
         goto reconnect;
     }
@@ -3064,8 +3046,6 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
 
         if ((ret = rtmp_parse_result(s, rt, &rpkt)) < 0)
             return ret;
-
-        ff_rtmp_packet_destroy(&rpkt);
     }
 
     return size;
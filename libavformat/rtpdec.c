@@ -31,6 +31,7 @@
 #include "rtpdec_formats.h"
 
 #define MIN_FEEDBACK_INTERVAL 200000 /* 200 ms in us */
+#define RTP_FEC_HEADER_SIZE 16
 
 static RTPDynamicProtocolHandler gsm_dynamic_handler = {
     .enc_name   = "GSM",
@@ -408,29 +409,45 @@ void ff_rtp_send_punch_packets(URLContext *rtp_handle)
     av_free(buf);
 }
 
+static RTPPacket *get_slot(RTPDemuxContext *s, uint16_t seq)
+{
+    return &s->slots[seq & (s->nb_slots - 1)];
+}
+
+static RTPPacket *find_packet(RTPDemuxContext *s, uint16_t seq)
+{
+    RTPPacket *slot = get_slot(s, seq);
+    return slot->buf && slot->seq == seq ? slot : NULL;
+}
+
+static int has_next_packet(RTPDemuxContext *s)
+{
+    RTPPacket *slot;
+
+    if (!s->queue_len)
+        return 0;
+    slot = get_slot(s, s->seq + 1);
+    return slot->queued && slot->seq == (uint16_t) (s->seq + 1);
+}
+
 static int find_missing_packets(RTPDemuxContext *s, uint16_t *first_missing,
                                 uint16_t *missing_mask)
 {
-    int i;
+    int i, seen = 0;
     uint16_t next_seq = s->seq + 1;
-    RTPPacket *pkt = s->queue;
 
-    if (!pkt || pkt->seq == next_seq)
+    if (!s->queue_len || has_next_packet(s))
         return 0;
 
     *missing_mask = 0;
-    for (i = 1; i <= 16; i++) {
+    /* stop after the last queued packet */
+    for (i = 1; i <= 16 && seen < s->queue_len; i++) {
         uint16_t missing_seq = next_seq + i;
-        while (pkt) {
-            int16_t diff = pkt->seq - missing_seq;
-            if (diff >= 0)
-                break;
-            pkt = pkt->next;
-        }
-        if (!pkt)
-            break;
-        if (pkt->seq == missing_seq)
+        RTPPacket *slot = get_slot(s, missing_seq);
+        if (slot->queued && slot->seq == missing_seq) {
+            seen++;
             continue;
+        }
         *missing_mask |= 1 << (i - 1);
     }
 
@@ -506,6 +523,27 @@ int ff_rtp_send_rtcp_feedback(RTPDemuxContext *s, URLContext *fd,
  * open a new RTP parse context for stream 'st'. 'st' can be NULL for
  * MPEG2-TS streams.
  */
+static int alloc_slots(RTPDemuxContext *s, int size)
+{
+    RTPPacket *slots;
+    int nb_slots = 1;
+
+    /* queued packets must fit in half of the sequence number space */
+    while (nb_slots < size && nb_slots < 16384)
+        nb_slots <<= 1;
+    if (nb_slots <= s->nb_slots)
+        return 0;
+
+    slots = av_mallocz_array(nb_slots, sizeof(*slots));
+    if (!slots)
+        return AVERROR(ENOMEM);
+    ff_rtp_reset_packet_queue(s);
+    av_free(s->slots);
+    s->slots    = slots;
+    s->nb_slots = nb_slots;
+    return 0;
+}
+
 RTPDemuxContext *ff_rtp_parse_open(AVFormatContext *s1, AVStream *st,
                                    int payload_type, int queue_size)
 {
@@ -520,6 +558,13 @@ RTPDemuxContext *ff_rtp_parse_open(AVFormatContext *s1, AVStream *st,
     s->ic                  = s1;
     s->st                  = st;
     s->queue_size          = queue_size;
+    if (queue_size > 1) {
+        if (alloc_slots(s, queue_size) < 0) {
+            av_free(s);
+            return NULL;
+        }
+        s->queue_size = FFMIN(queue_size, s->nb_slots);
+    }
     rtp_init_statistics(&s->statistics, 0);
     if (st) {
         switch (st->codec->codec_id) {
@@ -545,6 +590,18 @@ void ff_rtp_parse_set_dynamic_protocol(RTPDemuxContext *s, PayloadContext *ctx,
     s->handler                  = handler;
 }
 
+void ff_rtp_parse_set_fec(RTPDemuxContext *s)
+{
+    if (s->queue_size <= 1) {
+        av_log(s->ic, AV_LOG_WARNING,
+               "FEC recovery requires packet reordering, disabling it\n");
+        return;
+    }
+    if (alloc_slots(s, RTP_FEC_HISTORY_SIZE) < 0)
+        return;
+    s->fec_enabled = 1;
+}
+
 void ff_rtp_parse_set_crypto(RTPDemuxContext *s, const char *suite,
                              const char *params)
 {
@@ -676,71 +733,221 @@ static int rtp_parse_packet_internal(RTPDemuxContext *s, AVPacket *pkt,
 
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s)
 {
-    while (s->queue) {
-        RTPPacket *next = s->queue->next;
-        av_freep(&s->queue->buf);
-        av_freep(&s->queue);
-        s->queue = next;
+    int i;
+
+    for (i = 0; i < s->nb_slots; i++) {
+        av_freep(&s->slots[i].buf);
+        s->slots[i].queued = 0;
     }
+    for (i = 0; i < RTP_FEC_MAX_PACKETS; i++)
+        av_freep(&s->fec[i].buf);
+    av_freep(&s->jump_buf);
     s->seq       = 0;
     s->queue_len = 0;
     s->prev_ret  = 0;
 }
 
-static void enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
+static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
 {
-    uint16_t seq   = AV_RB16(buf + 2);
-    RTPPacket **cur = &s->queue, *packet;
+    uint16_t seq  = AV_RB16(buf + 2);
+    RTPPacket *slot = get_slot(s, seq);
+
+    /* duplicate of a packet not returned yet */
+    if (slot->queued)
+        return AVERROR(EEXIST);
+
+    av_free(slot->buf);
+    slot->recvtime = av_gettime_relative();
+    slot->seq      = seq;
+    slot->len      = len;
+    slot->buf      = buf;
+    slot->queued   = 1;
+    s->queue_len++;
+    return 0;
+}
 
-    /* Find the correct place in the queue to insert the packet */
-    while (*cur) {
-        int16_t diff = seq - (*cur)->seq;
-        if (diff < 0)
-            break;
-        cur = &(*cur)->next;
-    }
+/* keep a copy of a packet returned directly, for FEC recovery */
+static void keep_packet(RTPDemuxContext *s, const uint8_t *buf, int len)
+{
+    RTPPacket *slot = get_slot(s, AV_RB16(buf + 2));
 
-    packet = av_mallocz(sizeof(*packet));
-    if (!packet)
+    if (slot->queued)
         return;
-    packet->recvtime = av_gettime_relative();
-    packet->seq      = seq;
-    packet->len      = len;
-    packet->buf      = buf;
-    packet->next     = *cur;
-    *cur = packet;
-    s->queue_len++;
+    av_free(slot->buf);
+    slot->buf = av_memdup(buf, len);
+    slot->seq = AV_RB16(buf + 2);
+    slot->len = slot->buf ? len : 0;
 }
 
-static int has_next_packet(RTPDemuxContext *s)
+/* All the packets queued before a jump in sequence numbers were returned,
+ * restart the queue from the packet that caused the jump. */
+static void restart_packet_queue(RTPDemuxContext *s)
 {
-    return s->queue && s->queue->seq == (uint16_t) (s->seq + 1);
+    uint8_t *buf = s->jump_buf;
+    int len      = s->jump_len;
+
+    s->jump_buf = NULL;
+    ff_rtp_reset_packet_queue(s);
+    s->seq = AV_RB16(buf + 2) - 1;
+    /* do not wait for a second packet to accept the jump */
+    rtp_init_sequence(&s->statistics, AV_RB16(buf + 2));
+    enqueue_packet(s, buf, len);
+}
+
+static RTPPacket *first_queued_packet(RTPDemuxContext *s)
+{
+    int i;
+
+    if (!s->queue_len)
+        return NULL;
+    for (i = 1; i <= s->nb_slots; i++) {
+        RTPPacket *slot = get_slot(s, s->seq + i);
+        if (slot->queued)
+            return slot;
+    }
+    return NULL;
 }
 
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
 {
-    return s->queue ? s->queue->recvtime : 0;
+    RTPPacket *first = first_queued_packet(s);
+    return first ? first->recvtime : 0;
+}
+
+/**
+ * Rebuild the packet seq from a FEC packet and the other packets it
+ * protects, following SMPTE 2022-1.
+ * @return 1 if the packet was recovered, 0 otherwise
+ */
+static int fec_rebuild_packet(RTPDemuxContext *s, const RTPPacket *fec,
+                              uint16_t seq)
+{
+    const uint8_t *hdr = fec->buf + 12;
+    uint16_t snbase    = AV_RB16(hdr);
+    int len            = AV_RB16(hdr + 2);
+    int payload_type   = hdr[4] & 0x7f;
+    uint32_t timestamp = AV_RB32(hdr + 8);
+    int offset = hdr[13], na = hdr[14];
+    int size   = fec->len - 12 - RTP_FEC_HEADER_SIZE;
+    const RTPPacket *ref = NULL;
+    uint8_t *buf;
+    int i, j;
+
+    buf = av_malloc(12 + size);
+    if (!buf)
+        return 0;
+    memcpy(buf + 12, hdr + RTP_FEC_HEADER_SIZE, size);
+
+    for (i = 0; i < na; i++) {
+        uint16_t cur = snbase + i * offset;
+        const RTPPacket *p;
+        if (cur == seq)
+            continue;
+        /* every other packet of the group is needed */
+        if (!(p = find_packet(s, cur)) || p->len < 12)
+            goto fail;
+        len          ^= p->len - 12;
+        payload_type ^= p->buf[1] & 0x7f;
+        timestamp    ^= AV_RB32(p->buf + 4);
+        for (j = 0; j < FFMIN(p->len - 12, size); j++)
+            buf[12 + j] ^= p->buf[12 + j];
+        ref = p;
+    }
+    if (!ref || len > size)
+        goto fail;
+
+    buf[0] = RTP_VERSION << 6;
+    buf[1] = payload_type;
+    AV_WB16(buf + 2, seq);
+    AV_WB32(buf + 4, timestamp);
+    memcpy(buf + 8, ref->buf + 8, 4);
+    if (enqueue_packet(s, buf, 12 + len) < 0)
+        goto fail;
+    s->nb_recovered++;
+    return 1;
+fail:
+    av_free(buf);
+    return 0;
+}
+
+/**
+ * Try to recover the packet seq, not returned yet, from the FEC packets.
+ * @return 1 if the packet was recovered, 0 otherwise
+ */
+static int fec_recover_packet(RTPDemuxContext *s, uint16_t seq)
+{
+    int i;
+
+    if (!s->fec_enabled || (int16_t)(seq - s->seq) <= 0 ||
+        find_packet(s, seq))
+        return 0;
+
+    for (i = 0; i < RTP_FEC_MAX_PACKETS; i++) {
+        const RTPPacket *fec = &s->fec[i];
+        uint16_t diff;
+        int offset, na;
+
+        if (!fec->buf)
+            continue;
+        offset = fec->buf[12 + 13];
+        na     = fec->buf[12 + 14];
+        diff   = seq - AV_RB16(fec->buf + 12);
+        if (!offset || diff % offset || diff / offset >= na)
+            continue;
+        if (fec_rebuild_packet(s, fec, seq))
+            return 1;
+    }
+    return 0;
+}
+
+/* store a FEC packet and recover what it allows to */
+static void fec_add_packet(RTPDemuxContext *s, const uint8_t *buf, int len)
+{
+    RTPPacket *fec = &s->fec[s->fec_next];
+    int i, offset, na;
+
+    /* only XOR FEC packets are supported */
+    if (len < 12 + RTP_FEC_HEADER_SIZE || (buf[12 + 12] & 0x38))
+        return;
+
+    av_free(fec->buf);
+    fec->buf = av_memdup(buf, len);
+    if (!fec->buf)
+        return;
+    fec->len    = len;
+    fec->seq    = AV_RB16(buf + 2);
+    s->fec_next = (s->fec_next + 1) % RTP_FEC_MAX_PACKETS;
+
+    offset = buf[12 + 13];
+    na     = buf[12 + 14];
+    for (i = 0; i < na; i++)
+        fec_recover_packet(s, AV_RB16(buf + 12) + i * offset);
 }
 
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
-    RTPPacket *next;
+    RTPPacket *first;
 
     if (s->queue_len <= 0)
         return -1;
 
-    if (!has_next_packet(s))
+    if (!has_next_packet(s) && !fec_recover_packet(s, s->seq + 1)) {
+        first = first_queued_packet(s);
+        s->nb_lost += (uint16_t) (first->seq - s->seq - 1);
         av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
-               "RTP: missed %d packets\n", s->queue->seq - s->seq - 1);
+               "RTP: missed %d packets\n", (uint16_t) (first->seq - s->seq - 1));
+    } else
+        first = get_slot(s, s->seq + 1);
 
     /* Parse the first packet in the queue, and dequeue it */
-    rv   = rtp_parse_packet_internal(s, pkt, s->queue->buf, s->queue->len);
-    next = s->queue->next;
-    av_freep(&s->queue->buf);
-    av_freep(&s->queue);
-    s->queue = next;
+    rv = rtp_parse_packet_internal(s, pkt, first->buf, first->len);
+    first->queued = 0;
     s->queue_len--;
+    if (!s->fec_enabled)
+        av_freep(&first->buf);
+    if (!s->queue_len && s->jump_buf)
+        restart_packet_queue(s);
     return rv;
 }
 
@@ -780,6 +987,13 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         return rtcp_parse_packet(s, buf, len);
     }
 
+    if (s->fec_enabled && (buf[1] & 0x7f) != s->payload_type) {
+        fec_add_packet(s, buf, len);
+        if (has_next_packet(s))
+            return rtp_parse_queued_packet(s, pkt);
+        return -1;
+    }
+
     if (s->st) {
         int64_t received = av_gettime_relative();
         uint32_t arrival_ts = av_rescale_q(received, AV_TIME_BASE_Q,
@@ -790,28 +1004,60 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         rtcp_update_jitter(&s->statistics, timestamp, arrival_ts);
     }
 
-    if ((s->seq == 0 && !s->queue) || s->queue_size <= 1) {
+    if (s->jump_buf) {
+        /* the packets queued before the jump were not all read */
+        av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
+               "RTP: dropping %d queued packets\n", s->queue_len);
+        restart_packet_queue(s);
+    }
+
+    if ((s->seq == 0 && !s->queue_len) || s->queue_size <= 1) {
         /* First packet, or no reordering */
+        if (s->fec_enabled)
+            keep_packet(s, buf, len);
         return rtp_parse_packet_internal(s, pkt, buf, len);
     } else {
         uint16_t seq = AV_RB16(buf + 2);
         int16_t diff = seq - s->seq;
-        if (diff < 0) {
+        if (diff <= 0) {
+            /* Already returned: a duplicate, or a packet that was recovered
+             * from the FEC packets before it arrived */
+            if (find_packet(s, seq))
+                return -1;
             /* Packet older than the previously emitted one, drop */
             av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
                    "RTP: dropping old packet received too late\n");
+            s->nb_late++;
             return -1;
-        } else if (diff <= 1) {
+        } else if (diff == 1) {
             /* Correct packet */
+            if (s->fec_enabled)
+                keep_packet(s, buf, len);
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
+        } else if (diff >= s->nb_slots) {
+            /* Too far ahead to be queued, restart from this packet once
+             * the queued ones are returned */
+            av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
+                   "RTP: sequence number jump of %d packets\n", diff);
+            if (!s->queue_len) {
+                ff_rtp_reset_packet_queue(s);
+                rtp_init_sequence(&s->statistics, seq);
+                return rtp_parse_packet_internal(s, pkt, buf, len);
+            }
+            s->jump_buf = buf;
+            s->jump_len = len;
+            *bufptr = NULL;
+            return rtp_parse_queued_packet(s, pkt);
         } else {
             /* Still missing some packet, enqueue this one. */
-            enqueue_packet(s, buf, len);
+            if (enqueue_packet(s, buf, len) < 0)
+                return -1;
             *bufptr = NULL;
             /* Return the first enqueued packet if the queue is full,
              * even if we're missing something */
-            if (s->queue_len >= s->queue_size)
+            if (s->queue_len >= s->queue_size ||
+                fec_recover_packet(s, s->seq + 1))
                 return rtp_parse_queued_packet(s, pkt);
             return -1;
         }
@@ -835,14 +1081,22 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
         return -1;
     rv = rtp_parse_one_packet(s, pkt, bufptr, len);
     s->prev_ret = rv;
-    while (rv == AVERROR(EAGAIN) && has_next_packet(s))
+    while (rv == AVERROR(EAGAIN) && (has_next_packet(s) || s->jump_buf))
         rv = rtp_parse_queued_packet(s, pkt);
-    return rv ? rv : has_next_packet(s);
+    /* while flushing the queue before a jump, return the packets even if
+     * some are missing */
+    return rv ? rv : has_next_packet(s) || s->jump_buf;
 }
 
 void ff_rtp_parse_close(RTPDemuxContext *s)
 {
+    if (s->nb_lost || s->nb_recovered || s->nb_late)
+        av_log(s->st ? s->st->codec : NULL,
+               s->nb_lost ? AV_LOG_INFO : AV_LOG_VERBOSE,
+               "RTP: %u packets lost, %u recovered by FEC, %u received too late\n",
+               s->nb_lost, s->nb_recovered, s->nb_late);
     ff_rtp_reset_packet_queue(s);
+    av_freep(&s->slots);
     ff_srtp_free(&s->srtp);
     av_free(s);
 }
@@ -899,3 +1153,150 @@ int ff_rtp_finalize_packet(AVPacket *pkt, AVIOContext **dyn_buf, int stream_idx)
     }
     return pkt->size;
 }
+
+#ifdef TEST
+#include <stdio.h>
+
+#define NB_PACKETS  100
+#define JUMP_INDEX   80
+#define BASE_SEQ  65520
+#define FEC_GROUP     4
+
+static uint16_t packet_seq(int i)
+{
+    return BASE_SEQ + i + (i >= JUMP_INDEX ? 20000 : 0);
+}
+
+static int make_packet(uint8_t *buf, int i)
+{
+    int j, len = 12 + 2 + 8 + i % 5;
+
+    buf[0] = RTP_VERSION << 6;
+    buf[1] = 96;
+    AV_WB16(buf + 2, packet_seq(i));
+    AV_WB32(buf + 4, i / FEC_GROUP * 3000);
+    AV_WB32(buf + 8, 0x12345678);
+    AV_WB16(buf + 12, i);
+    for (j = 14; j < len; j++)
+        buf[j] = i * 7 + j;
+    return len;
+}
+
+/* SMPTE 2022-1 row FEC packet protecting the packets first to first + 3 */
+static int make_fec_packet(uint8_t *buf, int first, int fec_seq)
+{
+    uint8_t pkt[64];
+    int i, j, len, size = 0;
+
+    memset(buf, 0, 12 + RTP_FEC_HEADER_SIZE + 64);
+    buf[0] = RTP_VERSION << 6;
+    buf[1] = 97;
+    AV_WB16(buf + 2, fec_seq);
+    AV_WB32(buf + 8, 0x12345678);
+    AV_WB16(buf + 12, packet_seq(first));
+    for (i = first; i < first + FEC_GROUP; i++) {
+        len = make_packet(pkt, i);
+        AV_WB16(buf + 14, AV_RB16(buf + 14) ^ (len - 12));
+        buf[16] ^= pkt[1] & 0x7f;
+        AV_WB32(buf + 20, AV_RB32(buf + 20) ^ AV_RB32(pkt + 4));
+        for (j = 12; j < len; j++)
+            buf[12 + RTP_FEC_HEADER_SIZE + j - 12] ^= pkt[j];
+        size = FFMAX(size, len - 12);
+    }
+    buf[12 + 13] = 1;
+    buf[12 + 14] = FEC_GROUP;
+    return 12 + RTP_FEC_HEADER_SIZE + size;
+}
+
+static int last_index = -1, nb_out, nb_disorder;
+
+static void print_packet(AVPacket *pkt)
+{
+    int index = AV_RB16(pkt->data);
+
+    if (index <= last_index)
+        nb_disorder++;
+    last_index = index;
+    printf("%3d%s", index, ++nb_out % 16 ? "" : "\n");
+    av_packet_unref(pkt);
+}
+
+static void feed(RTPDemuxContext *s, const uint8_t *data, int len)
+{
+    AVPacket pkt = { 0 };
+    uint8_t *buf = av_memdup(data, len);
+    int ret;
+
+    if (!buf)
+        return;
+    av_init_packet(&pkt);
+    ret = ff_rtp_parse_packet(s, &pkt, &buf, len);
+    while (ret >= 0) {
+        print_packet(&pkt);
+        if (!ret)
+            break;
+        ret = ff_rtp_parse_packet(s, &pkt, NULL, 0);
+    }
+    av_free(buf);
+}
+
+/*
+ * Replay a stream with losses, reordering, duplicates, a late packet and
+ * a sequence number jump, and check that the packets are returned in
+ * order, the losses recovered from the FEC packets where possible, and
+ * the packets queued before the jump returned before it.
+ */
+int main(void)
+{
+    AVFormatContext *ic = avformat_alloc_context();
+    AVStream *st;
+    RTPDemuxContext *s;
+    uint8_t buf[256];
+    int i, order[NB_PACKETS], fec_seq = 0;
+
+    av_log_set_level(AV_LOG_QUIET);
+    if (!ic || !(st = avformat_new_stream(ic, NULL)))
+        return 1;
+    st->time_base = (AVRational){ 1, 90000 };
+    s = ff_rtp_parse_open(ic, st, 96, 10);
+    if (!s)
+        return 1;
+    ff_rtp_parse_set_fec(s);
+
+    for (i = 0; i < NB_PACKETS; i++)
+        order[i] = i;
+    for (i = 3; i < NB_PACKETS - 1; i += 7)
+        FFSWAP(int, order[i], order[i + 1]);
+
+    for (i = 0; i < NB_PACKETS; i++) {
+        int index = order[i];
+
+        /* lost packets, recoverable before the jump except 77, as the FEC
+         * packet of its group is lost as well */
+        if (index % 11 != 5 && index != 77)
+            feed(s, buf, make_packet(buf, index));
+        if (index % 13 == 0)
+            feed(s, buf, make_packet(buf, index));
+        if (index == 40)
+            feed(s, buf, make_packet(buf, 30));
+        if (index < JUMP_INDEX && index % FEC_GROUP == FEC_GROUP - 1 &&
+            index != 79)
+            feed(s, buf, make_fec_packet(buf, index - FEC_GROUP + 1, fec_seq++));
+    }
+    while (s->queue_len) {
+        AVPacket pkt = { 0 };
+        av_init_packet(&pkt);
+        if (ff_rtp_parse_packet(s, &pkt, NULL, 0) >= 0)
+            print_packet(&pkt);
+    }
+
+    printf("%s%d packets returned, %d out of order\n",
+           nb_out % 16 ? "\n" : "", nb_out, nb_disorder);
+    printf("lost %u, recovered %u, late %u\n",
+           s->nb_lost, s->nb_recovered, s->nb_late);
+
+    ff_rtp_parse_close(s);
+    avformat_free_context(ic);
+    return 0;
+}
+#endif /* TEST */
@@ -37,6 +37,11 @@ typedef struct RTPDynamicProtocolHandler RTPDynamicProtocolHandler;
 
 #define RTP_REORDER_QUEUE_DEFAULT_SIZE 10
 
+/** Number of received packets kept for FEC recovery */
+#define RTP_FEC_HISTORY_SIZE 1024
+/** Number of FEC packets kept */
+#define RTP_FEC_MAX_PACKETS 64
+
 #define RTP_NOTS_VALUE ((uint32_t)-1)
 
 typedef struct RTPDemuxContext RTPDemuxContext;
@@ -46,6 +51,7 @@ void ff_rtp_parse_set_dynamic_protocol(RTPDemuxContext *s, PayloadContext *ctx,
                                        RTPDynamicProtocolHandler *handler);
 void ff_rtp_parse_set_crypto(RTPDemuxContext *s, const char *suite,
                              const char *params);
+void ff_rtp_parse_set_fec(RTPDemuxContext *s);
 int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
                         uint8_t **buf, int len);
 void ff_rtp_parse_close(RTPDemuxContext *s);
@@ -143,7 +149,7 @@ typedef struct RTPPacket {
     uint8_t *buf;
     int len;
     int64_t recvtime;
-    struct RTPPacket *next;
+    int queued;       ///< not returned yet, else only kept for FEC recovery
 } RTPPacket;
 
 struct RTPDemuxContext {
@@ -169,9 +175,24 @@ struct RTPDemuxContext {
 
     /** Fields for packet reordering @{ */
     int prev_ret;     ///< The return value of the actual parsing of the previous packet
-    RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
-    int queue_len;    ///< The number of packets in queue
+    RTPPacket *slots; ///< Received packets, indexed by sequence number modulo nb_slots
+    int nb_slots;     ///< The number of slots, a power of two
+    int queue_len;    ///< The number of packets in slots not yet returned
     int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    uint8_t *jump_buf; ///< Packet that jumped in sequence numbers, returned once the queue is flushed
+    int jump_len;
+    /*@}*/
+
+    /** Fields for SMPTE 2022-1 FEC recovery @{ */
+    int fec_enabled;
+    RTPPacket fec[RTP_FEC_MAX_PACKETS]; ///< The most recent FEC packets
+    int fec_next;     ///< Index of fec to store the next FEC packet into
+    /*@}*/
+
+    /** Reception statistics @{ */
+    unsigned nb_lost;      ///< Packets skipped as missing
+    unsigned nb_recovered; ///< Packets rebuilt from FEC packets
+    unsigned nb_late;      ///< Packets dropped as received too late
     /*@}*/
 
     /* rtcp sender statistics receive */
@@ -26,7 +26,9 @@
 
 #include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
+#include "libavutil/time.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "rtp.h"
@@ -58,6 +60,16 @@ typedef struct RTPContext {
     int dscp;
     char *sources;
     char *block;
+    int fec;
+    URLContext *fec_hd[2];
+    int fec_fd[2];
+    int batch_size;
+    int batch_timeout;
+    uint8_t *batch_buf;
+    int *batch_sizes;
+    int batch_len, nb_batch;
+    uint32_t batch_timestamp;  ///< RTP timestamp of the last batched packet
+    int64_t batch_start;       ///< time the oldest pending packet was batched
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -75,6 +87,9 @@ static const AVOption options[] = {
     { "dscp",               "DSCP class",                                                       OFFSET(dscp),            AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "sources",            "Source list",                                                      OFFSET(sources),         AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "fec",                "Receive SMPTE 2022-1 FEC packets",                                 OFFSET(fec),             AV_OPT_TYPE_INT,    { .i64 =  0 },     0, 1,       .flags = D },
+    { "batch_size",         "Number of RTP packets sent with a single system call",             OFFSET(batch_size),      AV_OPT_TYPE_INT,    { .i64 =  0 },     0, 1024,    .flags = E },
+    { "batch_timeout",      "Maximum time a packet is held for batching (in microseconds)",     OFFSET(batch_timeout),   AV_OPT_TYPE_INT,    { .i64 = 1000 },   0, INT_MAX, .flags = E },
     { NULL }
 };
 
@@ -304,6 +319,9 @@ static void rtp_parse_addr_list(URLContext *h, char *buf,
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
  *         'dscp=n'           : set DSCP value to n (QoS)
+ *         'batch_size=n'     : send up to n RTP packets per system call
+ *         'batch_timeout=n'  : hold batched packets for at most n microseconds
+ *         'fec=0/1'          : also receive FEC packets on the rtp port + 2 and + 4
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -324,6 +342,8 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     const char *p;
     int i, max_retry_count = 3;
 
+    s->fec_fd[0] = s->fec_fd[1] = -1;
+
     av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &rtp_port,
                  path, sizeof(path), uri);
     /* extract parameters */
@@ -359,6 +379,15 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "dscp", p)) {
             s->dscp = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "fec", p)) {
+            s->fec = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_timeout", p)) {
+            s->batch_timeout = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
 
@@ -411,11 +440,36 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     s->rtp_fd = ffurl_get_file_handle(s->rtp_hd);
     s->rtcp_fd = ffurl_get_file_handle(s->rtcp_hd);
 
+    /* SMPTE 2022-1 sends the column and row FEC packets to the ports
+     * following the RTCP one */
+    if (s->fec && (flags & AVIO_FLAG_READ)) {
+        for (i = 0; i < 2; i++) {
+            build_udp_url(s, buf, sizeof(buf),
+                          hostname, rtp_port + 2 * (i + 1),
+                          s->local_rtpport + 2 * (i + 1), sources, block);
+            if (ffurl_open(&s->fec_hd[i], buf, AVIO_FLAG_READ,
+                           &h->interrupt_callback, NULL) < 0)
+                goto fail;
+            s->fec_fd[i] = ffurl_get_file_handle(s->fec_hd[i]);
+        }
+    }
+
     h->max_packet_size = s->rtp_hd->max_packet_size;
     h->is_streamed = 1;
+
+    if (s->batch_size > 1 && (flags & AVIO_FLAG_WRITE) && !s->write_to_source) {
+        s->batch_buf   = av_malloc_array(s->batch_size, h->max_packet_size);
+        s->batch_sizes = av_malloc_array(s->batch_size, sizeof(*s->batch_sizes));
+        if (!s->batch_buf || !s->batch_sizes)
+            goto fail;
+    }
     return 0;
 
  fail:
+    ffurl_closep(&s->fec_hd[0]);
+    ffurl_closep(&s->fec_hd[1]);
+    av_freep(&s->batch_buf);
+    av_freep(&s->batch_sizes);
     if (s->rtp_hd)
         ffurl_close(s->rtp_hd);
     if (s->rtcp_hd)
@@ -427,18 +481,23 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
 {
     RTPContext *s = h->priv_data;
     int len, n, i;
-    struct pollfd p[2] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0}};
+    struct pollfd p[4] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0},
+                          {s->fec_fd[0], POLLIN, 0}, {s->fec_fd[1], POLLIN, 0}};
     int poll_delay = h->flags & AVIO_FLAG_NONBLOCK ? 0 : 100;
-    struct sockaddr_storage *addrs[2] = { &s->last_rtp_source, &s->last_rtcp_source };
-    socklen_t *addr_lens[2] = { &s->last_rtp_source_len, &s->last_rtcp_source_len };
+    struct sockaddr_storage fec_source;
+    socklen_t fec_source_len;
+    struct sockaddr_storage *addrs[4] = { &s->last_rtp_source, &s->last_rtcp_source,
+                                          &fec_source, &fec_source };
+    socklen_t *addr_lens[4] = { &s->last_rtp_source_len, &s->last_rtcp_source_len,
+                                &fec_source_len, &fec_source_len };
 
     for(;;) {
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
-        n = poll(p, 2, poll_delay);
+        n = poll(p, 4, poll_delay);
         if (n > 0) {
-            /* first try RTCP, then RTP */
-            for (i = 1; i >= 0; i--) {
+            /* first try FEC and RTCP, then RTP */
+            for (i = 3; i >= 0; i--) {
                 if (!(p[i].revents & POLLIN))
                     continue;
                 *addr_lens[i] = sizeof(*addrs[i]);
@@ -465,6 +524,80 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
     return len;
 }
 
+/* Send the pending packets. Those that could not be sent are kept, so
+ * that the caller can retry on AVERROR(EAGAIN). */
+static int rtp_flush_batch(URLContext *h)
+{
+    RTPContext *s = h->priv_data;
+    int i, ret, len = 0;
+
+    if (!s->nb_batch)
+        return 0;
+    ret = ff_udp_write_batch(s->rtp_hd, s->batch_buf, s->batch_sizes,
+                             s->nb_batch);
+    if (ret == AVERROR(EAGAIN))
+        return ret;
+    if (ret < 0) {
+        s->nb_batch = s->batch_len = 0;
+        return ret;
+    }
+
+    for (i = 0; i < ret; i++)
+        len += s->batch_sizes[i];
+    s->nb_batch  -= ret;
+    s->batch_len -= len;
+    if (!s->nb_batch)
+        return 0;
+    memmove(s->batch_buf, s->batch_buf + len, s->batch_len);
+    memmove(s->batch_sizes, s->batch_sizes + ret,
+            s->nb_batch * sizeof(*s->batch_sizes));
+    s->batch_start = av_gettime_relative();
+    return AVERROR(EAGAIN);
+}
+
+/* Packets of a frame are grouped and sent together once the frame is
+ * complete: when the marker bit is set or a new timestamp starts. The
+ * batch is also sent when it is full or when its oldest packet has waited
+ * for longer than batch_timeout. If the packet cannot be queued,
+ * AVERROR(EAGAIN) is returned and it must be written again. */
+static int rtp_write_batch(URLContext *h, const uint8_t *buf, int size)
+{
+    RTPContext *s = h->priv_data;
+    int64_t now = av_gettime_relative();
+    int ret;
+
+    if (size > h->max_packet_size) {
+        /* does not fit in a slot, send it on its own after the others */
+        if ((ret = rtp_flush_batch(h)) < 0)
+            return ret;
+        return ffurl_write(s->rtp_hd, buf, size);
+    }
+
+    if (s->nb_batch &&
+        (s->nb_batch == s->batch_size || size < 8 ||
+         AV_RB32(buf + 4) != s->batch_timestamp ||
+         now - s->batch_start >= s->batch_timeout)) {
+        ret = rtp_flush_batch(h);
+        /* on EAGAIN, the packet can still be queued if there is room */
+        if (ret < 0 && (ret != AVERROR(EAGAIN) || s->nb_batch == s->batch_size))
+            return ret;
+    }
+
+    if (!s->nb_batch)
+        s->batch_start = now;
+    memcpy(s->batch_buf + s->batch_len, buf, size);
+    s->batch_sizes[s->nb_batch++] = size;
+    s->batch_len += size;
+    s->batch_timestamp = size >= 8 ? AV_RB32(buf + 4) : 0;
+
+    if (buf[1] & 0x80) {
+        ret = rtp_flush_batch(h);
+        if (ret < 0 && ret != AVERROR(EAGAIN))
+            return ret;
+    }
+    return size;
+}
+
 static int rtp_write(URLContext *h, const uint8_t *buf, int size)
 {
     RTPContext *s = h->priv_data;
@@ -531,9 +664,13 @@ static int rtp_write(URLContext *h, const uint8_t *buf, int size)
 
     if (RTP_PT_IS_RTCP(buf[1])) {
         /* RTCP payload type */
+        if ((ret = rtp_flush_batch(h)) < 0)
+            return ret;
         hd = s->rtcp_hd;
     } else {
         /* RTP payload type */
+        if (s->batch_buf)
+            return rtp_write_batch(h, buf, size);
         hd = s->rtp_hd;
     }
 
@@ -546,6 +683,12 @@ static int rtp_close(URLContext *h)
     RTPContext *s = h->priv_data;
     int i;
 
+    /* give a non-blocking socket some time to take the last packets */
+    for (i = 0; i < 10 && rtp_flush_batch(h) == AVERROR(EAGAIN); i++)
+        ff_network_wait_fd(s->rtp_fd, 1);
+    av_freep(&s->batch_buf);
+    av_freep(&s->batch_sizes);
+
     for (i = 0; i < s->nb_ssm_include_addrs; i++)
         av_freep(&s->ssm_include_addrs[i]);
     av_freep(&s->ssm_include_addrs);
@@ -555,6 +698,8 @@ static int rtp_close(URLContext *h)
 
     ffurl_close(s->rtp_hd);
     ffurl_close(s->rtcp_hd);
+    ffurl_closep(&s->fec_hd[0]);
+    ffurl_closep(&s->fec_hd[1]);
     return 0;
 }
 
@@ -592,12 +737,18 @@ static int rtp_get_multi_file_handle(URLContext *h, int **handles,
                                      int *numhandles)
 {
     RTPContext *s = h->priv_data;
-    int *hs       = *handles = av_malloc(sizeof(**handles) * 2);
+    int *hs       = *handles = av_malloc(sizeof(**handles) * 4);
     if (!hs)
         return AVERROR(ENOMEM);
     hs[0] = s->rtp_fd;
     hs[1] = s->rtcp_fd;
     *numhandles = 2;
+    /* the FEC packets are returned by rtp_read() as well */
+    if (s->fec_hd[0]) {
+        hs[2] = s->fec_fd[0];
+        hs[3] = s->fec_fd[1];
+        *numhandles = 4;
+    }
     return 0;
 }
 
@@ -104,6 +104,7 @@ static const AVOption sdp_options[] = {
     RTSP_FLAG_OPTS("sdp_flags", "SDP flags"),
     { "custom_io", "use custom I/O", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_CUSTOM_IO}, 0, 0, DEC, "rtsp_flags" },
     { "rtcp_to_source", "send RTCP packets to the source address of received packets", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_RTCP_TO_SOURCE}, 0, 0, DEC, "rtsp_flags" },
+    { "fec", "recover lost packets from SMPTE 2022-1 FEC streams", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_FEC}, 0, 0, DEC, "rtsp_flags" },
     RTSP_MEDIATYPE_OPTS("allowed_media_types", "set media types to accept from the server"),
     COMMON_OPTS(),
     { NULL },
@@ -111,6 +112,7 @@ static const AVOption sdp_options[] = {
 
 static const AVOption rtp_options[] = {
     RTSP_FLAG_OPTS("rtp_flags", "set RTP flags"),
+    { "fec", "recover lost packets from SMPTE 2022-1 FEC streams", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_FEC}, 0, 0, DEC, "rtsp_flags" },
     COMMON_OPTS(),
     { NULL },
 };
@@ -706,7 +708,8 @@ int ff_sdp_parse(AVFormatContext *s, const char *content)
         av_freep(&s1->default_exclude_source_addrs[i]);
     av_freep(&s1->default_exclude_source_addrs);
 
-    rt->p = av_malloc_array(rt->nb_rtsp_streams + 1, sizeof(struct pollfd) * 2);
+    /* RTP and RTCP, plus two FEC ports per stream, and the RTSP connection */
+    rt->p = av_malloc_array(rt->nb_rtsp_streams * 4 + 1, sizeof(struct pollfd));
     if (!rt->p) return AVERROR(ENOMEM);
     return 0;
 }
@@ -833,6 +836,8 @@ int ff_rtsp_open_transport_ctx(AVFormatContext *s, RTSPStream *rtsp_st)
             ff_rtp_parse_set_crypto(rtsp_st->transport_priv,
                                     rtsp_st->crypto_suite,
                                     rtsp_st->crypto_params);
+        if (rt->rtsp_flags & RTSP_FLAG_FEC)
+            ff_rtp_parse_set_fec(rtsp_st->transport_priv);
     }
 
     return 0;
@@ -1931,7 +1936,7 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                     av_log(s, AV_LOG_ERROR, "Unable to recover rtp ports\n");
                     return ret;
                 }
-                if (fdsnum != 2) {
+                if (fdsnum != 2 && fdsnum != 4) {
                     av_log(s, AV_LOG_ERROR,
                            "Number of fds %d not supported\n", fdsnum);
                     return AVERROR_INVALIDDATA;
@@ -1940,6 +1945,7 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                     p[max_p].fd       = fds[fdsidx];
                     p[max_p++].events = POLLIN;
                 }
+                rtsp_st->nb_rtp_fds = fdsnum;
                 av_freep(&fds);
             }
         }
@@ -1950,14 +1956,17 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
             for (i = 0; i < rt->nb_rtsp_streams; i++) {
                 rtsp_st = rt->rtsp_streams[i];
                 if (rtsp_st->rtp_handle) {
-                    if (p[j].revents & POLLIN || p[j+1].revents & POLLIN) {
+                    for (fdsidx = 0; fdsidx < rtsp_st->nb_rtp_fds; fdsidx++)
+                        if (p[j + fdsidx].revents & POLLIN)
+                            break;
+                    if (fdsidx < rtsp_st->nb_rtp_fds) {
                         ret = ffurl_read(rtsp_st->rtp_handle, buf, buf_size);
                         if (ret > 0) {
                             *prtsp_st = rtsp_st;
                             return ret;
                         }
                     }
-                    j+=2;
+                    j += rtsp_st->nb_rtp_fds;
                 }
             }
 #if CONFIG_RTSP_DEMUXER
@@ -2289,10 +2298,11 @@ static int sdp_read_header(AVFormatContext *s)
                         namebuf, sizeof(namebuf), NULL, 0, NI_NUMERICHOST);
             ff_url_join(url, sizeof(url), "rtp", NULL,
                         namebuf, rtsp_st->sdp_port,
-                        "?localport=%d&ttl=%d&connect=%d&write_to_source=%d",
+                        "?localport=%d&ttl=%d&connect=%d&write_to_source=%d&fec=%d",
                         rtsp_st->sdp_port, rtsp_st->sdp_ttl,
                         rt->rtsp_flags & RTSP_FLAG_FILTER_SRC ? 1 : 0,
-                        rt->rtsp_flags & RTSP_FLAG_RTCP_TO_SOURCE ? 1 : 0);
+                        rt->rtsp_flags & RTSP_FLAG_RTCP_TO_SOURCE ? 1 : 0,
+                        rt->rtsp_flags & RTSP_FLAG_FEC ? 1 : 0);
 
             append_source_addrs(url, sizeof(url), "sources",
                                 rtsp_st->nb_include_source_addrs,
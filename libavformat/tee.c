@@ -20,13 +20,25 @@
  */
 
 
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/threadmessage.h"
 #include "avformat.h"
 
 #define MAX_SLAVES 16
 
+typedef enum {
+    ON_OVERFLOW_BLOCK,
+    ON_OVERFLOW_DROP,
+} TeeOverflowPolicy;
+
 typedef struct {
     AVFormatContext *avf;
     AVBitStreamFilterContext **bsfs; ///< bitstream filters per stream
@@ -34,6 +46,19 @@ typedef struct {
     /** map from input to output streams indexes,
      * disabled output streams are set to -1 */
     int *stream_map;
+
+    /** packets waiting to be written by the slave thread,
+     * NULL if the slave is written from the caller's thread */
+    AVThreadMessageQueue *queue;
+    TeeOverflowPolicy on_overflow;
+    /** per output stream, set after a packet was dropped: skip until the
+     * next keyframe so that the slave does not get undecodable data */
+    uint8_t *wait_keyframe;
+    unsigned nb_dropped;
+#if HAVE_PTHREADS
+    pthread_t thread;
+    int thread_error;
+#endif
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -132,13 +157,153 @@ end:
     return ret;
 }
 
+static int filter_packet(void *log_ctx, AVPacket *pkt,
+                         AVFormatContext *fmt_ctx, AVBitStreamFilterContext *bsf_ctx)
+{
+    AVCodecContext *enc_ctx = fmt_ctx->streams[pkt->stream_index]->codec;
+    int ret = 0;
+
+    while (bsf_ctx) {
+        AVPacket new_pkt = *pkt;
+        ret = av_bitstream_filter_filter(bsf_ctx, enc_ctx, NULL,
+                                             &new_pkt.data, &new_pkt.size,
+                                             pkt->data, pkt->size,
+                                             pkt->flags & AV_PKT_FLAG_KEY);
+        if (ret == 0 && new_pkt.data != pkt->data) {
+            if ((ret = av_copy_packet(&new_pkt, pkt)) < 0)
+                break;
+            ret = 1;
+        }
+
+        if (ret > 0) {
+            av_free_packet(pkt);
+            new_pkt.buf = av_buffer_create(new_pkt.data, new_pkt.size,
+                                           av_buffer_default_free, NULL, 0);
+            if (!new_pkt.buf)
+                break;
+        }
+        if (ret < 0) {
+            av_log(log_ctx, AV_LOG_ERROR,
+                "Failed to filter bitstream with filter %s for stream %d in file '%s' with codec %s\n",
+                bsf_ctx->filter->name, pkt->stream_index, fmt_ctx->filename,
+                avcodec_get_name(enc_ctx->codec_id));
+        }
+        *pkt = new_pkt;
+
+        bsf_ctx = bsf_ctx->next;
+    }
+
+    return ret;
+}
+
+/**
+ * Apply the bitstream filters and write a packet to a slave muxer.
+ * pkt must already use the slave's stream index and time base.
+ */
+static int write_slave_packet(TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+
+    filter_packet(avf2, pkt, avf2, tee_slave->bsfs[pkt->stream_index]);
+    return av_interleaved_write_frame(avf2, pkt);
+}
+
+#if HAVE_PTHREADS
+static void *slave_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    AVPacket pkt;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(tee_slave->queue, &pkt, 0);
+        if (ret < 0)
+            break;
+        ret = write_slave_packet(tee_slave, &pkt);
+        av_free_packet(&pkt);
+        if (ret < 0) {
+            av_log(tee_slave->avf, AV_LOG_ERROR,
+                   "Error writing packet in slave thread: %s\n", av_err2str(ret));
+            tee_slave->thread_error = ret;
+            av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+static int start_slave_thread(void *log_ctx, TeeSlave *tee_slave, int queue_size)
+{
+#if HAVE_PTHREADS
+    int ret;
+
+    tee_slave->wait_keyframe = av_mallocz(tee_slave->avf->nb_streams);
+    if (!tee_slave->wait_keyframe)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, queue_size,
+                                        sizeof(AVPacket));
+    if (ret < 0)
+        goto fail;
+
+    ret = pthread_create(&tee_slave->thread, NULL, slave_thread, tee_slave);
+    if (ret) {
+        av_log(log_ctx, AV_LOG_ERROR, "pthread_create failed: %s\n",
+               av_err2str(AVERROR(ret)));
+        av_thread_message_queue_free(&tee_slave->queue);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+fail:
+    av_freep(&tee_slave->wait_keyframe);
+    return ret;
+#else
+    av_log(log_ctx, AV_LOG_WARNING, "queue_size requires pthreads, "
+           "slave '%s' will be written synchronously\n", tee_slave->avf->filename);
+    return 0;
+#endif
+}
+
+/**
+ * Wait for the slave thread to write all queued packets and terminate it.
+ * @return the first error that occurred in the slave thread
+ */
+static int stop_slave_thread(void *log_ctx, TeeSlave *tee_slave)
+{
+    int ret = 0;
+#if HAVE_PTHREADS
+    AVPacket pkt;
+
+    if (!tee_slave->queue)
+        return 0;
+
+    av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+    pthread_join(tee_slave->thread, NULL);
+    /* packets left over if the slave thread failed */
+    while (av_thread_message_queue_recv(tee_slave->queue, &pkt,
+                                        AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        av_free_packet(&pkt);
+    av_thread_message_queue_free(&tee_slave->queue);
+    ret = tee_slave->thread_error;
+
+    if (tee_slave->nb_dropped)
+        av_log(log_ctx, AV_LOG_WARNING, "Slave '%s': %u packets dropped "
+               "because the output could not keep up\n",
+               tee_slave->avf->filename, tee_slave->nb_dropped);
+#endif
+    return ret;
+}
+
 static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 {
     int i, ret;
     AVDictionary *options = NULL;
     AVDictionaryEntry *entry;
     char *filename;
-    char *format = NULL, *select = NULL;
+    char *format = NULL, *select = NULL, *queue_size = NULL, *on_overflow = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -156,6 +321,22 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 
     STEAL_OPTION("f", format);
     STEAL_OPTION("select", select);
+    STEAL_OPTION("queue_size", queue_size);
+    STEAL_OPTION("overflow", on_overflow);
+
+    if (on_overflow) {
+        if (!strcmp(on_overflow, "block")) {
+            tee_slave->on_overflow = ON_OVERFLOW_BLOCK;
+        } else if (!strcmp(on_overflow, "drop")) {
+            tee_slave->on_overflow = ON_OVERFLOW_DROP;
+        } else {
+            av_log(avf, AV_LOG_ERROR,
+                   "Invalid overflow policy '%s' for output '%s', "
+                   "must be 'block' or 'drop'\n", on_overflow, slave);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+    }
 
     ret = avformat_alloc_output_context2(&avf2, NULL, format, filename);
     if (ret < 0)
@@ -278,9 +459,24 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+    if (queue_size) {
+        char *tail;
+        long nb = strtol(queue_size, &tail, 10);
+        if (*tail || nb < 0 || nb > INT_MAX / sizeof(AVPacket)) {
+            av_log(avf, AV_LOG_ERROR, "Invalid queue size '%s' for output '%s'\n",
+                   queue_size, slave);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        if (nb && (ret = start_slave_thread(avf, tee_slave, nb)) < 0)
+            goto end;
+    }
+
 end:
     av_free(format);
     av_free(select);
+    av_free(queue_size);
+    av_free(on_overflow);
     av_dict_free(&options);
     return ret;
 }
@@ -302,8 +498,10 @@ static void close_slaves(AVFormatContext *avf)
                 bsf = bsf_next;
             }
         }
+        stop_slave_thread(avf, &tee->slaves[i]);
         av_freep(&tee->slaves[i].stream_map);
         av_freep(&tee->slaves[i].bsfs);
+        av_freep(&tee->slaves[i].wait_keyframe);
 
         avio_closep(&avf2->pb);
         avformat_free_context(avf2);
@@ -361,12 +559,12 @@ static int tee_write_header(AVFormatContext *avf)
     for (i = 0; i < nb_slaves; i++) {
         if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0)
             goto fail;
+        /* let close_slaves() release the slaves opened so far on failure */
+        tee->nb_slaves = i + 1;
         log_slave(&tee->slaves[i], avf, AV_LOG_VERBOSE);
         av_freep(&slaves[i]);
     }
 
-    tee->nb_slaves = nb_slaves;
-
     for (i = 0; i < avf->nb_streams; i++) {
         int j, mapped = 0;
         for (j = 0; j < tee->nb_slaves; j++)
@@ -384,45 +582,6 @@ fail:
     return ret;
 }
 
-static int filter_packet(void *log_ctx, AVPacket *pkt,
-                         AVFormatContext *fmt_ctx, AVBitStreamFilterContext *bsf_ctx)
-{
-    AVCodecContext *enc_ctx = fmt_ctx->streams[pkt->stream_index]->codec;
-    int ret = 0;
-
-    while (bsf_ctx) {
-        AVPacket new_pkt = *pkt;
-        ret = av_bitstream_filter_filter(bsf_ctx, enc_ctx, NULL,
-                                             &new_pkt.data, &new_pkt.size,
-                                             pkt->data, pkt->size,
-                                             pkt->flags & AV_PKT_FLAG_KEY);
-        if (ret == 0 && new_pkt.data != pkt->data) {
-            if ((ret = av_copy_packet(&new_pkt, pkt)) < 0)
-                break;
-            ret = 1;
-        }
-
-        if (ret > 0) {
-            av_free_packet(pkt);
-            new_pkt.buf = av_buffer_create(new_pkt.data, new_pkt.size,
-                                           av_buffer_default_free, NULL, 0);
-            if (!new_pkt.buf)
-                break;
-        }
-        if (ret < 0) {
-            av_log(log_ctx, AV_LOG_ERROR,
-                "Failed to filter bitstream with filter %s for stream %d in file '%s' with codec %s\n",
-                bsf_ctx->filter->name, pkt->stream_index, fmt_ctx->filename,
-                avcodec_get_name(enc_ctx->codec_id));
-        }
-        *pkt = new_pkt;
-
-        bsf_ctx = bsf_ctx->next;
-    }
-
-    return ret;
-}
-
 static int tee_write_trailer(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -432,6 +591,9 @@ static int tee_write_trailer(AVFormatContext *avf)
 
     for (i = 0; i < tee->nb_slaves; i++) {
         avf2 = tee->slaves[i].avf;
+        if ((ret = stop_slave_thread(avf, &tee->slaves[i])) < 0)
+            if (!ret_all)
+                ret_all = ret;
         if ((ret = av_write_trailer(avf2)) < 0)
             if (!ret_all)
                 ret_all = ret;
@@ -445,6 +607,39 @@ static int tee_write_trailer(AVFormatContext *avf)
     return ret_all;
 }
 
+/**
+ * Hand a packet over to a slave thread, applying the slave's overflow
+ * policy if its queue is full. Takes ownership of pkt.
+ */
+static int queue_slave_packet(TeeSlave *tee_slave, AVPacket *pkt)
+{
+    int s2 = pkt->stream_index;
+    int ret;
+
+    if (tee_slave->on_overflow == ON_OVERFLOW_BLOCK)
+        return av_thread_message_queue_send(tee_slave->queue, pkt, 0);
+
+    if (tee_slave->wait_keyframe[s2] && !(pkt->flags & AV_PKT_FLAG_KEY)) {
+        tee_slave->nb_dropped++;
+        av_free_packet(pkt);
+        return 0;
+    }
+    ret = av_thread_message_queue_send(tee_slave->queue, pkt,
+                                       AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret == AVERROR(EAGAIN)) {
+        if (!tee_slave->nb_dropped)
+            av_log(tee_slave->avf, AV_LOG_WARNING, "Slave '%s' is falling "
+                   "behind, dropping packets\n", tee_slave->avf->filename);
+        tee_slave->wait_keyframe[s2] = 1;
+        tee_slave->nb_dropped++;
+        av_free_packet(pkt);
+        return 0;
+    }
+    if (ret >= 0)
+        tee_slave->wait_keyframe[s2] = 0;
+    return ret;
+}
+
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
@@ -462,12 +657,13 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         if (s2 < 0)
             continue;
 
-        if ((ret = av_copy_packet(&pkt2, pkt)) < 0 ||
-            (ret = av_dup_packet(&pkt2))< 0)
-            if (!ret_all) {
+        /* the payload is shared by reference between all the slaves */
+        av_init_packet(&pkt2);
+        if ((ret = av_packet_ref(&pkt2, pkt)) < 0) {
+            if (!ret_all)
                 ret_all = ret;
-                continue;
-            }
+            continue;
+        }
         tb  = avf ->streams[s ]->time_base;
         tb2 = avf2->streams[s2]->time_base;
         pkt2.pts      = av_rescale_q(pkt->pts,      tb, tb2);
@@ -475,8 +671,14 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         pkt2.duration = av_rescale_q(pkt->duration, tb, tb2);
         pkt2.stream_index = s2;
 
-        filter_packet(avf2, &pkt2, avf2, tee->slaves[i].bsfs[s2]);
-        if ((ret = av_interleaved_write_frame(avf2, &pkt2)) < 0)
+        if (tee->slaves[i].queue) {
+            ret = queue_slave_packet(&tee->slaves[i], &pkt2);
+            if (ret < 0)
+                av_free_packet(&pkt2);
+        } else {
+            ret = write_slave_packet(&tee->slaves[i], &pkt2);
+        }
+        if (ret < 0)
             if (!ret_all)
                 ret_all = ret;
     }
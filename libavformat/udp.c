@@ -25,6 +25,9 @@
  */
 
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* Needed for sendmmsg with glibc */
+#endif
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -58,6 +61,10 @@
 #include <pthread.h>
 #endif
 
+#if HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #ifndef HAVE_PTHREAD_CANCEL
 #define HAVE_PTHREAD_CANCEL 0
 #endif
@@ -68,6 +75,10 @@
 #endif
 
 #define UDP_TX_BUF_SIZE 32768
+#define UDP_MAX_BATCH 64
+/* limits of a single UDP segmentation offload (GSO) send */
+#define UDP_MAX_GSO_SEGMENTS 64
+#define UDP_MAX_GSO_SIZE 65000
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
 
@@ -86,6 +97,7 @@ typedef struct UDPContext {
     struct sockaddr_storage dest_addr;
     int dest_addr_len;
     int is_connected;
+    int gso_failed;
 
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
@@ -465,6 +477,132 @@ int ff_udp_get_local_port(URLContext *h)
     return s->local_port;
 }
 
+/**
+ * Send several datagrams stored back to back in a buffer, with as few
+ * system calls as possible.
+ *
+ * With UDP segmentation offload, a run of equally sized datagrams,
+ * optionally followed by a shorter one, is passed to the kernel as a single
+ * message. This is how the RTP packetizers split a frame. If the kernel
+ * refuses it, GSO is disabled for the rest of the session.
+ *
+ * @param h media file context
+ * @param buf datagrams to send
+ * @param sizes size of each datagram
+ * @param nb_packets number of datagrams
+ * @return the number of datagrams sent, which may be lower than nb_packets
+ *         if an error occurred after some of them were sent, or a negative
+ *         AVERROR code if none was sent
+ */
+int ff_udp_write_batch(URLContext *h, const uint8_t *buf, const int *sizes,
+                       int nb_packets)
+{
+    UDPContext *s = h->priv_data;
+    int ret, sent = 0;
+
+    while (sent < nb_packets) {
+#if HAVE_SENDMMSG
+        struct mmsghdr msgs[UDP_MAX_BATCH];
+        struct iovec iov[UDP_MAX_BATCH];
+        int nb_segs[UDP_MAX_BATCH];
+#ifdef UDP_SEGMENT
+        union {
+            char buf[CMSG_SPACE(sizeof(uint16_t))];
+            struct cmsghdr align;
+        } control[UDP_MAX_BATCH];
+        int use_gso = !s->gso_failed && !s->udplite_coverage, gso_used = 0;
+#endif
+        const uint8_t *p = buf;
+        int i, n, pkt = sent;
+
+        memset(msgs, 0, sizeof(msgs));
+        for (n = 0; n < UDP_MAX_BATCH && pkt < nb_packets; n++) {
+            int seg = sizes[pkt], len = seg;
+
+            nb_segs[n] = 1;
+#ifdef UDP_SEGMENT
+            while (use_gso && pkt + nb_segs[n] < nb_packets &&
+                   nb_segs[n] < UDP_MAX_GSO_SEGMENTS &&
+                   sizes[pkt + nb_segs[n]] <= seg &&
+                   len + sizes[pkt + nb_segs[n]] <= UDP_MAX_GSO_SIZE) {
+                len += sizes[pkt + nb_segs[n]];
+                /* only the last segment may be shorter */
+                if (sizes[pkt + nb_segs[n]++] < seg)
+                    break;
+            }
+            if (nb_segs[n] > 1) {
+                struct cmsghdr *cm;
+
+                msgs[n].msg_hdr.msg_control    = control[n].buf;
+                msgs[n].msg_hdr.msg_controllen = sizeof(control[n].buf);
+                cm = CMSG_FIRSTHDR(&msgs[n].msg_hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type  = UDP_SEGMENT;
+                cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+                *(uint16_t *)CMSG_DATA(cm) = seg;
+                gso_used = 1;
+            }
+#endif
+            iov[n].iov_base = (void *)p;
+            iov[n].iov_len  = len;
+            msgs[n].msg_hdr.msg_iov    = &iov[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+            if (!s->is_connected) {
+                msgs[n].msg_hdr.msg_name    = &s->dest_addr;
+                msgs[n].msg_hdr.msg_namelen = s->dest_addr_len;
+            }
+            p   += len;
+            pkt += nb_segs[n];
+        }
+#endif
+
+        if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+            ret = ff_network_wait_fd(s->udp_fd, 1);
+            if (ret < 0)
+                return sent ? sent : ret;
+        }
+
+#if HAVE_SENDMMSG
+        ret = sendmmsg(s->udp_fd, msgs, n, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+#ifdef UDP_SEGMENT
+            if (gso_used && ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
+                av_log(h, AV_LOG_VERBOSE, "UDP segmentation offload failed (%s), "
+                       "disabling it\n", av_err2str(ret));
+                s->gso_failed = 1;
+                continue;
+            }
+#endif
+            if (ret == AVERROR(EINTR))
+                continue;
+            return sent ? sent : ret;
+        }
+        /* resume from the first message that was not sent */
+        for (i = 0; i < ret; i++) {
+            buf  += iov[i].iov_len;
+            sent += nb_segs[i];
+        }
+#else
+        if (!s->is_connected) {
+            ret = sendto (s->udp_fd, buf, sizes[sent], 0,
+                          (struct sockaddr *) &s->dest_addr,
+                          s->dest_addr_len);
+        } else
+            ret = send(s->udp_fd, buf, sizes[sent], 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EINTR))
+                continue;
+            return sent ? sent : ret;
+        }
+        buf += sizes[sent++];
+#endif
+    }
+
+    return sent;
+}
+
 /**
  * Return the udp file handle for select() usage to wait for several RTP
  * streams at the same time.
@@ -273,6 +273,8 @@ URLProtocol *ffurl_protocol_next(const URLProtocol *prev);
 /* udp.c */
 int ff_udp_set_remote_url(URLContext *h, const char *uri);
 int ff_udp_get_local_port(URLContext *h);
+int ff_udp_write_batch(URLContext *h, const uint8_t *buf, const int *sizes,
+                       int nb_packets);
 
 /**
  * Assemble a URL string from components. This is the reverse operation
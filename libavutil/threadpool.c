@@ -0,0 +1,353 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "common.h"
+#include "cpu.h"
+#include "error.h"
+#include "mem.h"
+#include "threadpool.h"
+#if HAVE_THREADS
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "compat/w32pthreads.h"
+#elif HAVE_OS2THREADS
+#include "compat/os2threads.h"
+#else
+#error "Unknown threads implementation"
+#endif
+#endif
+
+#if HAVE_THREADS
+typedef struct PoolBatch {
+    AVThreadPoolJobFunc *func;
+    void *opaque;
+    int *rets;
+    int nb_rets;
+    int nb_jobs;
+    int next_job;       ///< next job to hand out
+    int nb_active;      ///< number of threads running jobs of this batch
+    int max_concurrency;
+    int priority;
+    uint8_t busy[AV_THREAD_POOL_MAX_CONCURRENCY]; ///< threadnr in use
+    struct PoolBatch *next;
+} PoolBatch;
+#endif
+
+struct AVThreadPool {
+#if HAVE_THREADS
+    pthread_t *workers;
+    int nb_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   ///< signaled when a batch is queued
+    pthread_cond_t done_cond;   ///< signaled when a batch is finished
+    PoolBatch *batches;         ///< batches with jobs left, highest priority first
+    int done;
+#else
+    int dummy;
+#endif
+};
+
+#if HAVE_THREADS
+
+static int batch_available(const PoolBatch *b)
+{
+    return b->next_job < b->nb_jobs && b->nb_active < b->max_concurrency;
+}
+
+static PoolBatch *pick_batch(AVThreadPool *pool)
+{
+    PoolBatch *b;
+    for (b = pool->batches; b; b = b->next)
+        if (batch_available(b))
+            return b;
+    return NULL;
+}
+
+static void unlink_batch(AVThreadPool *pool, PoolBatch *b)
+{
+    PoolBatch **p = &pool->batches;
+    while (*p != b)
+        p = &(*p)->next;
+    *p = b->next;
+}
+
+/**
+ * Run jobs of a batch until none is left.
+ * Called and returns with the pool lock held.
+ *
+ * @param yield if set, give up the batch as soon as one with a higher
+ *              priority can be served
+ */
+static void run_batch(AVThreadPool *pool, PoolBatch *b, int yield)
+{
+    int threadnr = 0;
+
+    while (b->busy[threadnr])
+        threadnr++;
+    b->busy[threadnr] = 1;
+    b->nb_active++;
+
+    while (b->next_job < b->nb_jobs) {
+        int jobnr = b->next_job++;
+        int ret;
+
+        if (b->next_job == b->nb_jobs)
+            unlink_batch(pool, b);
+
+        pthread_mutex_unlock(&pool->lock);
+        ret = b->func(b->opaque, jobnr, threadnr);
+        pthread_mutex_lock(&pool->lock);
+
+        b->rets[jobnr % b->nb_rets] = ret;
+
+        if (yield && pool->batches != b && pool->batches &&
+            pool->batches->priority > b->priority &&
+            batch_available(pool->batches))
+            break;
+    }
+
+    b->busy[threadnr] = 0;
+    if (!--b->nb_active && b->next_job == b->nb_jobs)
+        pthread_cond_broadcast(&pool->done_cond);
+}
+
+static void *attribute_align_arg worker(void *arg)
+{
+    AVThreadPool *pool = arg;
+    PoolBatch *b;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->done && !(b = pick_batch(pool)))
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->done)
+            break;
+        run_batch(pool, b, 1);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void pool_stop(AVThreadPool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->done = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->workers[i], NULL);
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+#endif /* HAVE_THREADS */
+
+int av_thread_pool_alloc(AVThreadPool **pool, int nb_threads)
+{
+#if HAVE_THREADS
+    AVThreadPool *p;
+    int i, ret;
+
+#if HAVE_W32THREADS
+    w32thread_init();
+#endif
+
+    *pool = NULL;
+
+    if (nb_threads < 0)
+        return AVERROR(EINVAL);
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    if (!(p = av_mallocz(sizeof(*p))))
+        return AVERROR(ENOMEM);
+    if (!(p->workers = av_mallocz_array(nb_threads, sizeof(*p->workers)))) {
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_cond, NULL);
+    pthread_cond_init(&p->done_cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&p->workers[i], NULL, worker, p);
+        if (ret) {
+            p->nb_threads = i;
+            pool_stop(p);
+            av_free(p->workers);
+            av_free(p);
+            return AVERROR(ret);
+        }
+        p->nb_threads = i + 1;
+    }
+
+    *pool = p;
+    return 0;
+#else
+    *pool = NULL;
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
+void av_thread_pool_free(AVThreadPool **pool)
+{
+#if HAVE_THREADS
+    if (*pool) {
+        pool_stop(*pool);
+        av_freep(&(*pool)->workers);
+        av_freep(pool);
+    }
+#endif
+}
+
+int av_thread_pool_get_nb_threads(const AVThreadPool *pool)
+{
+#if HAVE_THREADS
+    return pool->nb_threads;
+#else
+    return 0;
+#endif
+}
+
+int av_thread_pool_execute(AVThreadPool *pool, AVThreadPoolJobFunc *func,
+                           void *opaque, int *ret, int nb_jobs,
+                           int max_concurrency, int priority)
+{
+#if HAVE_THREADS
+    PoolBatch b = { 0 }, **p;
+    int i, dummy_ret;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    if (max_concurrency <= 0 || max_concurrency > AV_THREAD_POOL_MAX_CONCURRENCY)
+        max_concurrency = AV_THREAD_POOL_MAX_CONCURRENCY;
+
+    b.func            = func;
+    b.opaque          = opaque;
+    b.rets            = ret ? ret     : &dummy_ret;
+    b.nb_rets         = ret ? nb_jobs : 1;
+    b.nb_jobs         = nb_jobs;
+    b.max_concurrency = max_concurrency;
+    b.priority        = priority;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (p = &pool->batches; *p && (*p)->priority >= priority; p = &(*p)->next);
+    b.next = *p;
+    *p     = &b;
+
+    for (i = 1; i < FFMIN(nb_jobs, max_concurrency) && i <= pool->nb_threads; i++)
+        pthread_cond_signal(&pool->work_cond);
+
+    /* the batch was just queued, so the calling thread always gets a slot
+     * and the batch progresses even if every worker is busy elsewhere */
+    run_batch(pool, &b, 0);
+
+    while (b.nb_active)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+#else
+    int i;
+
+    for (i = 0; i < nb_jobs; i++) {
+        int r = func(opaque, i, 0);
+        if (ret)
+            ret[i] = r;
+    }
+#endif /* HAVE_THREADS */
+    return 0;
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#define NB_JOBS 100
+
+typedef struct TestBatch {
+    int done[NB_JOBS];
+    int running[AV_THREAD_POOL_MAX_CONCURRENCY];
+    int max_concurrency;
+    int errors;
+} TestBatch;
+
+static int test_job(void *opaque, int jobnr, int threadnr)
+{
+    TestBatch *t = opaque;
+
+    if (threadnr >= t->max_concurrency || t->running[threadnr]++)
+        t->errors++;
+    t->done[jobnr]++;
+    t->running[threadnr]--;
+    return jobnr * 2;
+}
+
+static int test_execute(AVThreadPool *pool, int max_concurrency, int priority)
+{
+    TestBatch t = { { 0 } };
+    int rets[NB_JOBS];
+    int i;
+
+    t.max_concurrency = max_concurrency ? max_concurrency
+                                        : AV_THREAD_POOL_MAX_CONCURRENCY;
+    av_thread_pool_execute(pool, test_job, &t, rets, NB_JOBS,
+                           max_concurrency, priority);
+    for (i = 0; i < NB_JOBS; i++)
+        if (t.done[i] != 1 || rets[i] != i * 2)
+            t.errors++;
+    return t.errors;
+}
+
+int main(void)
+{
+    AVThreadPool *pool;
+    int ret, errors = 0;
+
+    ret = av_thread_pool_alloc(&pool, 4);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    if (ret < 0) {
+        fprintf(stderr, "Failed to allocate the pool\n");
+        return 1;
+    }
+
+    errors += test_execute(pool, 0, 0);
+    errors += test_execute(pool, 1, 0);
+    errors += test_execute(pool, 2, 1);
+    errors += test_execute(pool, 3, -1);
+
+    av_thread_pool_free(&pool);
+
+    if (errors)
+        fprintf(stderr, "%d errors\n", errors);
+    return !!errors;
+}
+
+#endif /* TEST */
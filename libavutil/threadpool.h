@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_THREADPOOL_H
+#define AVUTIL_THREADPOOL_H
+
+/**
+ * @file
+ * Thread pool shared between several users.
+ *
+ * A pool owns a fixed set of worker threads. Any number of users (codec or
+ * filter graph contexts, or the application itself) can submit batches of
+ * jobs to it; the thread submitting a batch takes part in running it, so a
+ * batch always makes progress even when all workers are busy. Batches with
+ * a higher priority are served first and each batch can cap the number of
+ * threads working on it at the same time.
+ */
+
+/**
+ * Maximum number of threads that can run the jobs of a single batch at
+ * the same time.
+ */
+#define AV_THREAD_POOL_MAX_CONCURRENCY 64
+
+typedef struct AVThreadPool AVThreadPool;
+
+/**
+ * Job callback.
+ *
+ * @param opaque   the opaque pointer passed to av_thread_pool_execute()
+ * @param jobnr    index of the job, in the [0, nb_jobs) range
+ * @param threadnr index of the thread running the job within the batch, in
+ *                 the [0, max_concurrency) range; no two jobs of the same
+ *                 batch run at the same time with the same threadnr
+ * @return value stored in the ret array of av_thread_pool_execute()
+ */
+typedef int (AVThreadPoolJobFunc)(void *opaque, int jobnr, int threadnr);
+
+/**
+ * Allocate a thread pool and start its workers.
+ *
+ * @param pool       pointer to the pool
+ * @param nb_threads number of worker threads, 0 for one per CPU
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_pool_alloc(AVThreadPool **pool, int nb_threads);
+
+/**
+ * Stop the workers and free the pool.
+ *
+ * The pool must no longer be in use: every context it was set on must have
+ * been closed or freed before.
+ */
+void av_thread_pool_free(AVThreadPool **pool);
+
+/**
+ * @return the number of worker threads of the pool
+ */
+int av_thread_pool_get_nb_threads(const AVThreadPool *pool);
+
+/**
+ * Run a batch of jobs on the pool and wait for all of them to finish.
+ *
+ * Jobs are started in increasing jobnr order, so a job may wait for
+ * the progress of a job with a lower jobnr.
+ * This function can safely be called from several threads at once.
+ *
+ * @param pool            the pool
+ * @param func            job callback
+ * @param opaque          passed to func
+ * @param ret             if not NULL, array of nb_jobs elements receiving
+ *                        the return values of the jobs
+ * @param nb_jobs         number of jobs
+ * @param max_concurrency maximum number of threads, including the calling
+ *                        one, running jobs of this batch at the same time;
+ *                        0 or more than AV_THREAD_POOL_MAX_CONCURRENCY is
+ *                        treated as AV_THREAD_POOL_MAX_CONCURRENCY
+ * @param priority        batches with a higher priority are served first
+ * @return 0
+ */
+int av_thread_pool_execute(AVThreadPool *pool, AVThreadPoolJobFunc *func,
+                           void *opaque, int *ret, int nb_jobs,
+                           int max_concurrency, int priority);
+
+#endif /* AVUTIL_THREADPOOL_H */
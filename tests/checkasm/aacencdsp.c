@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "checkasm.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intfloat.h"
+#include "libavcodec/aacenc.h"
+
+#define BUF_SIZE 1024
+
+static const int maxval[] = { 1, 2, 4, 7, 12, 16, 8191 };
+
+static float rnd_float(float range)
+{
+    return (int32_t)rnd() * range / 2147483648.0f;
+}
+
+/* the reference may be computed with extended precision on x87 */
+static int float_near_ulp(float a, float b)
+{
+    int32_t d = av_float2int(a) - av_float2int(b);
+    return FFABS(d) <= 1;
+}
+
+static void check_abs_pow34(void)
+{
+    LOCAL_ALIGNED_16(float, in,   [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, out0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, out1, [BUF_SIZE]);
+    int size, i;
+
+    declare_func(void, float *out, const float *in, const int size);
+
+    for (size = 4; size <= BUF_SIZE; size <<= 1) {
+        for (i = 0; i < BUF_SIZE; i++)
+            in[i] = rnd_float(32768.0f);
+        memset(out0, 0, BUF_SIZE * sizeof(*out0));
+        memset(out1, 0, BUF_SIZE * sizeof(*out1));
+        call_ref(out0, in, size);
+        call_new(out1, in, size);
+        for (i = 0; i < BUF_SIZE; i++)
+            if (!float_near_ulp(out0[i], out1[i])) {
+                fail();
+                break;
+            }
+        bench_new(out1, in, size);
+    }
+}
+
+static void check_quant_bands(void)
+{
+    LOCAL_ALIGNED_16(float, in,     [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, scaled, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(int,   out0,   [BUF_SIZE]);
+    LOCAL_ALIGNED_16(int,   out1,   [BUF_SIZE]);
+    int size, is_signed, i;
+
+    declare_func(void, int *out, const float *in, const float *scaled,
+                 int size, int is_signed, int maxval, const float Q34,
+                 const float rounding);
+
+    for (size = 4; size <= BUF_SIZE; size <<= 1) {
+        for (is_signed = 0; is_signed <= 1; is_signed++) {
+            int max     = maxval[rnd() % FF_ARRAY_ELEMS(maxval)];
+            float Q34   = ldexpf(1.0f + rnd_float(0.5f), (int)(rnd() % 16) - 8);
+            float round = rnd() & 1 ? 0.4054f : 0.1054f;
+
+            for (i = 0; i < BUF_SIZE; i++) {
+                in[i] = rnd_float(64.0f);
+                /* put some of the values right at a rounding boundary */
+                if (rnd() & 1)
+                    scaled[i] = (rnd() % (max + 2) + 1 - round) / Q34;
+                else
+                    scaled[i] = sqrtf(fabsf(in[i]) * sqrtf(fabsf(in[i])));
+            }
+            memset(out0, 0, BUF_SIZE * sizeof(*out0));
+            memset(out1, 0, BUF_SIZE * sizeof(*out1));
+            call_ref(out0, in, scaled, size, is_signed, max, Q34, round);
+            call_new(out1, in, scaled, size, is_signed, max, Q34, round);
+            if (memcmp(out0, out1, BUF_SIZE * sizeof(*out0)))
+                fail();
+            bench_new(out1, in, scaled, size, is_signed, max, Q34, round);
+        }
+    }
+}
+
+void checkasm_check_aacencdsp(void)
+{
+    static AACEncContext s;
+
+    ff_aac_dsp_init(&s);
+
+    if (check_func(s.abs_pow34, "aac_abs_pow34"))
+        check_abs_pow34();
+    report("abs_pow34");
+
+    if (check_func(s.quant_bands, "aac_quantize_bands"))
+        check_quant_bands();
+    report("quant_bands");
+}
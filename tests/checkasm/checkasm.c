@@ -57,6 +57,9 @@ static const struct {
     const char *name;
     void (*func)(void);
 } tests[] = {
+#if CONFIG_AAC_ENCODER
+    { "aacencdsp", checkasm_check_aacencdsp },
+#endif
 #if CONFIG_BSWAPDSP
     { "bswapdsp", checkasm_check_bswapdsp },
 #endif
@@ -66,6 +69,9 @@ static const struct {
 #if CONFIG_H264QPEL
     { "h264qpel", checkasm_check_h264qpel },
 #endif
+#if CONFIG_JPEG2000_DECODER
+    { "jpeg2000dwt", checkasm_check_jpeg2000dwt },
+#endif
 #if CONFIG_V210_ENCODER
     { "v210enc", checkasm_check_v210enc },
 #endif
@@ -29,9 +29,11 @@
 #include "libavutil/lfg.h"
 #include "libavutil/timer.h"
 
+void checkasm_check_aacencdsp(void);
 void checkasm_check_bswapdsp(void);
 void checkasm_check_h264pred(void);
 void checkasm_check_h264qpel(void);
+void checkasm_check_jpeg2000dwt(void);
 void checkasm_check_v210enc(void);
 
 void *checkasm_check_func(void *func, const char *name, ...) av_printf_format(2, 3);
@@ -0,0 +1,110 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intfloat.h"
+#include "libavcodec/jpeg2000dwt.h"
+
+/* the lifted rows, the rows in between and the ones before and after */
+#define MAX_ROWS 32
+#define BUF_SIZE ((2 * MAX_ROWS + 1) * FF_DWT_COLS)
+
+static const float coefs[] = {
+    1.586134342059924f, 0.052980118572961f, 0.882911075530934f, 0.443506852043971f,
+};
+
+/* the reference may be computed with extended precision on x87 */
+static int float_near_ulp(float a, float b)
+{
+    int32_t d = av_float2int(a) - av_float2int(b);
+    return FFABS(d) <= 1;
+}
+
+static void check_lift_float(void)
+{
+    LOCAL_ALIGNED_16(float, p0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, p1, [BUF_SIZE]);
+    int n, i;
+
+    declare_func(void, float *p, int n, float coef);
+
+    for (n = 1; n <= MAX_ROWS; n += 3) {
+        float coef = coefs[rnd() % FF_ARRAY_ELEMS(coefs)];
+
+        if (rnd() & 1)
+            coef = -coef;
+        for (i = 0; i < BUF_SIZE; i++)
+            p0[i] = (int32_t)rnd() / 16384.0f;
+        memcpy(p1, p0, BUF_SIZE * sizeof(*p0));
+        call_ref(p0 + FF_DWT_COLS, n, coef);
+        call_new(p1 + FF_DWT_COLS, n, coef);
+        for (i = 0; i < BUF_SIZE; i++)
+            if (!float_near_ulp(p0[i], p1[i])) {
+                fail();
+                break;
+            }
+    }
+    bench_new(p1 + FF_DWT_COLS, MAX_ROWS, coefs[0]);
+}
+
+static void check_lift53(void)
+{
+    LOCAL_ALIGNED_16(int32_t, p0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(int32_t, p1, [BUF_SIZE]);
+    int n, i;
+
+    declare_func(void, int32_t *p, int n);
+
+    for (n = 1; n <= MAX_ROWS; n += 3) {
+        for (i = 0; i < BUF_SIZE; i++)
+            p0[i] = (int32_t)rnd() >> 8;
+        memcpy(p1, p0, BUF_SIZE * sizeof(*p0));
+        call_ref(p0 + FF_DWT_COLS, n);
+        call_new(p1 + FF_DWT_COLS, n);
+        if (memcmp(p0, p1, BUF_SIZE * sizeof(*p0)))
+            fail();
+    }
+    bench_new(p1 + FF_DWT_COLS, MAX_ROWS);
+}
+
+void checkasm_check_jpeg2000dwt(void)
+{
+    uint16_t border[2][2] = { { 0, 64 }, { 0, 64 } };
+    DWTContext s97 = { 0 }, s53 = { 0 };
+
+    if (ff_jpeg2000_dwt_init(&s97, border, 1, FF_DWT97) < 0 ||
+        ff_jpeg2000_dwt_init(&s53, border, 1, FF_DWT53) < 0)
+        goto end;
+
+    if (check_func(s97.lift_float, "jpeg2000_dwt_lift_float"))
+        check_lift_float();
+    report("lift_float");
+
+    if (check_func(s53.lift53_sub, "jpeg2000_dwt_lift53_sub"))
+        check_lift53();
+    if (check_func(s53.lift53_add, "jpeg2000_dwt_lift53_add"))
+        check_lift53();
+    report("lift53");
+
+end:
+    ff_dwt_destroy(&s97);
+    ff_dwt_destroy(&s53);
+}
@@ -150,6 +150,16 @@ fate-aac-aref-encode: CMP_TARGET = 594
 fate-aac-aref-encode: SIZE_TOLERANCE = 2464
 fate-aac-aref-encode: FUZZ = 6
 
+FATE_AAC_ENCODE += fate-aac-fast-encode
+fate-aac-fast-encode: ./tests/data/asynth-44100-2.wav
+fate-aac-fast-encode: CMD = enc_dec_pcm adts wav s16le $(REF) -strict -2 -c:a aac -aac_coder fast -aac_is 0 -aac_pns 0 -b:a 512k
+fate-aac-fast-encode: CMP = stddev
+fate-aac-fast-encode: REF = ./tests/data/asynth-44100-2.wav
+fate-aac-fast-encode: CMP_SHIFT = -4096
+fate-aac-fast-encode: CMP_TARGET = 626
+fate-aac-fast-encode: SIZE_TOLERANCE = 2464
+fate-aac-fast-encode: FUZZ = 6
+
 FATE_AAC_ENCODE += fate-aac-ln-encode
 fate-aac-ln-encode: CMD = enc_dec_pcm adts wav s16le $(TARGET_SAMPLES)/audio-reference/luckynight_2ch_44kHz_s16.wav -strict -2 -c:a aac -aac_is 0 -aac_pns 0 -b:a 512k
 fate-aac-ln-encode: CMP = stddev
@@ -188,8 +188,13 @@ FATE_H264_REINIT_TESTS := large_420_8-to-small_420_8                    \
                           small_420_9-to-small_420_8                    \
                           small_422_9-to-small_420_9                    \
 
+FATE_H264_DEFERRED_DEBLOCK_TESTS := cabac_mot_frm0_full               \
+                                    frext-hpcv_brcm_a                   \
+                                    sl1_sva_b                           \
+
 FATE_H264  := $(FATE_H264:%=fate-h264-conformance-%)                    \
               $(FATE_H264_REINIT_TESTS:%=fate-h264-reinit-%)            \
+              $(FATE_H264_DEFERRED_DEBLOCK_TESTS:%=fate-h264-deferred-deblock-%) \
               fate-h264-extreme-plane-pred                              \
               fate-h264-lossless                                        \
 
@@ -394,4 +399,12 @@ fate-h264-interlace-crop:                         CMD = framecrc -i $(TARGET_SAM
 fate-h264-lossless:                               CMD = framecrc -i $(TARGET_SAMPLES)/h264/lossless.h264
 fate-h264-direct-bff:                             CMD = framecrc -i $(TARGET_SAMPLES)/h264/direct-bff.mkv
 
+# deferred deblocking must not change the output of the sequential decoder
+fate-h264-deferred-deblock-cabac_mot_frm0_full:   CMD = framecrc -vsync drop -deferred_deblock 1 -i $(TARGET_SAMPLES)/h264-conformance/camp_mot_frm0_full.26l
+fate-h264-deferred-deblock-frext-hpcv_brcm_a:     CMD = framecrc -vsync drop -deferred_deblock 1 -i $(TARGET_SAMPLES)/h264-conformance/FRext/HPCV_BRCM_A.264
+fate-h264-deferred-deblock-sl1_sva_b:             CMD = framecrc -vsync drop -deferred_deblock 1 -i $(TARGET_SAMPLES)/h264-conformance/SL1_SVA_B.264
+fate-h264-deferred-deblock-%: REF = $(SRC_PATH)/tests/ref/fate/h264-conformance-$(@:fate-h264-deferred-deblock-%=%)
+fate-h264-deferred-deblock-%: THREADS = 4
+fate-h264-deferred-deblock-%: THREAD_TYPE = slice
+
 fate-h264-reinit-%:                               CMD = framecrc -i $(TARGET_SAMPLES)/h264/$(@:fate-h264-%=%).h264 -vf format=yuv444p10le,scale=w=352:h=288
@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Benchmark the ProRes encoders on a fixed source.
+#
+# usage: prores-bench.sh <ffmpeg> <videogen> <datadir> <width> <height> <frames> <threads>...
+#
+# The source is the deterministic videogen pattern, converted once to the
+# input format of each encoder, so that only the encoding is timed. Every
+# configuration is encoded once per thread count. The MD5 of the output is
+# printed with the timings and must not depend on the thread count.
+
+ffmpeg=$1
+videogen=$2
+datadir=$3
+width=$4
+height=$5
+frames=$6
+shift 6
+threads=$*
+
+size=${width}x${height}
+
+source_file(){
+    pix_fmt=$1
+    src=$datadir/prores-bench-$size-$frames-$pix_fmt.yuv
+    if [ ! -f $src ]; then
+        $videogen /dev/stdout $width $height |
+            $ffmpeg -nostdin -v error -f rawvideo -pix_fmt yuv420p -s $size -i - \
+                    -frames:v $frames -pix_fmt $pix_fmt -f rawvideo -y $src.tmp ||
+            exit 1
+        mv $src.tmp $src
+    fi
+    echo $src
+}
+
+bench(){
+    encoder=$1
+    pix_fmt=$2
+    shift 2
+    src=$(source_file $pix_fmt) || exit 1
+    for t in $threads; do
+        log=$datadir/prores-bench.log
+        md5=$($ffmpeg -nostdin -nostats -benchmark -f rawvideo -pix_fmt $pix_fmt -s $size \
+                      -i $src -threads $t -c:v $encoder "$@" -f md5 - 2>$log) || {
+            cat $log
+            exit 1
+        }
+        printf '%-10s %-24s threads=%-2s %s %s\n' $encoder "$*" $t \
+               "$(sed -n 's/^bench: //p' $log | tr '\n' ' ')" "$md5"
+    done
+}
+
+echo "ProRes encoding of $frames frames at $size"
+bench prores_ks yuv444p10le -profile:v 4444
+bench prores_ks yuv422p10le -profile:v hq
+bench prores_aw yuv422p10le
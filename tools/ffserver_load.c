@@ -0,0 +1,150 @@
+/*
+ * Simple HTTP load generator for ffserver
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Opens a number of idle connections that never complete their request,
+ * then fetches the same URL in a loop and reports the request rate and
+ * latency. With a server that looks at every connection on each wakeup,
+ * the latency grows with the number of idle connections.
+ *
+ * Keep the duration below the server request timeout (15 s for ffserver),
+ * otherwise the idle connections get closed.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static int64_t gettime_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+}
+
+static int open_connection(const struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* fetch path and return the number of bytes received, -1 on error */
+static int64_t fetch(const struct sockaddr_in *addr, const char *path)
+{
+    char buf[16384];
+    int64_t total = 0;
+    int len, fd = open_connection(addr);
+
+    if (fd < 0)
+        return -1;
+    len = snprintf(buf, sizeof(buf), "GET %s HTTP/1.0\r\n\r\n", path);
+    if (write(fd, buf, len) != len) {
+        close(fd);
+        return -1;
+    }
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+        total += len;
+    close(fd);
+    return len < 0 ? -1 : total;
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr = { 0 };
+    int64_t start, t0, t, lat_sum = 0, lat_max = 0, bytes = 0;
+    int nb_idle, duration, nb_requests = 0, nb_errors = 0, i;
+    int *idle;
+
+    if (argc != 6) {
+        fprintf(stderr, "usage: %s ip port path idle_connections duration_seconds\n",
+                argv[0]);
+        return 1;
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(atoi(argv[2]));
+    if (inet_pton(AF_INET, argv[1], &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid address %s\n", argv[1]);
+        return 1;
+    }
+    nb_idle  = atoi(argv[4]);
+    duration = atoi(argv[5]);
+
+    idle = calloc(nb_idle ? nb_idle : 1, sizeof(*idle));
+    if (!idle)
+        return 1;
+    for (i = 0; i < nb_idle; i++) {
+        idle[i] = open_connection(&addr);
+        if (idle[i] < 0 || write(idle[i], "GET ", 4) != 4) {
+            fprintf(stderr, "could only open %d idle connections: %s\n",
+                    i, strerror(errno));
+            return 1;
+        }
+        /* ffserver listens with a backlog of 5 and accepts one connection
+         * per loop iteration: do not overflow it, or the SYN retries make
+         * the setup take longer than the request timeout */
+        usleep(200);
+    }
+    /* let the server accept them all before measuring */
+    sleep(1);
+
+    start = gettime_us();
+    do {
+        int64_t ret;
+
+        t0  = gettime_us();
+        ret = fetch(&addr, argv[3]);
+        t   = gettime_us();
+        if (ret < 0) {
+            nb_errors++;
+            continue;
+        }
+        bytes   += ret;
+        lat_sum += t - t0;
+        if (t - t0 > lat_max)
+            lat_max = t - t0;
+        nb_requests++;
+    } while (t - start < duration * INT64_C(1000000));
+
+    printf("idle connections: %d\n", nb_idle);
+    printf("requests: %d (%d errors), %.1f/s, %"PRId64" bytes\n",
+           nb_requests, nb_errors, nb_requests * 1e6 / (t - start), bytes);
+    if (nb_requests)
+        printf("latency: avg %.3f ms, max %.3f ms\n",
+               lat_sum / 1000.0 / nb_requests, lat_max / 1000.0);
+
+    for (i = 0; i < nb_idle; i++)
+        close(idle[i]);
+    free(idle);
+    return 0;
+}
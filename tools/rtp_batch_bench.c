@@ -0,0 +1,111 @@
+/*
+ * RTP batching benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Writes synthetic RTP frames to an rtp:// URL, the way the RTP muxer
+ * does, and reports the packet rate and the CPU time spent. Compare runs
+ * with and without the batch_size URL option, e.g.
+ *   rtp_batch_bench "rtp://127.0.0.1:5004" 10000 20 1400
+ *   rtp_batch_bench "rtp://127.0.0.1:5004?batch_size=64" 10000 20 1400
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+static int64_t cpu_time_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * INT64_C(1000000) +
+            ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+    AVIOContext *pb;
+    uint8_t *pkt;
+    int64_t wall, cpu;
+    int nb_frames, pkts_per_frame, pkt_size, i, j, ret;
+    uint16_t seq = 0;
+
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s url frames packets_per_frame packet_size\n",
+                argv[0]);
+        return 1;
+    }
+    nb_frames      = atoi(argv[2]);
+    pkts_per_frame = atoi(argv[3]);
+    pkt_size       = atoi(argv[4]);
+    if (nb_frames <= 0 || pkts_per_frame <= 0 || pkt_size < 12) {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+
+    av_register_all();
+    avformat_network_init();
+
+    ret = avio_open2(&pb, argv[1], AVIO_FLAG_WRITE, NULL, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", argv[1], av_err2str(ret));
+        return 1;
+    }
+    pkt = av_mallocz(pkt_size);
+    if (!pkt)
+        return 1;
+    if (pb->max_packet_size && pkt_size > pb->max_packet_size)
+        fprintf(stderr, "packet size %d larger than the URL packet size %d\n",
+                pkt_size, pb->max_packet_size);
+
+    wall = av_gettime_relative();
+    cpu  = cpu_time_us();
+    for (i = 0; i < nb_frames; i++) {
+        for (j = 0; j < pkts_per_frame; j++) {
+            pkt[0] = 0x80;
+            pkt[1] = 96 | (j == pkts_per_frame - 1 ? 0x80 : 0);
+            AV_WB16(pkt + 2, seq++);
+            AV_WB32(pkt + 4, i * 3000);
+            AV_WB32(pkt + 8, 0x12345678);
+            /* the last packet of a frame is usually shorter */
+            avio_write(pb, pkt, j == pkts_per_frame - 1 ? pkt_size / 2 : pkt_size);
+            avio_flush(pb);
+            if (pb->error) {
+                fprintf(stderr, "write error: %s\n", av_err2str(pb->error));
+                return 1;
+            }
+        }
+    }
+    avio_closep(&pb);
+    wall = av_gettime_relative() - wall;
+    cpu  = cpu_time_us() - cpu;
+
+    printf("%d packets in %.3f s: %.0f packets/s, %.3f us CPU per packet\n",
+           nb_frames * pkts_per_frame, wall / 1e6,
+           nb_frames * pkts_per_frame * 1e6 / wall,
+           (double)cpu / (nb_frames * pkts_per_frame));
+
+    av_free(pkt);
+    avformat_network_deinit();
+    return 0;
+}